@@ -0,0 +1,29 @@
+
+#include <iostream>
+
+#include "BatchPresenter.hpp"
+
+//Headless batch: batch_runner <image directory | list file> [setting file] [output directory]
+int main(int argc, char* argv[])
+{
+    if(argc < 2) return -1;
+
+    using namespace ImageInformationAnalyzer::Presentation;
+
+    try
+    {
+        auto setting = argc > 2 ? BatchPresenter::ReadSetting(argv[2]) : BatchSetting();
+        if(argc > 3) setting.OutputDirectory = argv[3];
+
+        auto files = BatchPresenter::GetInputFiles(argv[1]);
+        if(files.empty()) throw std::invalid_argument("no input images");
+
+        return BatchPresenter::Run(setting, files) == 0 ? 0 : 1;
+    }
+    catch(const std::exception& e)
+    {
+        std::cout << "Exception: "s << e.what() << std::endl;
+    }
+
+    return -1;
+}
@@ -0,0 +1,28 @@
+
+#include <iostream>
+
+#include "DaemonPresenter.hpp"
+
+//Warm worker: analyzer_daemon <socket path> [setting file]
+//The setting file gives the values that the spec of a job does not, stop it with "daemon_client <socket path> shutdown"
+int main(int argc, char* argv[])
+{
+    if(argc < 2) return -1;
+
+    using namespace ImageInformationAnalyzer::Presentation;
+
+    try
+    {
+        auto setting = argc > 2 ? BatchPresenter::ReadSetting(argv[2]) : BatchSetting();
+
+        DaemonPresenter daemon(argv[1], setting);
+        daemon.Run();
+        return 0;
+    }
+    catch(const std::exception& e)
+    {
+        std::cout << "Exception: "s << e.what() << std::endl;
+    }
+
+    return -1;
+}
@@ -0,0 +1,98 @@
+
+#include <algorithm>
+#include <chrono>
+#include <cstdlib>
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+#include <numeric>
+
+#include "DaemonPresenter.hpp"
+
+using namespace std::string_literals;
+
+//Mean, median and min in ms
+static void PrintLatency(const std::string& title, std::vector<double> latencies)
+{
+    std::sort(latencies.begin(), latencies.end());
+    auto mean = std::accumulate(latencies.begin(), latencies.end(), 0.0) / latencies.size();
+    std::cout << title << ": mean "s << mean << "ms, median "s << latencies[latencies.size() / 2] << "ms, min "s << latencies.front() << "ms"s << std::endl;
+}
+
+static double GetMilliseconds(const std::chrono::steady_clock::time_point& start)
+{
+    return std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+}
+
+//Latency of one image through a running analyzer_daemon against a batch_runner process per image
+//daemon_benchmark <socket path> <image> [count] [spec] [batch_runner path]
+int main(int argc, char* argv[])
+{
+    if(argc < 3) return -1;
+
+    using namespace ImageInformationAnalyzer::Presentation;
+
+    const std::string socketPath(argv[1]);
+    const auto image = std::filesystem::absolute(argv[2]).string();
+    const auto count = argc > 3 ? std::max(std::stoi(argv[3]), 1) : 10;
+    const std::string spec = argc > 4 ? argv[4] : ""s;
+    const std::string batchRunner = argc > 5 ? argv[5] : "batch_runner"s;
+
+    try
+    {
+        //Cold: process start, library initialization and repository setup for every image
+        auto directory = std::filesystem::temp_directory_path() / "daemon_benchmark"s;
+        std::filesystem::create_directories(directory);
+
+        auto listPath = (directory / "list.txt"s).string();
+        auto settingPath = (directory / "setting.cfg"s).string();
+        std::ofstream(listPath) << image << std::endl;
+        {
+            auto lines = spec;
+            std::replace(lines.begin(), lines.end(), ';', '\n');
+            std::ofstream(settingPath) << lines << std::endl << "in_flight = 1"s << std::endl;
+        }
+
+    #ifdef _WIN32
+        auto command = "\"\""s + batchRunner + "\" \""s + listPath + "\" \""s + settingPath + "\" \""s + (directory / "cold"s).string() + "\" > NUL\""s;
+    #else
+        auto command = "\""s + batchRunner + "\" \""s + listPath + "\" \""s + settingPath + "\" \""s + (directory / "cold"s).string() + "\" > /dev/null"s;
+    #endif
+
+        std::vector<double> coldLatencies;
+        for(auto i = 0; i < count; ++i)
+        {
+            auto start = std::chrono::steady_clock::now();
+            if(std::system(command.c_str()) != 0) throw std::runtime_error("batch_runner failed: "s + command);
+            coldLatencies.push_back(GetMilliseconds(start));
+        }
+
+        //Warm: a new connection per image, as a separate client would do
+        auto start = std::chrono::steady_clock::now();
+        DaemonClient(socketPath).Submit(image, spec);
+        auto firstLatency = GetMilliseconds(start);
+
+        std::vector<double> warmLatencies;
+        for(auto i = 0; i < count; ++i)
+        {
+            start = std::chrono::steady_clock::now();
+            DaemonClient(socketPath).Submit(image, spec);
+            warmLatencies.push_back(GetMilliseconds(start));
+        }
+
+        PrintLatency("Cold (batch_runner per image)"s, coldLatencies);
+        std::cout << "Daemon first job: "s << firstLatency << "ms"s << std::endl;
+        PrintLatency("Warm (daemon)"s, warmLatencies);
+
+        std::sort(coldLatencies.begin(), coldLatencies.end());
+        std::sort(warmLatencies.begin(), warmLatencies.end());
+        std::cout << "Median speedup: "s << coldLatencies[count / 2] / warmLatencies[count / 2] << "x"s << std::endl;
+        return 0;
+    }
+    catch(const std::exception& e)
+    {
+        std::cout << "Exception: "s << e.what() << std::endl;
+    }
+
+    return -1;
+}
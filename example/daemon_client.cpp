@@ -0,0 +1,62 @@
+
+#include <iostream>
+#include <iomanip>
+
+#include "DaemonPresenter.hpp"
+
+//daemon_client <socket path> ping | shutdown | <image>... [--spec "key=value;key=value"]
+//Keys are those of the batch setting file, one timing.csv line is printed per image
+int main(int argc, char* argv[])
+{
+    if(argc < 3) return -1;
+
+    using namespace ImageInformationAnalyzer::Presentation;
+
+    try
+    {
+        DaemonClient client(argv[1]);
+
+        std::string command(argv[2]);
+        if(command == "ping"s)
+        {
+            auto alive = client.Ping();
+            std::cout << (alive ? "Daemon is alive"s : "No reply"s) << std::endl;
+            return alive ? 0 : 1;
+        }
+        if(command == "shutdown"s)
+        {
+            client.Shutdown();
+            return 0;
+        }
+
+        std::string spec;
+        std::vector<std::string> files;
+        for(auto i = 2; i < argc; ++i)
+        {
+            std::string argument(argv[i]);
+            if(argument == "--spec"s && i + 1 < argc) spec = argv[++i];
+            else files.push_back(argument);
+        }
+
+        std::cout << BatchPresenter::GetCsvHeader() << std::endl;
+
+        auto failed = 0;
+        for(const auto& file : files)
+        {
+            auto line = client.Submit(file, spec, [](const double progress)
+            {
+                std::cerr << "Progress: "s << std::setprecision(3) << progress << "%"s << std::endl;
+            });
+            std::cout << line << std::endl;
+
+            if(line.size() < 3 || line.substr(line.size() - 3) != ",ok"s) failed++;
+        }
+        return failed == 0 ? 0 : 1;
+    }
+    catch(const std::exception& e)
+    {
+        std::cout << "Exception: "s << e.what() << std::endl;
+    }
+
+    return -1;
+}
@@ -0,0 +1,141 @@
+
+#include <iostream>
+#include <memory>
+#include <random>
+
+#include "DenoiseImageService.hpp"
+#include "ImageFileService.hpp"
+#include "ScaleImageService.hpp"
+#include "ImageEvaluationService.hpp"
+#include "ImageUtility.hpp"
+
+//Speed/PSNR of each denoise mode on a center crop with known gaussian noise
+int main(int argc, char* argv[])
+{
+    if(argc < 2) return -1;
+
+    using namespace ImageInformationAnalyzer::Application;
+
+    std::string filepath(argv[1]);
+    const auto sigma = argc > 2 ? std::stod(argv[2]) : 0.02;
+    const auto cropSize = argc > 3 ? std::stoi(argv[3]) : 256;
+
+    try
+    {
+        ImageFileService imageFileService;
+        ScaleImageService scaleImageService;
+        ImageEvaluationService psnrService(ImageEvaluationService::Mode::PSNR);
+
+        std::unique_ptr<FloatingPointImageData> original(imageFileService.Load(filepath, IImageFileDataRepository::Channel::G));
+        std::unique_ptr<FloatingPointImageData> scaled(scaleImageService.Process(original.get(), 0.0, 255.0, 0.0, 1.0));
+
+        //Center crop
+        const auto width = std::min(cropSize, scaled->Width);
+        const auto height = std::min(cropSize, scaled->Height);
+        const auto offsetX = (scaled->Width - width) / 2;
+        const auto offsetY = (scaled->Height - height) / 2;
+
+        std::vector<std::vector<double>> cleanBuffer(height, std::vector<double>(width));
+        std::vector<std::vector<double>> noisyBuffer(height, std::vector<double>(width));
+        std::vector<std::vector<Eigen::Vector3d>> normalBuffer(height, std::vector<Eigen::Vector3d>(width, Eigen::Vector3d(0, 0, 1)));
+
+        //Known noise gives a ground truth
+        std::mt19937 engine(0);
+        std::normal_distribution<double> distribution(0.0, sigma);
+        for(auto y = 0; y < height; ++y)
+        {
+            for(auto x = 0; x < width; ++x)
+            {
+                cleanBuffer[y][x] = scaled->ImageBuffer[offsetY + y][offsetX + x];
+                noisyBuffer[y][x] = cleanBuffer[y][x] + distribution(engine);
+            }
+        }
+        FloatingPointImageData clean(width, height, cleanBuffer, normalBuffer);
+        FloatingPointImageData noisy(width, height, noisyBuffer, normalBuffer);
+
+        std::unique_ptr<ImageEvaluationData> noisyResult(psnrService.Process(&noisy, &clean, 1.0));
+
+        DenoiseSetting twoTierSetting;
+        twoTierSetting.TwoTierScheduling = true;
+
+        //PSNR per pyramid depth, the time of each level is printed by the repository
+        DenoiseSetting twoLevelSetting;
+        twoLevelSetting.PyramidLevels = 2;
+
+        const std::vector<std::tuple<std::string, DenoiseImageService::Mode, DenoiseSetting>> modes =
+        {
+            std::tuple("Circle"s, DenoiseImageService::Mode::CIRCLE, DenoiseSetting()),
+            std::tuple("TaubinEllipse"s, DenoiseImageService::Mode::TAUBIN_ELLIPSE, DenoiseSetting()),
+            std::tuple("Ellipse"s, DenoiseImageService::Mode::ELLIPSE, DenoiseSetting()),
+            std::tuple("HyperEllipse"s, DenoiseImageService::Mode::HYPER_ELLIPSE, DenoiseSetting()),
+            std::tuple("EllipseTwoTier"s, DenoiseImageService::Mode::ELLIPSE, twoTierSetting),
+            std::tuple("HyperTwoTier"s, DenoiseImageService::Mode::HYPER_ELLIPSE, twoTierSetting),
+            std::tuple("EllipseSIMD"s, DenoiseImageService::Mode::ELLIPSE_SIMD, DenoiseSetting()),
+            std::tuple("HyperEllipseSIMD"s, DenoiseImageService::Mode::HYPER_ELLIPSE_SIMD, DenoiseSetting()),
+            std::tuple("AdaptiveEllipse"s, DenoiseImageService::Mode::ADAPTIVE_ELLIPSE, DenoiseSetting()),
+            std::tuple("AdaptiveHyper"s, DenoiseImageService::Mode::ADAPTIVE_HYPER_ELLIPSE, DenoiseSetting()),
+            std::tuple("PyramidEllipse2"s, DenoiseImageService::Mode::PYRAMID_ELLIPSE, twoLevelSetting),
+            std::tuple("PyramidEllipse3"s, DenoiseImageService::Mode::PYRAMID_ELLIPSE, DenoiseSetting()),
+            std::tuple("PyramidHyper"s, DenoiseImageService::Mode::PYRAMID_HYPER_ELLIPSE, DenoiseSetting()),
+            std::tuple("GuidedFilter"s, DenoiseImageService::Mode::GUIDED_FILTER, DenoiseSetting()),
+            std::tuple("GridBilateral"s, DenoiseImageService::Mode::GRID_BILATERAL, DenoiseSetting()),
+            std::tuple("Anytime200ms"s, DenoiseImageService::Mode::ANYTIME_ELLIPSE, DenoiseSetting()),
+        };
+
+        std::vector<std::tuple<std::string, long long, double, double>> results;
+        for(const auto& mode : modes)
+        {
+            DenoiseImageService denoiseService(std::get<1>(mode), std::get<2>(mode));
+
+            IDenoiseImageDataRepository::ModelMaps modelMaps;
+            auto start = std::chrono::system_clock::now();
+            std::unique_ptr<FloatingPointImageData> denoised(denoiseService.Process({ &noisy }, 1, nullptr, &modelMaps)[0]);
+            auto end = std::chrono::system_clock::now();
+
+            std::unique_ptr<ImageEvaluationData> result(psnrService.Process(denoised.get(), &clean, 1.0));
+
+            //PSNR of the coarser pyramid levels against the clean image downsampled the same way, the time of each level is printed above
+            auto cleanLevel = clean.ImageBuffer;
+            auto level = 1;
+            for(auto plane : denoiseService.GetLevels())
+            {
+                std::unique_ptr<FloatingPointImageData> denoisedLevel(plane);
+                cleanLevel = ImageInformationAnalyzer::Misc::ImageUtility::PyramidDown(cleanLevel);
+                FloatingPointImageData cleanLevelData(denoisedLevel->Width, denoisedLevel->Height, cleanLevel, denoisedLevel->NormalBuffer);
+
+                std::unique_ptr<ImageEvaluationData> levelResult(psnrService.Process(denoisedLevel.get(), &cleanLevelData, 1.0));
+                std::cout << std::get<0>(mode) << " level "s << level++ << ": "s << denoisedLevel->Width << "x"s << denoisedLevel->Height << ", PSNR: "s << levelResult->Result << "dB"s << std::endl;
+            }
+
+            //Share of the pixels refitted by the expensive model, 100% unless the mode is adaptive
+            auto refinedRatio = 1.0;
+            if(!modelMaps.empty())
+            {
+                auto refined = 0.0;
+                for(const auto& line : modelMaps[0]->ImageBuffer)
+                {
+                    for(auto model : line)
+                    {
+                        //The anytime mode marks pixels not reached with -1
+                        if(model > 0) refined += model;
+                    }
+                }
+                refinedRatio = refined / ((double)width * height);
+            }
+
+            results.push_back(std::tuple(std::get<0>(mode), std::chrono::duration_cast<std::chrono::milliseconds>(end - start).count(), result->Result, refinedRatio));
+        }
+
+        std::cout << "Crop: "s << width << "x"s << height << ", sigma: "s << sigma << ", noisy PSNR: "s << noisyResult->Result << std::endl;
+        for(const auto& result : results)
+        {
+            std::cout << std::setw(16) << std::get<0>(result) << std::setw(10) << std::get<1>(result) << "ms"s << std::setw(12) << std::setprecision(5) << std::get<2>(result) << "dB"s << std::setw(10) << std::setprecision(3) << 100.0 * std::get<3>(result) << "%"s << std::endl;
+        }
+    }
+    catch(const std::exception& e)
+    {
+        std::cout << "Exception: "s << e.what() << std::endl;
+    }
+
+    return 0;
+}
@@ -18,6 +18,15 @@ int main(int argc, char* argv[])
     {
         iip.LoadImage(filepath);
         iip.Scale(); //Must excecute Scaler for Ellipse/HyperEllipse
+
+        //Decimated result at once, full resolution tiles follow
+        if(argc > 2 && std::string(argv[2]) == "--preview"s)
+        {
+            iip.Preview();
+            iip.ShowPreview();
+            return 0;
+        }
+
         iip.DenoiseImage();
         iip.Evaluate();
         iip.Diff();
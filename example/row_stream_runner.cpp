@@ -0,0 +1,30 @@
+#include <iostream>
+
+#include "RowStreamPresenter.hpp"
+
+//Denoise, evaluation, differential and histogram of an image row by row, e.g. a panorama larger than the memory
+//row_stream_runner <image (ppm / pgm are decoded row by row)> [denoise mode] [output directory] [output extension]
+int main(int argc, char* argv[])
+{
+    if(argc < 2) return -1;
+
+    using namespace ImageInformationAnalyzer::Presentation;
+
+    try
+    {
+        RowStreamSetting setting;
+        if(argc > 2) setting.DenoiseMode = BatchPresenter::GetDenoiseMode(argv[2]);
+        if(argc > 3) setting.OutputDirectory = argv[3];
+        if(argc > 4) setting.Extension = argv[4];
+
+        RowStreamPresenter presenter(setting);
+        presenter.Run(argv[1]);
+        return 0;
+    }
+    catch(const std::exception& e)
+    {
+        std::cout << "Exception: "s << e.what() << std::endl;
+    }
+
+    return -1;
+}
@@ -0,0 +1,78 @@
+
+#include <chrono>
+#include <cstdlib>
+#include <filesystem>
+#include <iostream>
+#include <thread>
+#include <vector>
+
+#include "ShardedBatchPresenter.hpp"
+
+using namespace std::string_literals;
+
+//Throughput of 1, 2, 4, ... shard_runner processes on the same batch, each from a fresh work directory
+//Each process is pinned to its own share of the processors, so that the processes don't oversubscribe the host
+//shard_benchmark <image directory | list file> <setting file> [max processes] [shard_runner path]
+int main(int argc, char* argv[])
+{
+    if(argc < 3) return -1;
+
+    using namespace ImageInformationAnalyzer::Presentation;
+
+    const std::string input(argv[1]);
+    const auto settingPath = std::filesystem::absolute(argv[2]).string();
+    const auto maxProcessCount = argc > 3 ? std::max(std::stoi(argv[3]), 1) : (int)std::thread::hardware_concurrency();
+    const std::string shardRunner = argc > 4 ? argv[4] : "shard_runner"s;
+
+    try
+    {
+        auto files = BatchPresenter::GetInputFiles(input);
+        if(files.empty()) throw std::invalid_argument("no input images");
+
+        auto baseThroughput = 0.0;
+        for(auto processCount = 1; processCount <= maxProcessCount; processCount *= 2)
+        {
+            auto workDirectory = std::filesystem::temp_directory_path() / ("shard_benchmark_"s + std::to_string(processCount));
+            std::filesystem::remove_all(workDirectory);
+            ShardedBatchPresenter::Prepare(workDirectory.string(), files);
+
+            //Processors of each process, shared round robin when there are more processes than processors
+            const auto processorCount = std::max((int)std::thread::hardware_concurrency(), 1);
+            const auto processorsPerProcess = std::max(processorCount / processCount, 1);
+
+            //One thread waits for each process
+            auto start = std::chrono::steady_clock::now();
+            std::vector<std::thread> threads;
+            for(auto i = 0; i < processCount; ++i)
+            {
+                threads.emplace_back([&, i]
+                {
+                    const auto processors = " 0 "s + std::to_string((i * processorsPerProcess) % processorCount) + " "s + std::to_string(processorsPerProcess);
+                #ifdef _WIN32
+                    auto command = "\"\""s + shardRunner + "\" work \""s + workDirectory.string() + "\" worker"s + std::to_string(i) + " \""s + settingPath + "\""s + processors + " > NUL\""s;
+                #else
+                    auto command = "\""s + shardRunner + "\" work \""s + workDirectory.string() + "\" worker"s + std::to_string(i) + " \""s + settingPath + "\""s + processors + " > /dev/null"s;
+                #endif
+                    std::system(command.c_str());
+                });
+            }
+            for(auto& thread : threads)
+            {
+                thread.join();
+            }
+            auto seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+            auto throughput = files.size() / seconds;
+            if(processCount == 1) baseThroughput = throughput;
+
+            std::cout << processCount << " processes x "s << processorsPerProcess << " processors: "s << seconds << "s, "s << throughput << " images/s, scaling "s << throughput / baseThroughput << "x, efficiency "s << 100.0 * throughput / (baseThroughput * processCount) << "%"s << std::endl;
+        }
+        return 0;
+    }
+    catch(const std::exception& e)
+    {
+        std::cout << "Exception: "s << e.what() << std::endl;
+    }
+
+    return -1;
+}
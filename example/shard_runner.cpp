@@ -0,0 +1,88 @@
+
+#include <iostream>
+#include <thread>
+
+#ifdef _WIN32
+#define NOMINMAX
+#include <windows.h>
+#elif defined(__linux__)
+#include <sched.h>
+#endif
+
+#include "ShardedBatchPresenter.hpp"
+
+using namespace std::string_literals;
+
+//Keeps this process on the processors [first, first + count)
+//The thread pools of the parallel algorithms size themselves from the affinity, so count is also the thread count of the worker
+//Must be called before the first parallel algorithm runs
+static void SetProcessorRange(const int first, const int count)
+{
+    const auto processorCount = (int)std::thread::hardware_concurrency();
+    if(first < 0 || count < 1 || first + count > processorCount || first + count > 64) throw std::invalid_argument("processor range out of 0-"s + std::to_string(std::min(processorCount, 64) - 1));
+
+#ifdef _WIN32
+    DWORD_PTR mask = 0;
+    for(auto processor = first; processor < first + count; ++processor)
+    {
+        mask |= (DWORD_PTR)1 << processor;
+    }
+    if(!SetProcessAffinityMask(GetCurrentProcess(), mask)) throw std::runtime_error("SetProcessAffinityMask() failed");
+#elif defined(__linux__)
+    cpu_set_t set;
+    CPU_ZERO(&set);
+    for(auto processor = first; processor < first + count; ++processor)
+    {
+        CPU_SET(processor, &set);
+    }
+    if(sched_setaffinity(0, sizeof(set), &set) != 0) throw std::runtime_error("sched_setaffinity() failed");
+#else
+    throw std::runtime_error("processor range is not supported on this platform");
+#endif
+}
+
+//Batch shared by several processes through a work directory
+//  shard_runner prepare <work directory> <image directory | list file>
+//  shard_runner work <work directory> <worker name> [setting file] [reclaim seconds] [first processor] [processor count]
+//  shard_runner merge <work directory>
+//Give the setting an absolute output directory when the workers run on different hosts
+//Without a processor range each worker uses all the processors, give the workers on one host disjoint ranges
+int main(int argc, char* argv[])
+{
+    if(argc < 3) return -1;
+
+    using namespace ImageInformationAnalyzer::Presentation;
+
+    try
+    {
+        std::string command(argv[1]);
+        std::string workDirectory(argv[2]);
+
+        if(command == "prepare"s && argc > 3)
+        {
+            auto added = ShardedBatchPresenter::Prepare(workDirectory, BatchPresenter::GetInputFiles(argv[3]));
+            std::cout << "Prepared: "s << added << " images"s << std::endl;
+            return 0;
+        }
+        if(command == "work"s && argc > 3)
+        {
+            auto setting = argc > 4 ? BatchPresenter::ReadSetting(argv[4]) : BatchSetting();
+            auto reclaimSeconds = argc > 5 ? std::stoi(argv[5]) : 0;
+            if(argc > 7) SetProcessorRange(std::stoi(argv[6]), std::stoi(argv[7]));
+
+            ShardedBatchPresenter presenter(workDirectory, argv[3], reclaimSeconds);
+            return presenter.Run(setting) == 0 ? 0 : 1;
+        }
+        if(command == "merge"s)
+        {
+            ShardedBatchPresenter::Merge(workDirectory);
+            return 0;
+        }
+    }
+    catch(const std::exception& e)
+    {
+        std::cout << "Exception: "s << e.what() << std::endl;
+    }
+
+    return -1;
+}
@@ -0,0 +1,37 @@
+
+#include <iostream>
+
+#include "StreamPresenter.hpp"
+
+//Frames of a video or of an image directory, e.g. a clip of the hand
+//stream_runner <video | image directory> [denoise mode] [output directory] [max frames] [--no-light]
+int main(int argc, char* argv[])
+{
+    if(argc < 2) return -1;
+
+    using namespace ImageInformationAnalyzer::Presentation;
+
+    try
+    {
+        StreamSetting setting;
+        std::vector<std::string> arguments;
+        for(auto i = 2; i < argc; ++i)
+        {
+            std::string argument(argv[i]);
+            if(argument == "--no-light"s) setting.EstimateLight = false;
+            else arguments.push_back(argument);
+        }
+        if(arguments.size() > 0) setting.DenoiseMode = BatchPresenter::GetDenoiseMode(arguments[0]);
+        if(arguments.size() > 1) setting.OutputDirectory = arguments[1];
+        if(arguments.size() > 2) setting.MaxFrameCount = std::stoi(arguments[2]);
+
+        StreamPresenter presenter(setting);
+        return presenter.Run(argv[1]) > 0 ? 0 : 1;
+    }
+    catch(const std::exception& e)
+    {
+        std::cout << "Exception: "s << e.what() << std::endl;
+    }
+
+    return -1;
+}
@@ -0,0 +1,39 @@
+#include <iostream>
+
+#include "BatchPresenter.hpp"
+#include "TiledBatchPresenter.hpp"
+
+//Denoise, evaluation and differential of a mosaic larger than the memory, tile by tile on memory mapped scratch files
+//tiled_runner <image (ppm / pgm are decoded row by row)> [denoise mode] [memory budget MB] [tile size] [output directory] [--no-difference]
+int main(int argc, char* argv[])
+{
+    if(argc < 2) return -1;
+
+    using namespace ImageInformationAnalyzer::Presentation;
+
+    try
+    {
+        TiledBatchSetting setting;
+        std::vector<std::string> arguments;
+        for(auto i = 2; i < argc; ++i)
+        {
+            std::string argument(argv[i]);
+            if(argument == "--no-difference"s) setting.TakeDifference = false;
+            else arguments.push_back(argument);
+        }
+        if(arguments.size() > 0) setting.DenoiseMode = BatchPresenter::GetDenoiseMode(arguments[0]);
+        if(arguments.size() > 1) setting.Tiled.MemoryBudget = (size_t)std::stoul(arguments[1]) * 1024 * 1024;
+        if(arguments.size() > 2) setting.Tiled.TileSize = std::stoi(arguments[2]);
+        if(arguments.size() > 3) setting.OutputDirectory = arguments[3];
+
+        TiledBatchPresenter presenter(setting);
+        presenter.Run(argv[1]);
+        return 0;
+    }
+    catch(const std::exception& e)
+    {
+        std::cout << "Exception: "s << e.what() << std::endl;
+    }
+
+    return -1;
+}
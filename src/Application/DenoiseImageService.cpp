@@ -1,8 +1,17 @@
 
 #include "DenoiseImageService.hpp"
+#include "AdaptiveDenoiseDataRepository.hpp"
+#include "AnytimeDenoiseDataRepository.hpp"
 #include "CircleDenoiseDataRepository.hpp"
 #include "EllipseDenoiseDataRepository.hpp"
+#include "GridBilateralDenoiseDataRepository.hpp"
+#include "GuidedFilterDenoiseDataRepository.hpp"
 #include "HyperEllipseDenoiseDataRepository.hpp"
+#include "PyramidDenoiseDataRepository.hpp"
+#include "SimdEllipseDenoiseDataRepository.hpp"
+#include "SimdHyperEllipseDenoiseDataRepository.hpp"
+#include "TaubinEllipseDenoiseDataRepository.hpp"
+#include "TemporalDenoiseDataRepository.hpp"
 
 namespace ImageInformationAnalyzer
 {
@@ -10,20 +19,59 @@ namespace ImageInformationAnalyzer
     {
         using namespace Infrastructure;
 
-        DenoiseImageService::DenoiseImageService(Mode mode)
+        DenoiseImageService::DenoiseImageService(Mode mode, const DenoiseSetting& setting)
         {
             repository_ = nullptr;
 
             switch(mode)
             {
                 case Mode::CIRCLE:
-                    repository_ = new CircleDenoiseDataRepository();
+                    repository_ = new CircleDenoiseDataRepository(setting);
+                    break;
+                case Mode::TAUBIN_ELLIPSE:
+                    repository_ = new TaubinEllipseDenoiseDataRepository(setting);
                     break;
                 case Mode::ELLIPSE:
-                    repository_ = new EllipseDenoiseDataRepository();
+                    repository_ = new EllipseDenoiseDataRepository(setting);
                     break;
                 case Mode::HYPER_ELLIPSE:
-                    repository_ = new HyperEllipseDenoiseDataRepository();
+                    repository_ = new HyperEllipseDenoiseDataRepository(setting);
+                    break;
+                case Mode::ELLIPSE_SIMD:
+                    repository_ = new SimdEllipseDenoiseDataRepository(setting);
+                    break;
+                case Mode::HYPER_ELLIPSE_SIMD:
+                    repository_ = new SimdHyperEllipseDenoiseDataRepository(setting);
+                    break;
+                case Mode::ADAPTIVE_ELLIPSE:
+                    repository_ = new AdaptiveEllipseDenoiseDataRepository(setting);
+                    break;
+                case Mode::ADAPTIVE_HYPER_ELLIPSE:
+                    repository_ = new AdaptiveHyperEllipseDenoiseDataRepository(setting);
+                    break;
+                case Mode::PYRAMID_ELLIPSE:
+                    repository_ = new PyramidEllipseDenoiseDataRepository(setting);
+                    break;
+                case Mode::PYRAMID_HYPER_ELLIPSE:
+                    repository_ = new PyramidHyperEllipseDenoiseDataRepository(setting);
+                    break;
+                case Mode::GUIDED_FILTER:
+                    repository_ = new GuidedFilterDenoiseDataRepository(setting);
+                    break;
+                case Mode::GRID_BILATERAL:
+                    repository_ = new GridBilateralDenoiseDataRepository(setting);
+                    break;
+                case Mode::ANYTIME_ELLIPSE:
+                    repository_ = new AnytimeEllipseDenoiseDataRepository(setting);
+                    break;
+                case Mode::ANYTIME_HYPER_ELLIPSE:
+                    repository_ = new AnytimeHyperEllipseDenoiseDataRepository(setting);
+                    break;
+                case Mode::TEMPORAL_ELLIPSE:
+                    repository_ = new TemporalEllipseDenoiseDataRepository(setting);
+                    break;
+                case Mode::TEMPORAL_HYPER_ELLIPSE:
+                    repository_ = new TemporalHyperEllipseDenoiseDataRepository(setting);
                     break;
                 default:
                     break;
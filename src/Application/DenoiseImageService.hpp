@@ -2,6 +2,8 @@
 
 #include "DenoiseImageData.hpp"
 
+#include <functional>
+#include <future>
 #include <thread>
 #include <iomanip> //for cout
 
@@ -17,52 +19,121 @@ namespace ImageInformationAnalyzer
             enum class Mode
             {
                 CIRCLE,
+                TAUBIN_ELLIPSE, //closed form, between CIRCLE and ELLIPSE in cost and accuracy
                 ELLIPSE,
-                HYPER_ELLIPSE
+                HYPER_ELLIPSE,
+                ELLIPSE_SIMD, //ELLIPSE with several pixels per SIMD lane
+                HYPER_ELLIPSE_SIMD,
+                ADAPTIVE_ELLIPSE, //CIRCLE, ELLIPSE only where the Circle fit is poor
+                ADAPTIVE_HYPER_ELLIPSE,
+                PYRAMID_ELLIPSE, //coarse to fine, the coarser level gives the start value
+                PYRAMID_HYPER_ELLIPSE,
+                GUIDED_FILTER, //box filters only, O(1) per pixel, for previews
+                GRID_BILATERAL,
+                ANYTIME_ELLIPSE, //CIRCLE, then ELLIPSE tile by tile until DenoiseSetting::TimeBudget
+                ANYTIME_HYPER_ELLIPSE,
+                TEMPORAL_ELLIPSE, //frames of a video, each pixel starts from its conic of the previous frame
+                TEMPORAL_HYPER_ELLIPSE
             };
 
             IDenoiseImageDataRepository* repository_;
 
+            //Called with the percentage at each poll, e.g. to forward it to a client
+            std::function<void(double)> progressCallback_;
+
+            //No progress and statistics on std::cout
+            bool quiet_ = false;
+
         public:
-            explicit DenoiseImageService(Mode mode);
+            explicit DenoiseImageService(Mode mode, const DenoiseSetting& setting = DenoiseSetting());
 
-            FloatingPointImageData* Process(const FloatingPointImageData* data)
+            //Pixels outside of the mask keep the input
+            FloatingPointImageData* Process(const FloatingPointImageData* data, const MaskData* mask = nullptr)
             {
+                return Process(std::vector<const FloatingPointImageData*>{ data }, mask)[0];
+            }
+
+            //Planes of the same size (e.g. R, G and B) in one traversal
+            std::vector<FloatingPointImageData*> Process(const std::vector<const FloatingPointImageData*>& data, const MaskData* mask = nullptr)
+            {
+                return Process(data, 1, mask);
+            }
+
+            //Denoises the result again passCount - 1 times without intermediate images
+            //modelMaps: if not nullptr, receives the model of each pixel, see IDenoiseImageDataRepository::ProcessPasses()
+            std::vector<FloatingPointImageData*> Process(const std::vector<const FloatingPointImageData*>& data, const int passCount, const MaskData* mask = nullptr, IDenoiseImageDataRepository::ModelMaps* modelMaps = nullptr)
+            {
+                //set to 0%, the repository counts up through all the channels and passes
                 std::atomic<int> processedPixel(0);
+                const auto pixelCount = mask != nullptr ? (double)mask->GetPixelCount() : (double)data[0]->Width * data[0]->Height;
+
+                repository_->SetMask(mask);
 
-                auto done = false;
                 auto elapsedMillisecounds = 0ll;
 
-                FloatingPointImageData* result = nullptr;
+                std::vector<FloatingPointImageData*> result;
 
-                std::thread thread([&]
+                //Returns as soon as the work is done, small calls (e.g. preview tiles) don't wait for the next poll
+                auto future = std::async(std::launch::async, [&]
                 {
                     auto start = std::chrono::system_clock::now();
                     {
-                        result = repository_->Process(data, &processedPixel);
+                        result = repository_->ProcessPasses(data, passCount, &processedPixel, modelMaps);
                     }
                     auto end = std::chrono::system_clock::now();
                     elapsedMillisecounds = std::chrono::duration_cast<std::chrono::milliseconds>(end - start).count();
-                    done = true;
                 });
 
-                while(!done)
+            #ifdef _DEBUG
+                const auto pollInterval = std::chrono::milliseconds(1000);
+            #else
+                const auto pollInterval = std::chrono::milliseconds(100);
+            #endif
+                while(future.wait_for(pollInterval) != std::future_status::ready)
                 {
-                #ifdef _DEBUG
-                    std::this_thread::sleep_for(std::chrono::seconds(1));
-                #else
-                    std::this_thread::sleep_for(std::chrono::milliseconds(100));
-                #endif
-
-                    std::cout << "Progress: "s << std::setprecision(3) << 100.0 * processedPixel / ((double)data->Width * data->Height) << "%"s << std::endl;
+                    const auto progress = 100.0 * processedPixel / (pixelCount * data.size() * passCount);
+                    if(!quiet_) std::cout << "Progress: "s << std::setprecision(3) << progress << "%"s << std::endl;
+                    if(progressCallback_) progressCallback_(progress);
                 }
-                thread.join();
+                repository_->SetMask(nullptr);
+                future.get();
 
-                std::cout << "Denoise completed: "s << elapsedMillisecounds << "ms"s << std::endl;
+                if(!quiet_) std::cout << "Denoise completed: "s << elapsedMillisecounds << "ms"s << std::endl;
 
                 return result;
             }
 
+            //Following calls print nothing (the progress callback is still called), e.g. for the many small calls of a tile loop
+            void SetQuiet(const bool quiet)
+            {
+                quiet_ = quiet;
+                repository_->SetQuiet(quiet);
+            }
+
+            //nullptr stops the notification
+            void SetProgressCallback(const std::function<void(double)>& progressCallback)
+            {
+                progressCallback_ = progressCallback;
+            }
+
+            //Halo a tile must be read with to give the same result as the whole image, for one pass
+            int GetWindowRadius() const
+            {
+                return repository_->GetWindowRadius();
+            }
+
+            //Coarser pyramid levels of the last plane processed, see IDenoiseImageDataRepository::GetLevels()
+            std::vector<FloatingPointImageData*> GetLevels() const
+            {
+                return repository_->GetLevels();
+            }
+
+            //One row of a row stream, see IDenoiseImageDataRepository::ProcessRow(). Returns the number of failed pixels
+            int ProcessRow(const std::vector<std::vector<const std::vector<double>*>>& rows, std::vector<std::vector<double>>& results)
+            {
+                return repository_->ProcessRow(rows, results);
+            }
+
             virtual ~DenoiseImageService()
             {
                 delete repository_;
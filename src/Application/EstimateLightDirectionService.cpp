@@ -1,6 +1,8 @@
 
 #include "EstimateLightDirectionService.hpp"
 #include "PhongModelLightDirectionDataRepository.hpp"
+#include "StratifiedSamplingPhongModelLightDirectionDataRepository.hpp"
+#include "PyramidPhongModelLightDirectionDataRepository.hpp"
 
 namespace ImageInformationAnalyzer
 {
@@ -8,9 +10,24 @@ namespace ImageInformationAnalyzer
     {
         using namespace Infrastructure;
 
-        EstimateLightDirectionService::EstimateLightDirectionService()
+        EstimateLightDirectionService::EstimateLightDirectionService(Mode mode, const LightEstimationSetting& setting)
         {
-            repository_ = new PhongModelLightDirectionDataRepository();
+            repository_ = nullptr;
+
+            switch(mode)
+            {
+                case Mode::WHOLE_PIXEL:
+                    repository_ = new PhongModelLightDirectionDataRepository(setting);
+                    break;
+                case Mode::STRATIFIED_SAMPLING:
+                    repository_ = new StratifiedSamplingPhongModelLightDirectionDataRepository(setting);
+                    break;
+                case Mode::PYRAMID:
+                    repository_ = new PyramidPhongModelLightDirectionDataRepository(setting);
+                    break;
+                default:
+                    break;
+            }
         }
 
     }
@@ -3,6 +3,7 @@
 
 #include "LightEstimationData.hpp"
 
+#include <future>
 #include <thread>
 #include <iostream>
 #include <iomanip> //for cout
@@ -18,21 +19,31 @@ namespace ImageInformationAnalyzer
             ILightEstimationDataRepository* repository_;
 
         public:
-            explicit EstimateLightDirectionService();
+            enum class Mode
+            {
+                WHOLE_PIXEL,
+                STRATIFIED_SAMPLING, //fit on a gradient weighted subset, refined until stable
+                PYRAMID //coarse to fine on a Gaussian pyramid
+            };
+
+            explicit EstimateLightDirectionService(Mode mode = Mode::WHOLE_PIXEL, const LightEstimationSetting& setting = LightEstimationSetting());
 
-            virtual FloatingPointImageData* Process(const FloatingPointImageData* denoisedR, const FloatingPointImageData* denoisedG, const FloatingPointImageData* denoisedB, const FloatingPointImageData* differentialB_G, const double pixelPitch)
+            //Residuals of the pixels inside of the mask only
+            virtual FloatingPointImageData* Process(const FloatingPointImageData* denoisedR, const FloatingPointImageData* denoisedG, const FloatingPointImageData* denoisedB, const FloatingPointImageData* differentialB_G, const double pixelPitch, const MaskData* mask = nullptr)
             {
                 if(denoisedR->Width != denoisedG->Width || denoisedR->Width != denoisedB->Width) throw std::invalid_argument("Input image sizes are not the same!");
                 if(denoisedR->Height != denoisedG->Height || denoisedR->Height != denoisedB->Height) throw std::invalid_argument("Input image sizes are not the same!");
 
                 std::atomic<double> progress(0);
 
-                auto done = false;
+                repository_->SetMask(mask);
+
                 auto elapsedMillisecounds = 0ll;
 
                 FloatingPointImageData* result = nullptr;
 
-                std::thread thread([&]
+                //Returns as soon as the work is done, the frames of a video must not wait for the next poll
+                auto future = std::async(std::launch::async, [&]
                 {
                     auto start = std::chrono::system_clock::now();
                     {
@@ -40,20 +51,19 @@ namespace ImageInformationAnalyzer
                     }
                     auto end = std::chrono::system_clock::now();
                     elapsedMillisecounds = std::chrono::duration_cast<std::chrono::milliseconds>(end - start).count();
-                    done = true;
                 });
 
-                while(!done)
+            #ifdef _DEBUG
+                const auto pollInterval = std::chrono::seconds(10);
+            #else
+                const auto pollInterval = std::chrono::seconds(3);
+            #endif
+                while(future.wait_for(pollInterval) != std::future_status::ready)
                 {
-                #ifdef _DEBUG
-                    std::this_thread::sleep_for(std::chrono::seconds(10));
-                #else
-                    std::this_thread::sleep_for(std::chrono::seconds(3));
-                #endif
-
                     std::cout << "Progress: "s << std::setprecision(3) << 100.0 * progress << "%"s << std::endl;
                 }
-                thread.join();
+                repository_->SetMask(nullptr);
+                future.get();
 
                 std::cout << "Light estimation completed: "s << elapsedMillisecounds << "ms"s << std::endl;
 
@@ -0,0 +1,15 @@
+#include "FrameSourceService.hpp"
+#include "VideoFrameSourceDataRepository.hpp"
+
+namespace ImageInformationAnalyzer
+{
+    namespace Application
+    {
+        using namespace Infrastructure;
+
+        FrameSourceService::FrameSourceService()
+        {
+            repository_ = new VideoFrameSourceDataRepository();
+        }
+    }
+}
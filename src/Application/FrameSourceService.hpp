@@ -0,0 +1,42 @@
+#pragma once
+
+#include "FrameSourceData.hpp"
+
+namespace ImageInformationAnalyzer
+{
+    namespace Application
+    {
+        using namespace Domain;
+
+        //Frames of a video file or of an image directory
+        class FrameSourceService
+        {
+            IFrameSourceDataRepository* repository_;
+
+        public:
+            explicit FrameSourceService();
+
+            void Open(const std::string& source)
+            {
+                repository_->Open(source);
+            }
+
+            //R, G and B of the next frame (0 - 255), empty after the last one
+            std::vector<FloatingPointImageData*> Read()
+            {
+                return repository_->Read();
+            }
+
+            //0 if unknown
+            double GetFrameRate() const
+            {
+                return repository_->GetFrameRate();
+            }
+
+            virtual ~FrameSourceService()
+            {
+                delete repository_;
+            }
+        };
+    }
+}
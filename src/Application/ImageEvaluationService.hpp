@@ -23,13 +23,18 @@ namespace ImageInformationAnalyzer
         public:
             explicit ImageEvaluationService(Mode mode);
 
-            ImageEvaluationData* Process(const FloatingPointImageData* data1, const FloatingPointImageData* data2, const double maxValue)
+            //Pixels inside of the mask only
+            ImageEvaluationData* Process(const FloatingPointImageData* data1, const FloatingPointImageData* data2, const double maxValue, const MaskData* mask = nullptr)
             {
                 if(data1->Width != data2->Width || data1->Height != data2->Height)
                 {
                     throw std::invalid_argument("Image sizes are NOT the same!");
                 }
-                return repository_->Process(data1, data2, maxValue);
+
+                repository_->SetMask(mask);
+                auto evaluation = repository_->Process(data1, data2, maxValue);
+                repository_->SetMask(nullptr);
+                return evaluation;
             }
 
             virtual ~ImageEvaluationService()
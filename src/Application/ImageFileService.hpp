@@ -34,12 +34,28 @@ namespace ImageInformationAnalyzer
 
                 throw std::logic_error("file type not supported!"s);
             }
+
+            //R, G and B from a single decode
+            virtual std::vector<FloatingPointImageData*> Load(const std::string& filePath)
+            {
+                auto extensionPos = filePath.rfind("."s);
+                if(extensionPos == std::string::npos) throw std::invalid_argument("invalid image file!"s);
+
+                auto extension = filePath.substr(extensionPos + 1);
+                if(graphicRepository_->IsExtensionSupported(extension))
+                {
+                    return graphicRepository_->LoadChannels(filePath);
+                }
+
+                throw std::logic_error("file type not supported!"s);
+            }
+
             virtual bool Store(const FloatingPointImageData* r, const FloatingPointImageData* g, const FloatingPointImageData* b, const std::string& filePath)
             {
                 auto extensionPos = filePath.rfind("."s);
                 if(extensionPos == std::string::npos) throw std::invalid_argument("invalid image file!"s);
 
-                auto extension = filePath.substr(filePath.length() + 1);
+                auto extension = filePath.substr(extensionPos + 1);
                 
                 if(graphicRepository_->IsExtensionSupported(extension))
                 {
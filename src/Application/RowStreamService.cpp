@@ -0,0 +1,19 @@
+#include "RowStreamService.hpp"
+#include "GraphicRowStreamDataRepository.hpp"
+#include "FileRowSpillDataRepository.hpp"
+
+namespace ImageInformationAnalyzer
+{
+    namespace Application
+    {
+        using namespace Infrastructure;
+
+        RowStreamService::RowStreamService(DenoiseImageService::Mode mode, const DenoiseSetting& setting) : denoiseService_(mode, setting)
+        {
+            sourceRepository_ = new GraphicRowSourceDataRepository();
+            denoisedRepository_ = new GraphicRowSinkDataRepository();
+            differentialRepository_ = new GraphicRowSinkDataRepository();
+            spillRepository_ = new FileRowSpillDataRepository();
+        }
+    }
+}
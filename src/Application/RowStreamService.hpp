@@ -0,0 +1,337 @@
+#pragma once
+
+#include "DenoiseImageService.hpp"
+#include "ImageUtility.hpp"
+#include "RowStreamData.hpp"
+
+#include <array>
+#include <cmath>
+#include <future>
+#include <limits>
+#include <memory>
+#include <iomanip> //for cout
+
+namespace ImageInformationAnalyzer
+{
+    namespace Application
+    {
+        using namespace Domain;
+
+        struct RowStreamResult
+        {
+            int Width = 0;
+            int Height = 0;
+
+            //PSNR of the denoised R, G, B against the input
+            std::array<double, 3> Evaluations = { 0, 0, 0 };
+            int ErrorPixel = 0;
+
+            //WholePixel differential B - (a * R + b)
+            double BalanceA = 0;
+            double BalanceB = 0;
+            double DifferentialMinValue = 0;
+            double DifferentialMaxValue = 0;
+            //Differential between its min and max, normalized like RoundOffHistogramDataRepository
+            std::vector<double> HistogramB_R;
+
+            //Line buffers, rows and the buffers of the decoder and the encoders at the peak
+            size_t PeakBufferBytes = 0;
+            //Denoised B and R that wait for the differential fit
+            size_t SpillBytes = 0;
+
+            long long Milliseconds = 0;
+        };
+
+        //Scale -> denoise -> evaluation -> WholePixel differential -> histogram without any whole image in memory
+        //Rows flow from the decoder through line buffers as high as the denoise window, so the peak memory is O(width * window)
+        //The differential needs its fit over the whole image first, so the denoised B and R go to a spill file and are read back twice (range, then histogram and encoding)
+        //The results are the same as the whole image services for the per pixel denoise modes and one pass
+        class RowStreamService
+        {
+        public:
+            enum
+            {
+                HISTOGRAM_SIZE = 512
+            };
+
+        private:
+            IRowSourceDataRepository* sourceRepository_;
+            IRowSinkDataRepository* denoisedRepository_;
+            IRowSinkDataRepository* differentialRepository_;
+            IRowSpillDataRepository* spillRepository_;
+
+            DenoiseImageService denoiseService_;
+
+            //[OldMinValue, OldMaxValue] => [NewMinValue, NewMaxValue], same arithmetic as NormalizeScaleImageDataRepository
+            static inline void ScaleRow(std::vector<double>& row, const double oldMinValue, const double oldMaxValue, const double newMinValue, const double newMaxValue)
+            {
+                for(auto& value : row)
+                {
+                    auto normalized = Misc::ImageUtility::DoubleSub(value, oldMinValue) / (oldMaxValue - oldMinValue);
+                    value = Misc::ImageUtility::DoubleAdd(normalized * (newMaxValue - newMinValue), newMinValue);
+                }
+            }
+
+            //Same as WholePixelSpectrumDifferentialDataRepository
+            static inline void TakeDifferenceRow(const std::vector<double>& b, const std::vector<double>& r, const double balanceA, const double balanceB, std::vector<double>& result)
+            {
+                result.resize(b.size());
+                for(auto x = 0; x < b.size(); ++x)
+                {
+                    result[x] = Misc::ImageUtility::DoubleSub(b[x], Misc::ImageUtility::DoubleAdd(balanceA * r[x], balanceB));
+                }
+            }
+
+            void Stream(const std::string& inputPath, const std::string& denoisedPath, const std::string& differentialPath, const std::string& spillPath, RowStreamResult& result, std::atomic<int>& processedRow, std::atomic<int>& rowCount)
+            {
+                sourceRepository_->Open(inputPath);
+
+                const auto width = sourceRepository_->GetWidth();
+                const auto height = sourceRepository_->GetHeight();
+                const auto radius = denoiseService_.GetWindowRadius();
+                const auto windowSize = 2 * radius + 1;
+                if(width < windowSize || height < windowSize) throw std::invalid_argument("image must be at least as large as the denoise window");
+
+                result.Width = width;
+                result.Height = height;
+                rowCount = 3 * height;
+
+                if(!denoisedPath.empty()) denoisedRepository_->Create(denoisedPath, width, height);
+                if(!differentialPath.empty()) differentialRepository_->Create(differentialPath, width, height);
+
+                spillRepository_->Create(spillPath, width, 2);
+                result.SpillBytes = (size_t)width * height * 2 * sizeof(double);
+
+                //Fitting window of WholePixelSpectrumDifferentialDataRepository: the biggest odd square around the center, wrapped around
+                auto differentialWindowSize = std::min(width, height);
+                differentialWindowSize = differentialWindowSize % 2 == 0 ? differentialWindowSize - 1 : differentialWindowSize;
+                std::vector<char> windowColumns(width, 0);
+                std::vector<char> windowRows(height, 0);
+                for(auto offset = -differentialWindowSize / 2; offset < differentialWindowSize / 2 + 1; ++offset)
+                {
+                    windowColumns[(width / 2 + 1 + width + offset) % width] = 1;
+                    windowRows[(height / 2 + 1 + height + offset) % height] = 1;
+                }
+
+                //Ax=c of GetBalanceCoefficient()
+                auto A11 = 0.0;
+                auto A12 = 0.0;
+                auto A22 = 0.0;
+                auto c1 = 0.0;
+                auto c2 = 0.0;
+
+                std::array<double, 3> squaredErrors = { 0, 0, 0 };
+
+                //Pass 1: decode, scale, denoise, evaluation and the sums of the fit
+                std::array<std::unique_ptr<LineBuffer>, 3> buffers;
+                for(auto& buffer : buffers)
+                {
+                    buffer.reset(new LineBuffer(width, radius));
+                }
+                std::array<std::vector<double>, 3> input;
+                std::vector<std::vector<double>> denoised;
+                std::vector<std::vector<const std::vector<double>*>> windows(3, std::vector<const std::vector<double>*>(windowSize));
+                std::array<std::vector<double>, 3> encoded;
+
+                auto getBufferBytes = [&]
+                {
+                    auto bytes = sourceRepository_->GetBufferBytes() + (denoisedPath.empty() ? 0 : denoisedRepository_->GetBufferBytes()) + (differentialPath.empty() ? 0 : differentialRepository_->GetBufferBytes());
+                    bytes += denoised.size() * width * sizeof(double);
+                    for(auto c = 0; c < 3; ++c)
+                    {
+                        bytes += buffers[c]->GetBytes() + (input[c].size() + encoded[c].size()) * sizeof(double);
+                    }
+                    return bytes;
+                };
+
+                auto denoiseRow = [&](const int y)
+                {
+                    for(auto c = 0; c < 3; ++c)
+                    {
+                        for(auto offset = -radius; offset <= radius; ++offset)
+                        {
+                            windows[c][offset + radius] = &buffers[c]->GetRow((y + height + offset) % height);
+                        }
+                    }
+                    result.ErrorPixel += denoiseService_.ProcessRow(windows, denoised);
+
+                    //Denoised as original like BatchPresenter, the squared error is the same both ways
+                    for(auto c = 0; c < 3; ++c)
+                    {
+                        const auto& original = *windows[c][radius];
+                        for(auto x = 0; x < width; ++x)
+                        {
+                            auto diff = denoised[c][x] - original[x];
+                            squaredErrors[c] += diff * diff;
+                        }
+                    }
+
+                    //data1 = B, data2 = R
+                    if(windowRows[y] != 0)
+                    {
+                        for(auto x = 0; x < width; ++x)
+                        {
+                            if(windowColumns[x] == 0) continue;
+
+                            A22 += 1;
+                            A11 += std::pow(denoised[0][x], 2);
+                            A12 += denoised[0][x];
+                            c1 += denoised[0][x] * denoised[2][x];
+                            c2 += denoised[2][x];
+                        }
+                    }
+                    spillRepository_->WriteRow(y, { &denoised[2], &denoised[0] });
+
+                    if(!denoisedPath.empty())
+                    {
+                        for(auto c = 0; c < 3; ++c)
+                        {
+                            encoded[c] = denoised[c];
+                            ScaleRow(encoded[c], 0.0, 1.0, 0.0, 255.0);
+                        }
+                        denoisedRepository_->WriteRow(y, encoded[0], encoded[1], encoded[2]);
+                    }
+
+                    result.PeakBufferBytes = std::max(result.PeakBufferBytes, getBufferBytes());
+                    processedRow++;
+                };
+
+                for(auto y = 0; y < height; ++y)
+                {
+                    if(!sourceRepository_->ReadRow(input[0], input[1], input[2])) throw std::runtime_error("image ended at row "s + std::to_string(y));
+                    for(auto c = 0; c < 3; ++c)
+                    {
+                        ScaleRow(input[c], 0.0, 255.0, 0.0, 1.0);
+                        buffers[c]->Push(input[c]);
+                    }
+
+                    //The window of the row radius rows above is complete
+                    if(y >= 2 * radius) denoiseRow(y - radius);
+                }
+
+                //The bottom rows and then the top rows wrap around to each other
+                for(auto y = height - radius; y < height; ++y)
+                {
+                    denoiseRow(y);
+                }
+                for(auto y = 0; y < radius; ++y)
+                {
+                    denoiseRow(y);
+                }
+                if(!denoisedPath.empty()) denoisedRepository_->Close();
+
+                //Same as PSNRIImageEvaluationDataRepository with maxValue 1
+                for(auto c = 0; c < 3; ++c)
+                {
+                    auto mse = squaredErrors[c] / ((double)width * height);
+                    result.Evaluations[c] = 10.0 * std::log10(1.0 / mse);
+                }
+
+                Eigen::Matrix2d A;
+                A << A11, A12, A12, A22;
+                Eigen::Vector2d c;
+                c << c1, c2;
+                Eigen::FullPivLU<Eigen::Matrix2d> lu(A);
+                Eigen::Vector2d ab = lu.solve(c);
+                result.BalanceA = ab.x();
+                result.BalanceB = ab.y();
+
+                //Pass 2: range of the differential
+                std::vector<double> b;
+                std::vector<double> r;
+                std::vector<double> differential;
+                auto minValue = std::numeric_limits<double>::max();
+                auto maxValue = std::numeric_limits<double>::lowest();
+                for(auto y = 0; y < height; ++y)
+                {
+                    spillRepository_->ReadRow(y, { &b, &r });
+                    TakeDifferenceRow(b, r, result.BalanceA, result.BalanceB, differential);
+                    for(auto value : differential)
+                    {
+                        minValue = std::min(minValue, value);
+                        maxValue = std::max(maxValue, value);
+                    }
+                    processedRow++;
+                }
+                result.DifferentialMinValue = minValue;
+                result.DifferentialMaxValue = maxValue;
+
+                //Pass 3: histogram and the differential stretched to its range
+                std::vector<double> histogram(HISTOGRAM_SIZE);
+                for(auto y = 0; y < height; ++y)
+                {
+                    spillRepository_->ReadRow(y, { &b, &r });
+                    TakeDifferenceRow(b, r, result.BalanceA, result.BalanceB, differential);
+                    for(auto value : differential)
+                    {
+                        //Same as RoundOffHistogramDataRepository
+                        auto normalized = (value - minValue) / (maxValue - minValue);
+                        auto index = static_cast<int>(normalized * (HISTOGRAM_SIZE - 1.0) + 0.5);
+                        if(index >= 0 && index < HISTOGRAM_SIZE) histogram[index] += 1.0;
+                    }
+
+                    if(!differentialPath.empty())
+                    {
+                        ScaleRow(differential, minValue, maxValue, 0.0, 255.0);
+                        differentialRepository_->WriteRow(y, differential, differential, differential);
+                    }
+                    processedRow++;
+                }
+                if(!differentialPath.empty()) differentialRepository_->Close();
+
+                for(auto& value : histogram)
+                {
+                    value /= histogram.size();
+                }
+                result.HistogramB_R = histogram;
+            }
+
+        public:
+            //Per pixel denoise modes only (CIRCLE, ELLIPSE, ...), not the SIMD ones
+            explicit RowStreamService(DenoiseImageService::Mode mode, const DenoiseSetting& setting = DenoiseSetting());
+
+            //Empty output paths store nothing, the spill file is removed at the end
+            RowStreamResult Process(const std::string& inputPath, const std::string& denoisedPath, const std::string& differentialPath, const std::string& spillPath)
+            {
+                RowStreamResult result;
+                std::atomic<int> processedRow(0);
+                //Three passes over the rows, known once the file is open
+                std::atomic<int> rowCount(0);
+
+                auto future = std::async(std::launch::async, [&]
+                {
+                    auto start = std::chrono::system_clock::now();
+                    {
+                        Stream(inputPath, denoisedPath, differentialPath, spillPath, result, processedRow, rowCount);
+                    }
+                    auto end = std::chrono::system_clock::now();
+                    result.Milliseconds = std::chrono::duration_cast<std::chrono::milliseconds>(end - start).count();
+                });
+
+            #ifdef _DEBUG
+                const auto pollInterval = std::chrono::milliseconds(1000);
+            #else
+                const auto pollInterval = std::chrono::milliseconds(100);
+            #endif
+                while(future.wait_for(pollInterval) != std::future_status::ready)
+                {
+                    std::cout << "Progress: "s << std::setprecision(3) << 100.0 * processedRow / std::max((int)rowCount, 1) << "%"s << std::endl;
+                }
+                spillRepository_->Remove();
+                future.get();
+
+                std::cout << "Row stream completed: "s << result.Milliseconds << "ms"s << std::endl;
+
+                return result;
+            }
+
+            virtual ~RowStreamService()
+            {
+                delete sourceRepository_;
+                delete denoisedRepository_;
+                delete differentialRepository_;
+                delete spillRepository_;
+            }
+        };
+    }
+}
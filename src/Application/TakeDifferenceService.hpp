@@ -2,6 +2,7 @@
 
 #include "DifferentialData.hpp"
 
+#include <future>
 #include <iostream>
 #include <iomanip> //for cout
 
@@ -24,7 +25,8 @@ namespace ImageInformationAnalyzer
 
             explicit TakeDifferenceService(Mode mode);
 
-            virtual FloatingPointImageData* Process(const FloatingPointImageData* data1, const FloatingPointImageData* data2)
+            //Pixels outside of the mask are 0
+            virtual FloatingPointImageData* Process(const FloatingPointImageData* data1, const FloatingPointImageData* data2, const MaskData* mask = nullptr)
             {
                 if(data1->Width != data2->Width || data1->Height != data2->Height)
                 {
@@ -32,13 +34,16 @@ namespace ImageInformationAnalyzer
                 }
 
                 std::atomic<int> processedPixel(0);
+                const auto pixelCount = mask != nullptr ? (double)mask->GetPixelCount() : (double)data1->Width * data1->Height;
+
+                repository_->SetMask(mask);
 
-                auto done = false;
                 auto elapsedMillisecounds = 0ll;
 
                 FloatingPointImageData* result = nullptr;
 
-                std::thread thread([&]
+                //Returns as soon as the work is done, like DenoiseImageService
+                auto future = std::async(std::launch::async, [&]
                 {
                     auto start = std::chrono::system_clock::now();
                     {
@@ -46,24 +51,29 @@ namespace ImageInformationAnalyzer
                     }
                     auto end = std::chrono::system_clock::now();
                     elapsedMillisecounds = std::chrono::duration_cast<std::chrono::milliseconds>(end - start).count();
-                    done = true;
                 });
 
-                while(!done)
+            #ifdef _DEBUG
+                const auto pollInterval = std::chrono::milliseconds(1000);
+            #else
+                const auto pollInterval = std::chrono::milliseconds(100);
+            #endif
+                while(future.wait_for(pollInterval) != std::future_status::ready)
                 {
-                #ifdef _DEBUG
-                    std::this_thread::sleep_for(std::chrono::seconds(1));
-                #else
-                    std::this_thread::sleep_for(std::chrono::milliseconds(100));
-                #endif
-
-                    std::cout << "Progress: "s << std::setprecision(3) << 100.0 * processedPixel / ((double)data1->Width * data1->Height) << "%"s << std::endl;
+                    std::cout << "Progress: "s << std::setprecision(3) << 100.0 * processedPixel / pixelCount << "%"s << std::endl;
                 }
-                thread.join();
+                repository_->SetMask(nullptr);
+                future.get();
 
                 std::cout << "Take image differential completed: "s << elapsedMillisecounds << "ms"s << std::endl;
 
-                return repository_->Process(data1, data2);
+                return result;
+            }
+
+            //Halo a tile must be read with to give the same result as the whole image, -1 if the whole image is needed
+            int GetWindowRadius() const
+            {
+                return repository_->GetWindowRadius();
             }
 
             virtual ~TakeDifferenceService()
@@ -15,9 +15,13 @@ namespace ImageInformationAnalyzer
         public:
             explicit TakeHistogramService();
 
-            virtual HistogramData* Process(const FloatingPointImageData* data, const int histogramSize, const double histogramMinValue, const double histogramMaxValue)
+            //Pixels inside of the mask only
+            virtual HistogramData* Process(const FloatingPointImageData* data, const int histogramSize, const double histogramMinValue, const double histogramMaxValue, const MaskData* mask = nullptr)
             {
-                return repository_->Process(data, histogramSize, histogramMinValue, histogramMaxValue);
+                repository_->SetMask(mask);
+                auto histogram = repository_->Process(data, histogramSize, histogramMinValue, histogramMaxValue);
+                repository_->SetMask(nullptr);
+                return histogram;
             }
 
             virtual ~TakeHistogramService()
@@ -0,0 +1,18 @@
+#include "TiledImageService.hpp"
+#include "GraphicRowStreamDataRepository.hpp"
+#include "MappedFileTileStorageDataRepository.hpp"
+
+namespace ImageInformationAnalyzer
+{
+    namespace Application
+    {
+        using namespace Infrastructure;
+
+        TiledImageService::TiledImageService(const TiledSetting& setting) : setting_(setting)
+        {
+            storageRepository_ = new MappedFileTileStorageDataRepository(setting.MemoryBudget, setting.ScratchDirectory);
+            sourceRepository_ = new GraphicRowSourceDataRepository();
+            sinkRepository_ = new GraphicRowSinkDataRepository();
+        }
+    }
+}
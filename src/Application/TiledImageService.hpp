@@ -0,0 +1,166 @@
+#pragma once
+
+#include "RowStreamData.hpp"
+#include "TiledImageData.hpp"
+
+#include <functional>
+#include <memory>
+#include <iomanip> //for cout
+#include <iostream>
+
+namespace ImageInformationAnalyzer
+{
+    namespace Application
+    {
+        using namespace Domain;
+
+        struct TiledSetting
+        {
+            //Edge length of the tiles without the halo
+            int TileSize = 256;
+            //Bytes of the scratch files mapped at the same time, the least recently used parts are unmapped beyond it
+            size_t MemoryBudget = (size_t)256 * 1024 * 1024;
+            //Scratch files, empty is the temporary directory
+            std::string ScratchDirectory;
+        };
+
+        //Out-of-core images: the planes live in memory mapped scratch files and the existing services run on one tile at a time
+        class TiledImageService
+        {
+            const TiledSetting setting_;
+
+            ITileStorageDataRepository* storageRepository_;
+            IRowSourceDataRepository* sourceRepository_;
+            IRowSinkDataRepository* sinkRepository_;
+
+        public:
+            explicit TiledImageService(const TiledSetting& setting = TiledSetting());
+
+            TiledImageData* Create(const int width, const int height)
+            {
+                return new TiledImageData(width, height, setting_.TileSize, storageRepository_);
+            }
+
+            //R, G and B (0 - 255) decoded row by row, see GraphicRowSourceDataRepository
+            std::vector<TiledImageData*> Load(const std::string& filePath)
+            {
+                sourceRepository_->Open(filePath);
+
+                std::vector<std::unique_ptr<TiledImageData>> channels;
+                for(auto c = 0; c < 3; ++c)
+                {
+                    channels.emplace_back(Create(sourceRepository_->GetWidth(), sourceRepository_->GetHeight()));
+                }
+
+                std::vector<double> r;
+                std::vector<double> g;
+                std::vector<double> b;
+                for(auto y = 0; y < channels[0]->Height; ++y)
+                {
+                    if(!sourceRepository_->ReadRow(r, g, b)) throw std::runtime_error("image ended at row "s + std::to_string(y));
+                    channels[0]->WriteRow(y, r);
+                    channels[1]->WriteRow(y, g);
+                    channels[2]->WriteRow(y, b);
+                }
+
+                std::vector<TiledImageData*> results;
+                for(auto& channel : channels)
+                {
+                    results.push_back(channel.release());
+                }
+                return results;
+            }
+
+            //8 bit RGB (0 - 255) encoded row by row, see GraphicRowSinkDataRepository
+            void Store(const TiledImageData* r, const TiledImageData* g, const TiledImageData* b, const std::string& filePath)
+            {
+                sinkRepository_->Create(filePath, r->Width, r->Height);
+
+                std::vector<double> rowR;
+                std::vector<double> rowG;
+                std::vector<double> rowB;
+                for(auto y = 0; y < r->Height; ++y)
+                {
+                    r->ReadRow(y, rowR);
+                    g->ReadRow(y, rowG);
+                    b->ReadRow(y, rowB);
+                    sinkRepository_->WriteRow(y, rowR, rowG, rowB);
+                }
+                sinkRepository_->Close();
+            }
+
+            //Each tile of the planes (same size) with halo pixels around it, in the order of the tiles
+            void ForEachTile(const std::vector<const TiledImageData*>& data, const int halo, const std::function<void(const int, const std::vector<const FloatingPointImageData*>&)>& visit)
+            {
+                for(auto plane : data)
+                {
+                    if(plane->Width != data[0]->Width || plane->Height != data[0]->Height || plane->TileSize != data[0]->TileSize) throw std::invalid_argument("Image sizes are NOT the same!");
+                }
+
+                const auto tileCount = data[0]->GetTileCount();
+                for(auto tileIndex = 0; tileIndex < tileCount; ++tileIndex)
+                {
+                    std::vector<std::unique_ptr<FloatingPointImageData>> tiles;
+                    for(auto plane : data)
+                    {
+                        tiles.emplace_back(plane->ReadTile(tileIndex, halo));
+                    }
+                    std::vector<const FloatingPointImageData*> tilePointers;
+                    for(const auto& tile : tiles)
+                    {
+                        tilePointers.push_back(tile.get());
+                    }
+
+                    visit(tileIndex, tilePointers);
+
+                    std::cout << "Tile "s << tileIndex + 1 << "/"s << tileCount << ", mapped "s << std::setprecision(4) << storageRepository_->GetResidentBytes() / 1024.0 / 1024.0 << "MB"s << std::endl;
+                }
+            }
+
+            //process() is a service on whole images (e.g. DenoiseImageService::Process()), called once per tile
+            //Its results are the tiles of the returned planes. halo must cover its window, e.g. DenoiseImageService::GetWindowRadius() * passes
+            std::vector<TiledImageData*> Process(const std::vector<const TiledImageData*>& data, const int halo, const std::function<std::vector<FloatingPointImageData*>(const std::vector<const FloatingPointImageData*>&)>& process)
+            {
+                std::vector<std::unique_ptr<TiledImageData>> results;
+                ForEachTile(data, halo, [&](const int tileIndex, const std::vector<const FloatingPointImageData*>& tiles)
+                {
+                    std::vector<std::unique_ptr<FloatingPointImageData>> processed;
+                    for(auto tile : process(tiles))
+                    {
+                        processed.emplace_back(tile);
+                    }
+
+                    while(results.size() < processed.size())
+                    {
+                        results.emplace_back(Create(data[0]->Width, data[0]->Height));
+                    }
+                    for(auto i = 0; i < processed.size(); ++i)
+                    {
+                        results[i]->WriteTile(tileIndex, halo, processed[i].get());
+                    }
+                });
+
+                std::vector<TiledImageData*> planes;
+                for(auto& result : results)
+                {
+                    planes.push_back(result.release());
+                }
+                return planes;
+            }
+
+            //Bytes of the scratch files in memory at the peak
+            size_t GetPeakResidentBytes() const
+            {
+                return storageRepository_->GetPeakResidentBytes();
+            }
+
+            //The planes must have been released before
+            virtual ~TiledImageService()
+            {
+                delete storageRepository_;
+                delete sourceRepository_;
+                delete sinkRepository_;
+            }
+        };
+    }
+}
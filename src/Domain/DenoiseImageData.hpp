@@ -1,14 +1,45 @@
 #pragma once
 #include "FloatingPointImageData.hpp"
+#include "ImageUtility.hpp"
+#include "MaskData.hpp"
 
 #include <algorithm>
+#include <array>
 #include <execution>
+#include <memory>
+#include <numeric>
 #include <iostream> //std::cout
 
 namespace ImageInformationAnalyzer
 {
     namespace Domain
     {
+        struct DenoiseSetting
+        {
+            //Two tier scheduling: the first pass gives up early, the failed pixels are retried in a compact second pass
+            //The retry starts cold and ignores the sign of theta when checking the convergence, so it may end elsewhere than the first tier would have
+            bool TwoTierScheduling = false;
+            //Two tier scheduling: loop limit of the first pass, the second pass uses the full limit
+            int FirstTierMaxLoop = 20;
+            //Multi pass: edge length of the tiles that run all the passes while they are in cache, 0 runs the passes over the whole image
+            int TileSize = 0;
+            //Adaptive: Circle fitting error (sum of |residual| over the window) above which a pixel is refitted with the ellipse
+            //Flat regions give about 40 * noise sigma, the default suits sigma = 0.02 on a 0-1 scale
+            double AdaptiveThreshold = 1.0;
+            //Pyramid: number of levels including the full resolution, the coarser level gives the start value of the next one
+            int PyramidLevels = 3;
+            //Guided filter / grid bilateral: radius of the box filter (grid cell size for the bilateral)
+            int FilterRadius = 3;
+            //Guided filter: regularization, about the variance of the noise to be removed
+            double GuidedFilterEpsilon = 1e-3;
+            //Grid bilateral: range cell size, same scale as the image, must be greater than 0
+            double BilateralRangeSigma = 0.05;
+            //Anytime: milliseconds until the result is returned, for all channels and passes of a call
+            double TimeBudget = 200;
+            //Anytime: edge length of the tiles that are refined as a whole
+            int AnytimeTileSize = 16;
+        };
+
         class IDenoiseImageDataRepository
         {
         protected:
@@ -17,97 +48,563 @@ namespace ImageInformationAnalyzer
                 WINDOW_SIZE = 7
             };
 
+            const DenoiseSetting setting_;
+
+            //Region of interest, not owned
+            const MaskData* mask_;
+
+            //No statistics on std::cout, see SetQuiet()
+            bool quiet_;
+
+            //Pixel indices (y * width + x) inside the mask, all of them without a mask
+            inline std::vector<int> GetMaskedPixelIndices(const int width, const int height) const
+            {
+                if(mask_ != nullptr && (mask_->Width != width || mask_->Height != height)) throw std::invalid_argument("mask must have the same size as the image");
+
+                std::vector<int> pixelIndices;
+                if(mask_ == nullptr)
+                {
+                    pixelIndices.resize((size_t)width * height);
+                    std::iota(pixelIndices.begin(), pixelIndices.end(), 0);
+                    return pixelIndices;
+                }
+
+                pixelIndices.reserve(mask_->GetPixelCount());
+                for(auto y = 0; y < height; ++y)
+                {
+                    for(auto x = 0; x < width; ++x)
+                    {
+                        if(mask_->IsInside(x, y)) pixelIndices.push_back(y * width + x);
+                    }
+                }
+                return pixelIndices;
+            }
+
+            //Pixels outside of the mask keep the input, for the filters that run over the whole image
+            inline FloatingPointImageData* RestoreOutsideMask(const FloatingPointImageData* data, FloatingPointImageData* result) const
+            {
+                if(mask_ == nullptr) return result;
+                if(mask_->Width != data->Width || mask_->Height != data->Height) throw std::invalid_argument("mask must have the same size as the image");
+
+                auto imageBuffer = result->ImageBuffer;
+                auto normalBuffer = result->NormalBuffer;
+                for(auto y = 0; y < data->Height; ++y)
+                {
+                    for(auto x = 0; x < data->Width; ++x)
+                    {
+                        if(mask_->IsInside(x, y)) continue;
+
+                        imageBuffer[y][x] = data->ImageBuffer[y][x];
+                        normalBuffer[y][x] = data->NormalBuffer[y][x];
+                    }
+                }
+                delete result;
+                return new FloatingPointImageData(data->Width, data->Height, imageBuffer, normalBuffer);
+            }
+
         public:
-            explicit IDenoiseImageDataRepository()
+            explicit IDenoiseImageDataRepository(const DenoiseSetting& setting = DenoiseSetting()) : setting_(setting), mask_(nullptr), quiet_(false)
             {
 
             }
             virtual ~IDenoiseImageDataRepository() = default;
 
-            virtual FloatingPointImageData* Process(const FloatingPointImageData* data, std::atomic<int>* processedPixel = nullptr)
+            //Following calls only denoise the pixels inside the mask, the others keep the input. nullptr is the whole image
+            void SetMask(const MaskData* mask) { mask_ = mask; }
+
+            //Following calls don't print their statistics, e.g. for the many small calls of a tile loop
+            void SetQuiet(const bool quiet) { quiet_ = quiet; }
+
+            //processedPixel is only counted up (once per pixel, channel and pass), the caller sets it to 0 before the call
+            virtual FloatingPointImageData* Process(const FloatingPointImageData* data, std::atomic<int>* processedPixel = nullptr) = 0;
+
+            //Several planes of the same size (e.g. R, G and B), one result for each
+            virtual std::vector<FloatingPointImageData*> ProcessChannels(const std::vector<const FloatingPointImageData*>& data, std::atomic<int>* processedPixel = nullptr)
+            {
+                std::vector<FloatingPointImageData*> results;
+                for(auto channel : data)
+                {
+                    results.push_back(Process(channel, processedPixel));
+                }
+                return results;
+            }
+
+            //Model used by each pixel (0 .. model count - 1), one plane per channel
+            typedef std::vector<std::unique_ptr<FloatingPointImageData>> ModelMaps;
+
+            //The result of each pass is the input of the next one
+            //modelMaps: if not nullptr, receives the models of the last pass. Empty unless the repository chooses the model per pixel
+            virtual std::vector<FloatingPointImageData*> ProcessPasses(const std::vector<const FloatingPointImageData*>& data, const int passCount, std::atomic<int>* processedPixel = nullptr, ModelMaps* modelMaps = nullptr)
+            {
+                if(passCount < 1) throw std::invalid_argument("pass count must be greater than 0");
+                if(modelMaps != nullptr) modelMaps->clear();
+
+                auto results = ProcessChannels(data, processedPixel);
+                for(auto pass = 1; pass < passCount; ++pass)
+                {
+                    std::vector<std::unique_ptr<FloatingPointImageData>> previous(results.begin(), results.end());
+                    results = ProcessChannels(std::vector<const FloatingPointImageData*>(results.begin(), results.end()), processedPixel);
+                }
+                return results;
+            }
+
+            //Distance in pixels beyond which the input does not change a result pixel, for one pass
+            //A tile read with this halo gives the same result as the whole image
+            virtual int GetWindowRadius() const
+            {
+                return WINDOW_SIZE / 2;
+            }
+
+            //Denoised planes of the coarser levels of the last Process() call, level 1 (half resolution) first, the caller deletes them
+            //Level 0 is the result of the call. Empty unless the repository works on several resolutions
+            virtual std::vector<FloatingPointImageData*> GetLevels() const
+            {
+                return std::vector<FloatingPointImageData*>();
+            }
+
+            //Row streaming: rows[c] are the 2 * GetWindowRadius() + 1 rows of channel c around the result row, already wrapped around like GetWindowPoints()
+            //The columns wrap around as well, the mask is not applied. Returns the number of failed pixels
+            //Modes that need the whole image (or the previous frame) can't stream
+            virtual int ProcessRow(const std::vector<std::vector<const std::vector<double>*>>&, std::vector<std::vector<double>>&)
+            {
+                throw std::invalid_argument("this denoise mode needs the whole image");
+            }
+        };
+
+        //Per pixel loop of the denoise repositories (CRTP)
+        //Derived::DenoiseWindow() is called without virtual dispatch, so that the whole per pixel kernel can be inlined
+        //Derived::ImagePoint is the window point type of the kernel
+        template<typename Derived>
+        class DenoiseImageDataRepositoryBase : public IDenoiseImageDataRepository
+        {
+        protected:
+            //Kernels that choose between several models override this and take the model as the last argument of DenoiseWindow()
+            //secondTier: the pixel failed the first pass of two tier scheduling and gets the full loop limit. Passed per call, the repository is shared between threads
+            enum
+            {
+                MODEL_COUNT = 1
+            };
+
+            template<typename Point>
+            inline bool CallDenoiseWindow(std::vector<Point>& windowPoints, double& denoisedPixel, Eigen::Vector3d& normal, double& fittingError, const bool secondTier, unsigned char& model)
+            {
+                model = 0;
+                if constexpr((int)Derived::MODEL_COUNT > 1)
+                {
+                    return static_cast<Derived*>(this)->DenoiseWindow(windowPoints, denoisedPixel, normal, fittingError, secondTier, model);
+                }
+                else
+                {
+                    return static_cast<Derived*>(this)->DenoiseWindow(windowPoints, denoisedPixel, normal, fittingError, secondTier);
+                }
+            }
+
+            //Both tiers right after each other, for the paths that can't gather the failed pixels of the whole pass
+            //The result is the same as the second pass of ProcessPass(), only the load balancing is lost
+            template<typename Point>
+            inline bool CallDenoiseWindowTiers(std::vector<Point>& windowPoints, double& denoisedPixel, Eigen::Vector3d& normal, double& fittingError, unsigned char& model)
+            {
+                if(CallDenoiseWindow(windowPoints, denoisedPixel, normal, fittingError, false, model)) return true;
+                if(!setting_.TwoTierScheduling) return false;
+                return CallDenoiseWindow(windowPoints, denoisedPixel, normal, fittingError, true, model);
+            }
+
+            //Window of a single plane
+            inline bool DenoisePixel(const FloatingPointImageData* data, const int x, const int y, const int windowSize, double& denoisedPixel, Eigen::Vector3d& normal, double& fittingError)
+            {
+                auto windowPoints = Misc::ImageUtility::GetWindowPoints<typename Derived::ImagePoint>(data, x, y, windowSize);
+                auto model = (unsigned char)0;
+                return CallDenoiseWindow(windowPoints, denoisedPixel, normal, fittingError, false, model);
+            }
+
+        public:
+            explicit DenoiseImageDataRepositoryBase(const DenoiseSetting& setting = DenoiseSetting()) : IDenoiseImageDataRepository(setting)
+            {
+
+            }
+            virtual ~DenoiseImageDataRepositoryBase() = default;
+
+            virtual FloatingPointImageData* Process(const FloatingPointImageData* data, std::atomic<int>* processedPixel = nullptr) override
+            {
+                return ProcessChannels({ data }, processedPixel)[0];
+            }
+
+            virtual std::vector<FloatingPointImageData*> ProcessChannels(const std::vector<const FloatingPointImageData*>& data, std::atomic<int>* processedPixel = nullptr) override
+            {
+                return ProcessPasses(data, 1, processedPixel);
+            }
+
+            //One traversal for all the planes: the window coordinates are gathered once per pixel
+            //and only the values are exchanged between the channels
+            //The passes alternate between two preallocated planes per channel
+            virtual std::vector<FloatingPointImageData*> ProcessPasses(const std::vector<const FloatingPointImageData*>& data, const int passCount, std::atomic<int>* processedPixel = nullptr, ModelMaps* modelMaps = nullptr) override
             {
-                auto width = data->Width;
-                auto height = data->Height;
+                auto width = data[0]->Width;
+                auto height = data[0]->Height;
+                const auto channelCount = (int)data.size();
+                const auto pixelCount = (size_t)width * height;
+
+                if(passCount < 1) throw std::invalid_argument("pass count must be greater than 0");
+                for(auto channel : data)
+                {
+                    if(channel->Width != width || channel->Height != height) throw std::invalid_argument("channels must have the same size");
+                }
+                if(mask_ != nullptr && (mask_->Width != width || mask_->Height != height)) throw std::invalid_argument("mask must have the same size as the image");
 
                 //Prepare buffers
-                std::vector<std::vector<double>> imageBuffer;
-                std::vector<std::vector<Eigen::Vector3d>> normalBuffer;
-                imageBuffer.resize(height);
-                normalBuffer.resize(height);
-                for(auto y = 0; y < height; ++y)
+                std::vector<std::array<std::vector<std::vector<double>>, 2>> planes(channelCount);
+                std::vector<std::vector<std::vector<Eigen::Vector3d>>> normalBuffers(channelCount);
+                std::vector<std::vector<double>> fittingErrorBuffers(channelCount);
+                for(auto c = 0; c < channelCount; ++c)
                 {
-                    imageBuffer[y].resize(width);
-                    normalBuffer[y].resize(width);
+                    //The second plane is only used with more than one pass
+                    for(auto i = 0; i < std::min(passCount, 2); ++i)
+                    {
+                        planes[c][i].resize(height);
+                        for(auto y = 0; y < height; ++y)
+                        {
+                            planes[c][i][y].resize(width);
+                        }
+                    }
+                    normalBuffers[c].resize(height);
+                    for(auto y = 0; y < height; ++y)
+                    {
+                        normalBuffers[c][y].resize(width);
+                    }
+                    fittingErrorBuffers[c].resize(pixelCount);
+
+                    //Outside of the mask the input passes through every pass
+                    if(mask_ == nullptr) continue;
+                    for(auto y = 0; y < height; ++y)
+                    {
+                        for(auto x = 0; x < width; ++x)
+                        {
+                            if(mask_->IsInside(x, y)) continue;
+
+                            for(auto i = 0; i < std::min(passCount, 2); ++i)
+                            {
+                                planes[c][i][y][x] = data[c]->ImageBuffer[y][x];
+                            }
+                            normalBuffers[c][y][x] = data[c]->NormalBuffer[y][x];
+                        }
+                    }
                 }
 
-                //set to 0%
-                if(processedPixel != nullptr) *processedPixel = 0;
+                //Model of each pixel, only if the kernel chooses it
+                std::vector<std::vector<unsigned char>> modelBuffers;
+                if constexpr((int)Derived::MODEL_COUNT > 1)
+                {
+                    modelBuffers.resize(channelCount, std::vector<unsigned char>(pixelCount, 0));
+                }
+
+                //C++17
+                std::atomic<int> errorPixel(0);
+
+                if(setting_.TileSize > 0)
+                {
+                    ProcessTiles(data, passCount, planes, normalBuffers, fittingErrorBuffers, modelBuffers, errorPixel, processedPixel);
+                }
+                else
+                {
+                    for(auto pass = 0; pass < passCount; ++pass)
+                    {
+                        ProcessPass(data, pass, planes, normalBuffers, fittingErrorBuffers, modelBuffers, errorPixel, processedPixel);
+                    }
+                }
+
+                auto totalFittingError = 0.0;
+                for(const auto& fittingErrors : fittingErrorBuffers)
+                {
+                    for(auto fittingError : fittingErrors)
+                    {
+                        totalFittingError += fittingError;
+                    }
+                }
+                const auto maskedPixelCount = mask_ != nullptr ? (size_t)mask_->GetPixelCount() : pixelCount;
+                if(!quiet_)
+                {
+                    std::cout << "Error Pixel: "s << errorPixel << std::endl;
+                    std::cout << "Fitting error/pixel: "s << totalFittingError / (std::max(maskedPixelCount, (size_t)1) * channelCount) << std::endl;
+                }
+
+                if(modelMaps != nullptr)
+                {
+                    modelMaps->clear();
+                    for(const auto& modelBuffer : modelBuffers)
+                    {
+                        modelMaps->emplace_back(GetModelMap(width, height, modelBuffer));
+                    }
+                }
 
-                //Denoise process
-                std::vector<std::tuple<int, int, double, Eigen::Vector3d, double>> processBuffer;
-                processBuffer.resize((size_t)width * height);
+                std::vector<FloatingPointImageData*> results;
+                for(auto c = 0; c < channelCount; ++c)
+                {
+                    results.push_back(new FloatingPointImageData(width, height, planes[c][(passCount - 1) % 2], normalBuffers[c]));
+                }
+                return results;
+            }
+
+            //Same kernel as ProcessPass(), the window values come from the rows instead of the image
+            virtual int ProcessRow(const std::vector<std::vector<const std::vector<double>*>>& rows, std::vector<std::vector<double>>& results) override
+            {
+                const auto channelCount = (int)rows.size();
+                const auto radius = (int)WINDOW_SIZE / 2;
+                const auto width = (int)rows[0][radius]->size();
+                for(const auto& channel : rows)
+                {
+                    if(channel.size() != WINDOW_SIZE) throw std::invalid_argument("rows must cover the window");
+                }
+
+                results.resize(channelCount);
+                for(auto& result : results)
+                {
+                    result.resize(width);
+                }
+
+                std::vector<int> columns(width);
+                std::iota(columns.begin(), columns.end(), 0);
+
+                std::atomic<int> errorPixel(0);
+                std::for_each(std::execution::par, columns.begin(), columns.end(), [&](const int x)
+                {
+                    auto windowPoints = Misc::ImageUtility::GetWindowPoints<typename Derived::ImagePoint>(WINDOW_SIZE);
+                    for(auto c = 0; c < channelCount; ++c)
+                    {
+                        for(auto& point : windowPoints)
+                        {
+                            point.Value = (*rows[c][point.OffsetY + radius])[(x + width + point.OffsetX) % width];
+                        }
+
+                        auto denoisedPixel = 0.0;
+                        auto fittingError = 0.0;
+                        auto model = (unsigned char)0;
+                        Eigen::Vector3d normal;
+
+                        //A failed pixel is retried at once like ProcessTiles(), the rows don't gather the retries
+                        if(!CallDenoiseWindowTiers(windowPoints, denoisedPixel, normal, fittingError, model)) errorPixel++;
+                        results[c][x] = denoisedPixel;
+                    }
+                });
+
+                return errorPixel;
+            }
 
+        private:
+            typedef std::vector<std::array<std::vector<std::vector<double>>, 2>> PlaneBuffers;
+
+            static inline FloatingPointImageData* GetModelMap(const int width, const int height, const std::vector<unsigned char>& modelBuffer)
+            {
+                std::vector<std::vector<double>> imageBuffer(height, std::vector<double>(width));
+                std::vector<std::vector<Eigen::Vector3d>> normalBuffer(height, std::vector<Eigen::Vector3d>(width, Eigen::Vector3d(0, 0, 1)));
                 for(auto y = 0; y < height; ++y)
                 {
                     for(auto x = 0; x < width; ++x)
                     {
-                        processBuffer[(size_t)y * width + x] = std::tuple(x, y, 0.0, Eigen::Vector3d::Zero(), 0.0);
+                        imageBuffer[y][x] = modelBuffer[(size_t)y * width + x];
                     }
                 }
+                return new FloatingPointImageData(width, height, imageBuffer, normalBuffer);
+            }
 
-                //C++17
-                std::atomic<int> errorPixel(0);
+            //One pass over the whole image, reads the previous plane (or the input) and writes the other one
+            void ProcessPass(const std::vector<const FloatingPointImageData*>& data, const int pass, PlaneBuffers& planes, std::vector<std::vector<std::vector<Eigen::Vector3d>>>& normalBuffers, std::vector<std::vector<double>>& fittingErrorBuffers, std::vector<std::vector<unsigned char>>& modelBuffers, std::atomic<int>& errorPixel, std::atomic<int>* processedPixel)
+            {
+                auto width = data[0]->Width;
+                auto height = data[0]->Height;
+                const auto channelCount = (int)data.size();
+                const auto pixelCount = (size_t)width * height;
+
+                std::vector<const std::vector<std::vector<double>>*> sources;
+                for(auto c = 0; c < channelCount; ++c)
+                {
+                    sources.push_back(pass == 0 ? &data[c]->ImageBuffer : &planes[c][(pass - 1) % 2]);
+                }
+
+                auto pixelIndices = GetMaskedPixelIndices(width, height);
+
+                //First tier failures, only with two tier scheduling
+                std::vector<char> retryFlags(pixelCount * channelCount, 0);
 
             #ifdef _DEBUG
                 auto parallelPolicy = std::execution::par;
             #else
                 auto parallelPolicy = std::execution::par;
             #endif
-                std::for_each(parallelPolicy, processBuffer.begin(), processBuffer.end(), [&](std::tuple<int, int, double, Eigen::Vector3d, double> param)
+                auto denoise = [&](std::vector<typename Derived::ImagePoint>& windowPoints, const int index, const int c, const bool secondTier)
                 {
-                    const auto x = std::get<0>(param);
-                    const auto y = std::get<1>(param);
+                    const auto x = index % width;
+                    const auto y = index / width;
+
+                    for(auto& point : windowPoints)
+                    {
+                        point.Value = (*sources[c])[point.Y][point.X];
+                    }
 
                     auto denoisedPixel = 0.0;
                     auto fittingError = 0.0;
+                    auto model = (unsigned char)0;
                     Eigen::Vector3d normal;
 
-                    if(!DenoisePixel(data, x, y, WINDOW_SIZE, denoisedPixel, normal, fittingError))
+                    if(!CallDenoiseWindow(windowPoints, denoisedPixel, normal, fittingError, secondTier, model))
                     {
+                        if(setting_.TwoTierScheduling && !secondTier)
+                        {
+                            retryFlags[(size_t)index * channelCount + c] = 1;
+                            return;
+                        }
                         errorPixel++;
                     }
 
                     //Results
                     {
-                        std::get<2>(processBuffer[(size_t)y * width + x]) = denoisedPixel;
-                        std::get<3>(processBuffer[(size_t)y * width + x]) = normal;
-                        std::get<4>(processBuffer[(size_t)y * width + x]) = fittingError;
+                        planes[c][pass % 2][y][x] = denoisedPixel;
+                        normalBuffers[c][y][x] = normal;
+                        fittingErrorBuffers[c][index] = fittingError;
+                        if(!modelBuffers.empty()) modelBuffers[c][index] = model;
 
                         if(processedPixel != nullptr) (*processedPixel)++;
                     }
+                };
+
+                std::for_each(parallelPolicy, pixelIndices.begin(), pixelIndices.end(), [&](const int index)
+                {
+                    auto windowPoints = Misc::ImageUtility::GetWindowPoints<typename Derived::ImagePoint>(data[0], index % width, index / width, WINDOW_SIZE);
+                    for(auto c = 0; c < channelCount; ++c)
+                    {
+                        denoise(windowPoints, index, c, false);
+                    }
                 });
 
-                auto totalFittingError = 0.0;
-                for(std::tuple<int, int, double, Eigen::Vector3d, double> param : processBuffer)
+                if(setting_.TwoTierScheduling)
                 {
-                    const auto x = std::get<0>(param);
-                    const auto y = std::get<1>(param);
-                    const auto denoisedPixel = std::get<2>(param);
-                    const auto normal = std::get<3>(param);
-                    const auto fittingError = std::get<4>(param);
-                    //const auto originalPixel = data->ImageBuffer[y][x];
+                    //Compact list, so that the hard pixels are spread over all workers
+                    std::vector<int> retryIndices;
+                    for(auto i = 0; i < retryFlags.size(); ++i)
+                    {
+                        if(retryFlags[i] != 0) retryIndices.push_back(i);
+                    }
+
+                    std::for_each(parallelPolicy, retryIndices.begin(), retryIndices.end(), [&](const int retryIndex)
+                    {
+                        const auto index = retryIndex / channelCount;
+                        auto windowPoints = Misc::ImageUtility::GetWindowPoints<typename Derived::ImagePoint>(data[0], index % width, index / width, WINDOW_SIZE);
+                        denoise(windowPoints, index, retryIndex % channelCount, true);
+                    });
 
-                    totalFittingError += fittingError;
-                    imageBuffer[y][x] = denoisedPixel;
-                    normalBuffer[y][x] = normal;
+                    if(!quiet_) std::cout << "Second tier pixel: "s << retryIndices.size() << std::endl;
                 }
-                std::cout << "Error Pixel: "s << errorPixel << std::endl;
-                std::cout << "Fitting error/pixel: "s << totalFittingError / processBuffer.size() << std::endl;
+            }
 
-                return new FloatingPointImageData(width, height, imageBuffer, normalBuffer);
+            //All the passes tile by tile
+            //Each pass shrinks the valid area by the window radius, so the tile is read with a halo of passCount * radius
+            //and the halo pixels are computed redundantly. The result is the same as ProcessPass().
+            //With two tier scheduling a failed pixel is retried at once (CallDenoiseWindowTiers()), the retries are not gathered across the tiles
+            void ProcessTiles(const std::vector<const FloatingPointImageData*>& data, const int passCount, PlaneBuffers& planes, std::vector<std::vector<std::vector<Eigen::Vector3d>>>& normalBuffers, std::vector<std::vector<double>>& fittingErrorBuffers, std::vector<std::vector<unsigned char>>& modelBuffers, std::atomic<int>& errorPixel, std::atomic<int>* processedPixel)
+            {
+                auto width = data[0]->Width;
+                auto height = data[0]->Height;
+                const auto channelCount = (int)data.size();
+                const auto tileSize = setting_.TileSize;
+                const auto radius = (int)WINDOW_SIZE / 2;
+                const auto halo = radius * passCount;
+
+                const auto tileCountX = (width + tileSize - 1) / tileSize;
+                const auto tileCountY = (height + tileSize - 1) / tileSize;
+
+                std::vector<int> tileIndices((size_t)tileCountX * tileCountY);
+                std::iota(tileIndices.begin(), tileIndices.end(), 0);
+
+                std::for_each(std::execution::par, tileIndices.begin(), tileIndices.end(), [&](const int tileIndex)
+                {
+                    const auto startX = (tileIndex % tileCountX) * tileSize;
+                    const auto startY = (tileIndex / tileCountX) * tileSize;
+                    const auto tileWidth = std::min(tileSize, width - startX);
+                    const auto tileHeight = std::min(tileSize, height - startY);
+
+                    //Tiles outside of the mask already hold the input
+                    if(mask_ != nullptr && !mask_->IsTileInside(startX, startY, startX + tileWidth, startY + tileHeight)) return;
+
+                    const auto localWidth = tileWidth + 2 * halo;
+                    const auto localHeight = tileHeight + 2 * halo;
+
+                    //Local ping-pong planes, hot in cache during all the passes
+                    std::array<std::vector<double>, 2> localPlanes;
+                    for(auto& localPlane : localPlanes)
+                    {
+                        localPlane.resize((size_t)localWidth * localHeight);
+                    }
+
+                    //Offsets only, the values are set per pixel
+                    auto windowPoints = Misc::ImageUtility::GetWindowPoints<typename Derived::ImagePoint>(WINDOW_SIZE);
+
+                    for(auto c = 0; c < channelCount; ++c)
+                    {
+                        //Halo wraps around like GetWindowPoints()
+                        for(auto localY = 0; localY < localHeight; ++localY)
+                        {
+                            const auto y = ((startY - halo + localY) % height + height) % height;
+                            for(auto localX = 0; localX < localWidth; ++localX)
+                            {
+                                const auto x = ((startX - halo + localX) % width + width) % width;
+                                localPlanes[0][(size_t)localY * localWidth + localX] = data[c]->ImageBuffer[y][x];
+                            }
+                        }
+
+                        for(auto pass = 0; pass < passCount; ++pass)
+                        {
+                            const auto& source = localPlanes[pass % 2];
+                            auto& target = localPlanes[(pass + 1) % 2];
+                            const auto margin = (pass + 1) * radius;
+                            const auto lastPass = pass == passCount - 1;
+
+                            for(auto localY = margin; localY < localHeight - margin; ++localY)
+                            {
+                                for(auto localX = margin; localX < localWidth - margin; ++localX)
+                                {
+                                    //Same as ProcessPass(), the pixels outside of the mask keep their value
+                                    if(mask_ != nullptr && !mask_->IsInside(((startX - halo + localX) % width + width) % width, ((startY - halo + localY) % height + height) % height))
+                                    {
+                                        target[(size_t)localY * localWidth + localX] = source[(size_t)localY * localWidth + localX];
+                                        continue;
+                                    }
+
+                                    for(auto& point : windowPoints)
+                                    {
+                                        point.Value = source[(size_t)(localY + point.OffsetY) * localWidth + localX + point.OffsetX];
+                                    }
+
+                                    auto denoisedPixel = 0.0;
+                                    auto fittingError = 0.0;
+                                    auto model = (unsigned char)0;
+                                    Eigen::Vector3d normal;
+
+                                    auto succeeded = CallDenoiseWindowTiers(windowPoints, denoisedPixel, normal, fittingError, model);
+
+                                    target[(size_t)localY * localWidth + localX] = denoisedPixel;
+
+                                    //Only the tile itself counts, the halo belongs to the neighbours
+                                    const auto inTile = localX >= halo && localX < halo + tileWidth && localY >= halo && localY < halo + tileHeight;
+                                    if(inTile)
+                                    {
+                                        if(!succeeded) errorPixel++;
+                                        if(processedPixel != nullptr) (*processedPixel)++;
+                                    }
+
+                                    if(lastPass)
+                                    {
+                                        const auto x = startX + localX - halo;
+                                        const auto y = startY + localY - halo;
+                                        planes[c][(passCount - 1) % 2][y][x] = denoisedPixel;
+                                        normalBuffers[c][y][x] = normal;
+                                        fittingErrorBuffers[c][(size_t)y * width + x] = fittingError;
+                                        if(!modelBuffers.empty()) modelBuffers[c][(size_t)y * width + x] = model;
+                                    }
+                                }
+                            }
+                        }
+                    }
+                });
             }
-        protected:
-            virtual inline bool DenoisePixel(const FloatingPointImageData* data, const int x, const int y, const int windowSize, double& denoisedPixel, Eigen::Vector3d& normal, double& fittingError) = 0;
         };
     }
 }
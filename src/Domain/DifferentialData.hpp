@@ -1,6 +1,7 @@
 #pragma once
 
 #include "FloatingPointImageData.hpp"
+#include "MaskData.hpp"
 
 #include <execution>
 
@@ -10,11 +11,21 @@ namespace ImageInformationAnalyzer
     {
         class IDifferentialDataRepository
         {
+        protected:
+            //Region of interest, not owned
+            const MaskData* mask_ = nullptr;
+
         public:
             explicit IDifferentialDataRepository() = default;
             virtual ~IDifferentialDataRepository() = default;
 
+            //Following calls fit and take the difference inside the mask only, the others are 0. nullptr is the whole image
+            void SetMask(const MaskData* mask) { mask_ = mask; }
+
             virtual FloatingPointImageData* Process(const FloatingPointImageData* data1, const FloatingPointImageData* data2, std::atomic<int>* processedPixel = nullptr) = 0;
+
+            //Distance in pixels beyond which the input does not change a result pixel, -1 if the fit uses the whole image
+            virtual int GetWindowRadius() const = 0;
         };
     }
 }
\ No newline at end of file
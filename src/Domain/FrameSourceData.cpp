@@ -0,0 +1 @@
+#include "FrameSourceData.hpp"
@@ -0,0 +1,28 @@
+#pragma once
+#include "FloatingPointImageData.hpp"
+
+#include <string>
+#include <vector>
+
+namespace ImageInformationAnalyzer
+{
+    namespace Domain
+    {
+        //Frames of a video file or of an image sequence, one after the other
+        class IFrameSourceDataRepository
+        {
+        public:
+            explicit IFrameSourceDataRepository() = default;
+            virtual ~IFrameSourceDataRepository() = default;
+
+            //Throws if the source cannot be read
+            virtual void Open(const std::string& source) = 0;
+
+            //R, G and B of the next frame (0 - 255), empty after the last one
+            virtual std::vector<FloatingPointImageData*> Read() = 0;
+
+            //Frames per second of the recording, 0 if unknown
+            virtual double GetFrameRate() const = 0;
+        };
+    }
+}
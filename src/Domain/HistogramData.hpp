@@ -1,6 +1,7 @@
 #pragma once
 
 #include "FloatingPointImageData.hpp"
+#include "MaskData.hpp"
 
 namespace ImageInformationAnalyzer
 {
@@ -40,10 +41,17 @@ namespace ImageInformationAnalyzer
 
         class IHistogramDataRepository
         {
+        protected:
+            //Region of interest, not owned
+            const MaskData* mask_ = nullptr;
+
         public:
             explicit IHistogramDataRepository() = default;
             virtual ~IHistogramDataRepository() = default;
 
+            //Following calls count the pixels inside the mask only. nullptr is the whole image
+            void SetMask(const MaskData* mask) { mask_ = mask; }
+
             virtual HistogramData* Process(const FloatingPointImageData* data, const int histogramSize, const double histogramMinValue, const double histogramMaxValue) = 0;
         };
     }
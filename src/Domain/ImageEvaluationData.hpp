@@ -1,5 +1,6 @@
 #pragma once
 #include "FloatingPointImageData.hpp"
+#include "MaskData.hpp"
 
 namespace ImageInformationAnalyzer
 {
@@ -19,10 +20,26 @@ namespace ImageInformationAnalyzer
 
         class IImageEvaluationDataRepository
         {
+        protected:
+            //Region of interest, not owned
+            const MaskData* mask_ = nullptr;
+
+            //Pixels that take part in the statistics, never 0
+            inline double GetPixelCount(const FloatingPointImageData* data) const
+            {
+                if(mask_ == nullptr) return (double)data->Width * data->Height;
+                if(mask_->Width != data->Width || mask_->Height != data->Height) throw std::invalid_argument("mask must have the same size as the image");
+                if(mask_->GetPixelCount() == 0) throw std::invalid_argument("mask must not be empty");
+                return (double)mask_->GetPixelCount();
+            }
+
         public:
             explicit IImageEvaluationDataRepository() = default;
             virtual ~IImageEvaluationDataRepository() = default;
 
+            //Following calls evaluate the pixels inside the mask only. nullptr is the whole image
+            void SetMask(const MaskData* mask) { mask_ = mask; }
+
             virtual ImageEvaluationData* Process(const FloatingPointImageData* data1, const FloatingPointImageData* data2, const double maxValue) = 0;
         };
 
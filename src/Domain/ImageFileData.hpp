@@ -19,6 +19,13 @@ namespace ImageInformationAnalyzer
             virtual ~IImageFileDataRepository() = default;
 
             virtual FloatingPointImageData* Load(const std::string& filePath, const Channel channel) = 0;
+
+            //R, G and B, repositories that can decode once override this
+            virtual std::vector<FloatingPointImageData*> LoadChannels(const std::string& filePath)
+            {
+                return { Load(filePath, Channel::R), Load(filePath, Channel::G), Load(filePath, Channel::B) };
+            }
+
             virtual bool Store(const FloatingPointImageData* r, const FloatingPointImageData* g, const FloatingPointImageData* b, const std::string& filePath) = 0;
 
             virtual bool IsExtensionSupported(const std::string& extension) = 0;
@@ -2,6 +2,8 @@
 
 #include "FloatingPointImageData.hpp"
 
+#include <algorithm>
+
 namespace ImageInformationAnalyzer
 {
 	namespace Misc
@@ -31,6 +33,7 @@ namespace ImageInformationAnalyzer
                 }
 
                 std::vector<ImagePoint> points;
+                points.reserve((size_t)windowSize * windowSize);
                 for(auto offsetY = -windowSize / 2; offsetY < windowSize / 2 + 1; ++offsetY)
                 {
                     for(auto offsetX = -windowSize / 2; offsetX < windowSize / 2 + 1; ++offsetX)
@@ -69,6 +72,122 @@ namespace ImageInformationAnalyzer
                 return points;
             }
 
+            //Gaussian pyramid reduction: 5-tap binomial filter, then every other pixel
+            template<typename T>
+            static inline std::vector<std::vector<T>> PyramidDown(const std::vector<std::vector<T>>& buffer)
+            {
+                const auto height = (int)buffer.size();
+                const auto width = (int)buffer[0].size();
+                const auto halfWidth = (width + 1) / 2;
+                const auto halfHeight = (height + 1) / 2;
+
+                const double kernel[] = { 1.0 / 16, 4.0 / 16, 6.0 / 16, 4.0 / 16, 1.0 / 16 };
+
+                //Horizontal
+                std::vector<std::vector<T>> horizontal;
+                horizontal.resize(height);
+                for(auto y = 0; y < height; ++y)
+                {
+                    horizontal[y].resize(halfWidth);
+                    for(auto x = 0; x < halfWidth; ++x)
+                    {
+                        T value = buffer[y][2 * x] * kernel[2];
+                        for(auto k = 1; k <= 2; ++k)
+                        {
+                            value += buffer[y][std::max(2 * x - k, 0)] * kernel[2 - k];
+                            value += buffer[y][std::min(2 * x + k, width - 1)] * kernel[2 + k];
+                        }
+                        horizontal[y][x] = value;
+                    }
+                }
+
+                //Vertical
+                std::vector<std::vector<T>> result;
+                result.resize(halfHeight);
+                for(auto y = 0; y < halfHeight; ++y)
+                {
+                    result[y].resize(halfWidth);
+                    for(auto x = 0; x < halfWidth; ++x)
+                    {
+                        T value = horizontal[2 * y][x] * kernel[2];
+                        for(auto k = 1; k <= 2; ++k)
+                        {
+                            value += horizontal[std::max(2 * y - k, 0)][x] * kernel[2 - k];
+                            value += horizontal[std::min(2 * y + k, height - 1)][x] * kernel[2 + k];
+                        }
+                        result[y][x] = value;
+                    }
+                }
+                return result;
+            }
+
+            //Sum over the (2 * radius + 1)^2 window of every pixel, wrapping around like GetWindowPoints()
+            //Running sums: O(1) per pixel for any radius
+            static inline std::vector<std::vector<double>> BoxSum(const std::vector<std::vector<double>>& buffer, const int radius)
+            {
+                const auto height = (int)buffer.size();
+                const auto width = (int)buffer[0].size();
+                auto wrap = [](const int i, const int size) { return (i % size + size) % size; };
+
+                //Horizontal
+                std::vector<std::vector<double>> horizontal(height, std::vector<double>(width));
+                for(auto y = 0; y < height; ++y)
+                {
+                    auto sum = 0.0;
+                    for(auto k = -radius; k <= radius; ++k)
+                    {
+                        sum += buffer[y][wrap(k, width)];
+                    }
+                    for(auto x = 0; x < width; ++x)
+                    {
+                        horizontal[y][x] = sum;
+                        sum += buffer[y][wrap(x + radius + 1, width)] - buffer[y][wrap(x - radius, width)];
+                    }
+                }
+
+                //Vertical, row by row
+                std::vector<std::vector<double>> result(height, std::vector<double>(width));
+                std::vector<double> sums(width, 0.0);
+                for(auto k = -radius; k <= radius; ++k)
+                {
+                    const auto& line = horizontal[wrap(k, height)];
+                    for(auto x = 0; x < width; ++x)
+                    {
+                        sums[x] += line[x];
+                    }
+                }
+                for(auto y = 0; y < height; ++y)
+                {
+                    const auto& enter = horizontal[wrap(y + radius + 1, height)];
+                    const auto& leave = horizontal[wrap(y - radius, height)];
+                    for(auto x = 0; x < width; ++x)
+                    {
+                        result[y][x] = sums[x];
+                        sums[x] += enter[x] - leave[x];
+                    }
+                }
+                return result;
+            }
+
+            //Normals of the surface z = buffer(x, y) from central differences, same convention as the window fits
+            static inline std::vector<std::vector<Eigen::Vector3d>> GetGradientNormals(const std::vector<std::vector<double>>& buffer)
+            {
+                const auto height = (int)buffer.size();
+                const auto width = (int)buffer[0].size();
+
+                std::vector<std::vector<Eigen::Vector3d>> normals(height, std::vector<Eigen::Vector3d>(width));
+                for(auto y = 0; y < height; ++y)
+                {
+                    for(auto x = 0; x < width; ++x)
+                    {
+                        auto dzdx = (buffer[y][(x + 1) % width] - buffer[y][(x + width - 1) % width]) / 2;
+                        auto dzdy = (buffer[(y + 1) % height][x] - buffer[(y + height - 1) % height][x]) / 2;
+                        normals[y][x] = Eigen::Vector3d(-dzdx, -dzdy, 1).normalized();
+                    }
+                }
+                return normals;
+            }
+
             static inline double DoubleAdd(double a, double b)
             {
                 auto sub = a - b;
@@ -1,6 +1,7 @@
 #pragma once
 
 #include "FloatingPointImageData.hpp"
+#include "MaskData.hpp"
 
 #include <execution>
 
@@ -8,12 +9,39 @@ namespace ImageInformationAnalyzer
 {
     namespace Domain
     {
+        struct LightEstimationSetting
+        {
+            //Stratified sampling: ratio of pixels used for the first fit
+            double InitialSampleRatio = 0.01;
+            //Stratified sampling: upper limit of the progressive refinement
+            double MaxSampleRatio = 0.16;
+            //Stratified sampling: stop refining when the parameters move less than this
+            double StableThreshold = 1e-3;
+            //Stratified sampling: also fit against every pixel and report both results, off only where the sampled fit is already validated
+            bool CompareWithWholePixel = true;
+            //Concurrent solves from a grid over the light hemisphere, 1 = single start
+            int MultiStartCount = 1;
+            //Pyramid: number of levels below the full resolution image
+            int PyramidLevelCount = 4;
+            //Pyramid: last level to solve, 0 = full resolution
+            int PyramidFinestLevel = 1;
+            //Frames of a video: each Process() starts from the solution of the previous one with a single start, the pyramid solves its finest level only
+            bool WarmStart = false;
+        };
+
         class ILightEstimationDataRepository
         {
+        protected:
+            //Region of interest, not owned
+            const MaskData* mask_ = nullptr;
+
         public:
             explicit ILightEstimationDataRepository() = default;
             virtual ~ILightEstimationDataRepository() = default;
 
+            //Following calls fit the residuals of the pixels inside the mask only, the surface is still reconstructed everywhere. nullptr is the whole image
+            void SetMask(const MaskData* mask) { mask_ = mask; }
+
             virtual FloatingPointImageData* Process(const FloatingPointImageData* denoisedR, const FloatingPointImageData* denoisedG, const FloatingPointImageData* denoisedB, const FloatingPointImageData* differentialB_G, const double pixelPitch, std::atomic<double>* progress = nullptr) = 0;
         };
 
@@ -0,0 +1 @@
+#include "MaskData.hpp"
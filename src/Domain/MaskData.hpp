@@ -0,0 +1,105 @@
+#pragma once
+
+#include <vector>
+#include <algorithm>
+#include <stdexcept>
+
+namespace ImageInformationAnalyzer
+{
+    namespace Domain
+    {
+        //Region of interest, pixels outside are skipped by kernels and statistics
+        class MaskData
+        {
+        public:
+            const int Width;
+            const int Height;
+            const std::vector<std::vector<unsigned char>> MaskBuffer;
+
+        private:
+            int pixelCount_;
+            int left_;
+            int top_;
+            int right_;
+            int bottom_;
+
+            static inline std::vector<std::vector<unsigned char>> GetRectangleBuffer(const int width, const int height, const int left, const int top, const int rectangleWidth, const int rectangleHeight)
+            {
+                std::vector<std::vector<unsigned char>> buffer(height, std::vector<unsigned char>(width, 0));
+                for(auto y = std::max(top, 0); y < std::min(top + rectangleHeight, height); ++y)
+                {
+                    for(auto x = std::max(left, 0); x < std::min(left + rectangleWidth, width); ++x)
+                    {
+                        buffer[y][x] = 1;
+                    }
+                }
+                return buffer;
+            }
+
+        public:
+            //Binary plane, non-zero is inside
+            explicit MaskData(const int width, const int height, const std::vector<std::vector<unsigned char>> maskBuffer) : Width(width), Height(height), MaskBuffer(maskBuffer)
+            {
+                if(width <= 0 || height <= 0) throw std::invalid_argument("mask size must be greater than 0");
+                if((int)maskBuffer.size() != height) throw std::invalid_argument("mask buffer must have the same height as the mask");
+                for(const auto& line : maskBuffer)
+                {
+                    if((int)line.size() != width) throw std::invalid_argument("mask buffer must have the same width as the mask");
+                }
+
+                pixelCount_ = 0;
+                left_ = width;
+                top_ = height;
+                right_ = 0;
+                bottom_ = 0;
+
+                for(auto y = 0; y < height; ++y)
+                {
+                    for(auto x = 0; x < width; ++x)
+                    {
+                        if(maskBuffer[y][x] == 0) continue;
+
+                        pixelCount_++;
+                        left_ = std::min(left_, x);
+                        top_ = std::min(top_, y);
+                        right_ = std::max(right_, x + 1);
+                        bottom_ = std::max(bottom_, y + 1);
+                    }
+                }
+            }
+
+            //Rectangle
+            explicit MaskData(const int width, const int height, const int left, const int top, const int rectangleWidth, const int rectangleHeight)
+                : MaskData(width, height, GetRectangleBuffer(width, height, left, top, rectangleWidth, rectangleHeight))
+            {
+            }
+
+            inline bool IsInside(const int x, const int y) const { return MaskBuffer[y][x] != 0; }
+            inline int GetPixelCount() const { return pixelCount_; }
+
+            //Whether any pixel of [startX, endX) x [startY, endY) is inside
+            inline bool IsTileInside(const int startX, const int startY, const int endX, const int endY) const
+            {
+                //bounding box first
+                if(endX <= left_ || right_ <= startX || endY <= top_ || bottom_ <= startY) return false;
+
+                for(auto y = std::max(startY, top_); y < std::min(endY, bottom_); ++y)
+                {
+                    for(auto x = std::max(startX, left_); x < std::min(endX, right_); ++x)
+                    {
+                        if(MaskBuffer[y][x] != 0) return true;
+                    }
+                }
+                return false;
+            }
+
+            virtual ~MaskData() = default;
+        };
+
+        //nullptr is the whole image
+        static inline bool IsInsideMask(const MaskData* mask, const int x, const int y)
+        {
+            return mask == nullptr || mask->IsInside(x, y);
+        }
+    }
+}
@@ -0,0 +1 @@
+#include "MatrixUtility.hpp"
@@ -0,0 +1,110 @@
+#pragma once
+
+#include "FloatingPointImageData.hpp"
+
+namespace ImageInformationAnalyzer
+{
+    namespace Misc
+    {
+        //Small fixed size eigen problems of the renormalization
+        class MatrixUtility
+        {
+            enum
+            {
+                MAX_LOOP = 64
+            };
+
+            template<int Size>
+            static inline Eigen::Matrix<double, Size, 1> GetSeed(const Eigen::Matrix<double, Size, 1>& seed)
+            {
+                if(seed.squaredNorm() > 0) return seed.normalized();
+                return Eigen::Matrix<double, Size, 1>::Ones().normalized();
+            }
+
+        public:
+            //Eigenvector of N*theta = mu*M*theta with the largest mu, M positive definite
+            //Same as GeneralizedSelfAdjointEigenSolver(N, M).eigenvectors().col(Size - 1)
+            //The fitted direction makes M nearly singular, so that mu dominates and
+            //theta <- M^-1 * N * theta converges in a few loops from the previous theta
+            template<int Size>
+            static inline Eigen::Matrix<double, Size, 1> GetLargestGeneralizedEigenvector(const Eigen::Matrix<double, Size, Size>& N, const Eigen::Matrix<double, Size, Size>& M, const Eigen::Matrix<double, Size, 1>& seed, const double tolerance = 1e-12)
+            {
+                Eigen::LLT<Eigen::Matrix<double, Size, Size>> llt(M);
+                if(llt.info() == Eigen::Success)
+                {
+                    Eigen::Matrix<double, Size, 1> theta = GetSeed(seed);
+
+                    for(auto loop = 0; loop < MAX_LOOP; ++loop)
+                    {
+                        Eigen::Matrix<double, Size, 1> next = llt.solve(N * theta).normalized();
+                        if(next.dot(theta) < 0) next = -next;
+
+                        auto distance = (next - theta).template lpNorm<1>();
+                        theta = next;
+                        if(distance <= tolerance) break;
+                    }
+
+                    //Must be an eigenpair with a positive eigenvalue, otherwise another eigenvalue dominated
+                    Eigen::Matrix<double, Size, 1> Ntheta = N * theta;
+                    Eigen::Matrix<double, Size, 1> Mtheta = M * theta;
+                    auto mu = theta.dot(Ntheta) / theta.dot(Mtheta);
+                    if(mu > 0 && (Ntheta - mu * Mtheta).norm() <= 1e-8 * Ntheta.norm())
+                    {
+                        return theta;
+                    }
+                }
+
+                //Fallback: full decomposition
+                Eigen::GeneralizedSelfAdjointEigenSolver<Eigen::Matrix<double, Size, Size>> GES(N, M);
+                return GES.eigenvectors().col(Size - 1).normalized();
+            }
+
+            //Inverse of a symmetric positive semi-definite matrix without its smallest eigenvalue (rank Size - 1)
+            //Same as the sum of v*v^t/lambda over the eigenpairs of SelfAdjointEigenSolver(M) but the first
+            template<int Size>
+            static inline Eigen::Matrix<double, Size, Size> GetTruncatedInverse(const Eigen::Matrix<double, Size, Size>& M, const Eigen::Matrix<double, Size, 1>& seed, const double tolerance = 1e-12)
+            {
+                Eigen::LLT<Eigen::Matrix<double, Size, Size>> llt(M);
+                if(llt.info() == Eigen::Success)
+                {
+                    //Smallest eigenvector by inverse iteration
+                    Eigen::Matrix<double, Size, 1> v = GetSeed(seed);
+                    for(auto loop = 0; loop < MAX_LOOP; ++loop)
+                    {
+                        Eigen::Matrix<double, Size, 1> next = llt.solve(v).normalized();
+                        if(next.dot(v) < 0) next = -next;
+
+                        auto distance = (next - v).template lpNorm<1>();
+                        v = next;
+                        if(distance <= tolerance) break;
+                    }
+
+                    Eigen::Matrix<double, Size, 1> Mv = M * v;
+                    auto lambda = v.dot(Mv);
+                    if((Mv - lambda * v).norm() <= 1e-8 * M.norm())
+                    {
+                        //Lift the smallest eigenvalue, invert, then project it out
+                        Eigen::Matrix<double, Size, Size> lifted = M + M.trace() * v * v.transpose();
+                        Eigen::Matrix<double, Size, Size> projection = Eigen::Matrix<double, Size, Size>::Identity() - v * v.transpose();
+
+                        Eigen::LLT<Eigen::Matrix<double, Size, Size>> liftedLLT(lifted);
+                        if(liftedLLT.info() == Eigen::Success)
+                        {
+                            Eigen::Matrix<double, Size, Size> inverse = liftedLLT.solve(Eigen::Matrix<double, Size, Size>::Identity());
+                            return projection * inverse * projection;
+                        }
+                    }
+                }
+
+                //Fallback: full decomposition
+                Eigen::SelfAdjointEigenSolver<Eigen::Matrix<double, Size, Size>> SES(M);
+                Eigen::Matrix<double, Size, Size> Mi = Eigen::Matrix<double, Size, Size>().Zero();
+                for(int i = 1; i < Size; i++)
+                {
+                    Mi += SES.eigenvectors().col(i) * SES.eigenvectors().col(i).transpose() / SES.eigenvalues()(i);
+                }
+                return Mi;
+            }
+        };
+    }
+}
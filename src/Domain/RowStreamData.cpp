@@ -0,0 +1 @@
+#include "RowStreamData.hpp"
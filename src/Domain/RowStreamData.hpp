@@ -0,0 +1,115 @@
+#pragma once
+#include "FloatingPointImageData.hpp"
+
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+namespace ImageInformationAnalyzer
+{
+    namespace Domain
+    {
+        //Rows of an image file from top to bottom, the image is never held as a whole
+        class IRowSourceDataRepository
+        {
+        public:
+            explicit IRowSourceDataRepository() = default;
+            virtual ~IRowSourceDataRepository() = default;
+
+            //Throws if the file cannot be read
+            virtual void Open(const std::string& filePath) = 0;
+
+            virtual int GetWidth() const = 0;
+            virtual int GetHeight() const = 0;
+
+            //R, G and B of the next row (0 - 255), false after the last one
+            virtual bool ReadRow(std::vector<double>& r, std::vector<double>& g, std::vector<double>& b) = 0;
+
+            //Memory held by the decoder
+            virtual size_t GetBufferBytes() const = 0;
+        };
+
+        //8 bit RGB image file written row by row
+        class IRowSinkDataRepository
+        {
+        public:
+            explicit IRowSinkDataRepository() = default;
+            virtual ~IRowSinkDataRepository() = default;
+
+            //Throws if the extension is not supported
+            virtual void Create(const std::string& filePath, const int width, const int height) = 0;
+
+            //R, G and B of row y (0 - 255), the rows may come in any order
+            virtual void WriteRow(const int y, const std::vector<double>& r, const std::vector<double>& g, const std::vector<double>& b) = 0;
+
+            //All the rows have been written
+            virtual void Close() = 0;
+
+            //Memory held by the encoder
+            virtual size_t GetBufferBytes() const = 0;
+        };
+
+        //Rows of a plane streamed from top to bottom: the last 2 * radius + 1 rows,
+        //and the first 2 * radius rows that the bottom of the image wraps around to (GetWindowPoints())
+        class LineBuffer
+        {
+            const int width_;
+            const int radius_;
+
+            std::vector<std::vector<double>> head_;
+            std::vector<std::vector<double>> ring_;
+
+            //Rows pushed so far
+            int rowCount_;
+
+        public:
+            explicit LineBuffer(const int width, const int radius) : width_(width), radius_(radius), rowCount_(0)
+            {
+                ring_.assign(2 * radius + 1, std::vector<double>(width));
+            }
+            virtual ~LineBuffer() = default;
+
+            void Push(const std::vector<double>& row)
+            {
+                if(row.size() != width_) throw std::invalid_argument("row must have the width of the buffer");
+
+                if(rowCount_ < 2 * radius_) head_.push_back(row);
+                ring_[rowCount_ % ring_.size()] = row;
+                rowCount_++;
+            }
+
+            //The first rows or one of the last ones
+            const std::vector<double>& GetRow(const int y) const
+            {
+                if(y < (int)head_.size()) return head_[y];
+                if(y >= rowCount_ || y < rowCount_ - (int)ring_.size()) throw std::logic_error("row is not in the buffer");
+
+                return ring_[y % ring_.size()];
+            }
+
+            inline size_t GetBytes() const
+            {
+                return (head_.size() + ring_.size()) * width_ * sizeof(double);
+            }
+        };
+
+        //Rows of several planes kept aside, for the stages that need the whole image before they can go on
+        //Rows are stored at their place, so they may be written in any order and read again in any order
+        class IRowSpillDataRepository
+        {
+        public:
+            explicit IRowSpillDataRepository() = default;
+            virtual ~IRowSpillDataRepository() = default;
+
+            //Throws if the spill cannot be created, a previous spill is removed first
+            virtual void Create(const std::string& filePath, const int width, const int planeCount) = 0;
+
+            //Row y of each plane, in the order of Create()
+            virtual void WriteRow(const int y, const std::vector<const std::vector<double>*>& planes) = 0;
+            virtual void ReadRow(const int y, const std::vector<std::vector<double>*>& planes) = 0;
+
+            //Does nothing without a spill
+            virtual void Remove() = 0;
+        };
+    }
+}
@@ -0,0 +1 @@
+#include "TiledImageData.hpp"
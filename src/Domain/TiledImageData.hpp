@@ -0,0 +1,209 @@
+#pragma once
+#include "FloatingPointImageData.hpp"
+
+#include <algorithm>
+#include <cfloat>
+#include <mutex>
+#include <stdexcept>
+#include <vector>
+
+namespace ImageInformationAnalyzer
+{
+    namespace Domain
+    {
+        //Scratch space of the out-of-core images, only a part of it is in memory at a time
+        class ITileStorageDataRepository
+        {
+        public:
+            explicit ITileStorageDataRepository() = default;
+            virtual ~ITileStorageDataRepository() = default;
+
+            //Space of the given size, returns its id
+            virtual int Allocate(const size_t bytes) = 0;
+            virtual void Release(const int id) = 0;
+
+            //Copies between the space and the memory, thread safe
+            virtual void Read(const int id, const size_t offset, void* destination, const size_t bytes) = 0;
+            virtual void Write(const int id, const size_t offset, const void* source, const size_t bytes) = 0;
+
+            //Bytes of the spaces in memory now and at the peak
+            virtual size_t GetResidentBytes() const = 0;
+            virtual size_t GetPeakResidentBytes() const = 0;
+        };
+
+        //Out-of-core counterpart of FloatingPointImageData: the plane and the normals live in a scratch space, tile by tile
+        //The repositories are not changed, they process tiles read as FloatingPointImageData
+        class TiledImageData
+        {
+            static_assert(sizeof(Eigen::Vector3d) == 3 * sizeof(double), "normals are stored as 3 doubles");
+
+        public:
+            const int Width;
+            const int Height;
+            const int TileSize;
+
+        private:
+            //Not owned
+            ITileStorageDataRepository* storage_;
+            int id_;
+
+            //Range of each tile, for GetMinValue() / GetMaxValue()
+            std::vector<double> tileMaxValues_;
+            std::vector<double> tileMinValues_;
+            mutable std::mutex mutex_;
+
+            //Each tile is TileSize x TileSize values and then as many normals, the tiles on the right and the bottom are padded
+            inline size_t GetTileBytes() const
+            {
+                return (size_t)TileSize * TileSize * 4 * sizeof(double);
+            }
+
+            inline size_t GetValueOffset(const int x, const int y) const
+            {
+                const auto tileIndex = (size_t)(y / TileSize) * GetTileCountX() + x / TileSize;
+                return tileIndex * GetTileBytes() + ((size_t)(y % TileSize) * TileSize + x % TileSize) * sizeof(double);
+            }
+
+            inline size_t GetNormalOffset(const int x, const int y) const
+            {
+                const auto tileIndex = (size_t)(y / TileSize) * GetTileCountX() + x / TileSize;
+                return tileIndex * GetTileBytes() + (size_t)TileSize * TileSize * sizeof(double) + ((size_t)(y % TileSize) * TileSize + x % TileSize) * sizeof(Eigen::Vector3d);
+            }
+
+            //length pixels of row y from column x on, wrapped around like GetWindowPoints()
+            //Split into the runs that are contiguous inside a tile
+            template<typename Copy>
+            inline void ForEachRun(const int x, const int y, const int length, Copy copy) const
+            {
+                const auto wrappedY = (y % Height + Height) % Height;
+                auto done = 0;
+                while(done < length)
+                {
+                    const auto wrappedX = ((x + done) % Width + Width) % Width;
+                    const auto run = std::min({ length - done, TileSize - wrappedX % TileSize, Width - wrappedX });
+                    copy(wrappedX, wrappedY, done, run);
+                    done += run;
+                }
+            }
+
+        public:
+            explicit TiledImageData(const int width, const int height, const int tileSize, ITileStorageDataRepository* storage) : Width(width), Height(height), TileSize(tileSize), storage_(storage)
+            {
+                if(width < 1 || height < 1) throw std::invalid_argument("image must not be empty");
+                if(tileSize < 1) throw std::invalid_argument("tile size must be greater than 0");
+
+                id_ = storage_->Allocate(GetTileBytes() * GetTileCount());
+                tileMaxValues_.assign(GetTileCount(), -DBL_MAX);
+                tileMinValues_.assign(GetTileCount(), DBL_MAX);
+            }
+            TiledImageData(const TiledImageData&) = delete;
+            TiledImageData& operator=(const TiledImageData&) = delete;
+            virtual ~TiledImageData()
+            {
+                storage_->Release(id_);
+            }
+
+            inline int GetTileCountX() const { return (Width + TileSize - 1) / TileSize; }
+            inline int GetTileCountY() const { return (Height + TileSize - 1) / TileSize; }
+            inline int GetTileCount() const { return GetTileCountX() * GetTileCountY(); }
+
+            //Pixels of the tile without the halo
+            inline int GetTileWidth(const int tileIndex) const { return std::min(TileSize, Width - (tileIndex % GetTileCountX()) * TileSize); }
+            inline int GetTileHeight(const int tileIndex) const { return std::min(TileSize, Height - (tileIndex / GetTileCountX()) * TileSize); }
+
+            //Same as FloatingPointImageData, over the tiles written so far
+            inline double GetMaxValue() const
+            {
+                std::lock_guard<std::mutex> lock(mutex_);
+                return *std::max_element(tileMaxValues_.begin(), tileMaxValues_.end());
+            }
+            inline double GetMinValue() const
+            {
+                std::lock_guard<std::mutex> lock(mutex_);
+                return *std::min_element(tileMinValues_.begin(), tileMinValues_.end());
+            }
+
+            //Tile with halo pixels on each side, wrapped around like GetWindowPoints()
+            //A repository whose window radius is at most halo gives the same tile as on the whole image
+            FloatingPointImageData* ReadTile(const int tileIndex, const int halo) const
+            {
+                const auto startX = (tileIndex % GetTileCountX()) * TileSize - halo;
+                const auto startY = (tileIndex / GetTileCountX()) * TileSize - halo;
+                const auto width = GetTileWidth(tileIndex) + 2 * halo;
+                const auto height = GetTileHeight(tileIndex) + 2 * halo;
+
+                std::vector<std::vector<double>> imageBuffer(height, std::vector<double>(width));
+                std::vector<std::vector<Eigen::Vector3d>> normalBuffer(height, std::vector<Eigen::Vector3d>(width));
+                for(auto localY = 0; localY < height; ++localY)
+                {
+                    ForEachRun(startX, startY + localY, width, [&](const int x, const int y, const int localX, const int run)
+                    {
+                        storage_->Read(id_, GetValueOffset(x, y), &imageBuffer[localY][localX], run * sizeof(double));
+                        storage_->Read(id_, GetNormalOffset(x, y), normalBuffer[localY][localX].data(), run * sizeof(Eigen::Vector3d));
+                    });
+                }
+                return new FloatingPointImageData(width, height, imageBuffer, normalBuffer);
+            }
+
+            //The inside of a tile read with ReadTile(tileIndex, halo), e.g. the result of a repository
+            void WriteTile(const int tileIndex, const int halo, const FloatingPointImageData* data)
+            {
+                const auto tileWidth = GetTileWidth(tileIndex);
+                const auto tileHeight = GetTileHeight(tileIndex);
+                if(data->Width != tileWidth + 2 * halo || data->Height != tileHeight + 2 * halo) throw std::invalid_argument("tile must have the size of ReadTile()");
+
+                const auto startX = (tileIndex % GetTileCountX()) * TileSize;
+                const auto startY = (tileIndex / GetTileCountX()) * TileSize;
+                auto maxValue = -DBL_MAX;
+                auto minValue = DBL_MAX;
+                for(auto localY = 0; localY < tileHeight; ++localY)
+                {
+                    const auto& line = data->ImageBuffer[localY + halo];
+                    storage_->Write(id_, GetValueOffset(startX, startY + localY), &line[halo], tileWidth * sizeof(double));
+                    storage_->Write(id_, GetNormalOffset(startX, startY + localY), data->NormalBuffer[localY + halo][halo].data(), tileWidth * sizeof(Eigen::Vector3d));
+
+                    for(auto localX = halo; localX < halo + tileWidth; ++localX)
+                    {
+                        maxValue = std::max(maxValue, line[localX]);
+                        minValue = std::min(minValue, line[localX]);
+                    }
+                }
+
+                std::lock_guard<std::mutex> lock(mutex_);
+                tileMaxValues_[tileIndex] = maxValue;
+                tileMinValues_[tileIndex] = minValue;
+            }
+
+            //Whole row y, e.g. for a decoder or an encoder that works row by row
+            void ReadRow(const int y, std::vector<double>& values) const
+            {
+                values.resize(Width);
+                ForEachRun(0, y, Width, [&](const int x, const int wrappedY, const int offset, const int run)
+                {
+                    storage_->Read(id_, GetValueOffset(x, wrappedY), &values[offset], run * sizeof(double));
+                });
+            }
+
+            //Normals are set to (0, 0, 1) like a loaded image
+            void WriteRow(const int y, const std::vector<double>& values)
+            {
+                if(values.size() != Width) throw std::invalid_argument("row must have the width of the image");
+
+                const std::vector<Eigen::Vector3d> normals(Width, Eigen::Vector3d(0, 0, 1));
+                ForEachRun(0, y, Width, [&](const int x, const int wrappedY, const int offset, const int run)
+                {
+                    storage_->Write(id_, GetValueOffset(x, wrappedY), &values[offset], run * sizeof(double));
+                    storage_->Write(id_, GetNormalOffset(x, wrappedY), normals[offset].data(), run * sizeof(Eigen::Vector3d));
+                });
+
+                const auto tileIndex = (y / TileSize) * GetTileCountX();
+                std::lock_guard<std::mutex> lock(mutex_);
+                for(auto x = 0; x < Width; ++x)
+                {
+                    tileMaxValues_[tileIndex + x / TileSize] = std::max(tileMaxValues_[tileIndex + x / TileSize], values[x]);
+                    tileMinValues_[tileIndex + x / TileSize] = std::min(tileMinValues_[tileIndex + x / TileSize], values[x]);
+                }
+            }
+        };
+    }
+}
@@ -0,0 +1 @@
+#include "AdaptiveDenoiseDataRepository.hpp"
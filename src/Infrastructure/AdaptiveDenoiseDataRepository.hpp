@@ -0,0 +1,74 @@
+#pragma once
+
+#include "FloatingPointImageData.hpp"
+#include "CircleDenoiseDataRepository.hpp"
+#include "EllipseDenoiseDataRepository.hpp"
+#include "HyperEllipseDenoiseDataRepository.hpp"
+
+namespace ImageInformationAnalyzer
+{
+    namespace Infrastructure
+    {
+        using namespace Domain;
+
+        //Circle fit everywhere, only the pixels whose Circle fitting error exceeds DenoiseSetting::AdaptiveThreshold
+        //(edges, vessels) are refitted with Refiner
+        //Model map: 0 = Circle, 1 = Refiner
+        template<typename Refiner>
+        class AdaptiveDenoiseDataRepository : public DenoiseImageDataRepositoryBase<AdaptiveDenoiseDataRepository<Refiner>>
+        {
+            friend class DenoiseImageDataRepositoryBase<AdaptiveDenoiseDataRepository<Refiner>>;
+
+        protected:
+            enum
+            {
+                MODEL_COUNT = 2
+            };
+
+            //The ellipse points are a superset of the Circle points, so both fits share the window
+            typedef typename Refiner::ImagePoint ImagePoint;
+
+            CircleDenoiseDataRepository circle_;
+            Refiner refiner_;
+
+            //The Circle fit already is the cheap first tier, the refiner gets the full loop limit
+            static inline DenoiseSetting GetRefinerSetting(const DenoiseSetting& setting)
+            {
+                auto refinerSetting = setting;
+                refinerSetting.TwoTierScheduling = false;
+                return refinerSetting;
+            }
+
+            inline bool DenoiseWindow(std::vector<ImagePoint>& windowPoints, double& denoisedPixel, Eigen::Vector3d& normal, double& fittingError, const bool secondTier, unsigned char& model)
+            {
+                model = 0;
+                circle_.DenoiseWindow(windowPoints, denoisedPixel, normal, fittingError, secondTier);
+                if(fittingError <= this->setting_.AdaptiveThreshold) return true;
+
+                auto refinedPixel = 0.0;
+                auto refinedFittingError = 0.0;
+                Eigen::Vector3d refinedNormal;
+                if(!refiner_.DenoiseWindow(windowPoints, refinedPixel, refinedNormal, refinedFittingError, secondTier))
+                {
+                    //Keep the Circle fit
+                    return false;
+                }
+
+                model = 1;
+                denoisedPixel = refinedPixel;
+                normal = refinedNormal;
+                fittingError = refinedFittingError;
+                return true;
+            }
+
+        public:
+            explicit AdaptiveDenoiseDataRepository(const DenoiseSetting& setting = DenoiseSetting()) : DenoiseImageDataRepositoryBase<AdaptiveDenoiseDataRepository<Refiner>>(GetRefinerSetting(setting)), circle_(setting), refiner_(GetRefinerSetting(setting))
+            {
+            }
+            virtual ~AdaptiveDenoiseDataRepository() = default;
+        };
+
+        typedef AdaptiveDenoiseDataRepository<EllipseDenoiseDataRepository> AdaptiveEllipseDenoiseDataRepository;
+        typedef AdaptiveDenoiseDataRepository<HyperEllipseDenoiseDataRepository> AdaptiveHyperEllipseDenoiseDataRepository;
+    }
+}
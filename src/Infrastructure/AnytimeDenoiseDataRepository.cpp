@@ -0,0 +1 @@
+#include "AnytimeDenoiseDataRepository.hpp"
@@ -0,0 +1,234 @@
+#pragma once
+
+#include "FloatingPointImageData.hpp"
+#include "CircleDenoiseDataRepository.hpp"
+#include "EllipseDenoiseDataRepository.hpp"
+#include "HyperEllipseDenoiseDataRepository.hpp"
+
+#include <chrono>
+#include <thread>
+
+namespace ImageInformationAnalyzer
+{
+    namespace Infrastructure
+    {
+        using namespace Domain;
+
+        //Best result within DenoiseSetting::TimeBudget: the Circle fit tile by tile first,
+        //then tiles are refitted with Refiner, the tile with the largest Circle fitting error first
+        //Both tiers stop at the deadline, tiles not reached by the Circle pass keep the input
+        //Model map: -1 = input (not reached or outside of the mask), 0 = Circle, 1 = Refiner
+        template<typename Refiner>
+        class AnytimeDenoiseDataRepository : public IDenoiseImageDataRepository
+        {
+            //The ellipse points are a superset of the Circle points
+            typedef typename Refiner::ImagePoint ImagePoint;
+
+            CircleDenoiseDataRepository circle_;
+            Refiner refiner_;
+
+            //The Circle fit already is the first tier, the refiner gets the full loop limit
+            static inline DenoiseSetting GetRefinerSetting(const DenoiseSetting& setting)
+            {
+                auto refinerSetting = setting;
+                refinerSetting.TwoTierScheduling = false;
+                return refinerSetting;
+            }
+
+            //Pixels of a tile, the window vector is reused for all of them
+            //Returns the sum of the fitting errors
+            template<typename Kernel>
+            static inline double ProcessTile(const FloatingPointImageData* data, const MaskData* mask, const int tile, const int tileSize, std::vector<ImagePoint>& windowPoints, Kernel kernel)
+            {
+                auto width = data->Width;
+                auto height = data->Height;
+                const auto tileCountX = (width + tileSize - 1) / tileSize;
+                const auto startX = (tile % tileCountX) * tileSize;
+                const auto startY = (tile / tileCountX) * tileSize;
+
+                auto totalFittingError = 0.0;
+                for(auto y = startY; y < std::min(startY + tileSize, height); ++y)
+                {
+                    for(auto x = startX; x < std::min(startX + tileSize, width); ++x)
+                    {
+                        if(!IsInsideMask(mask, x, y)) continue;
+
+                        //Wraps around like GetWindowPoints()
+                        for(auto& point : windowPoints)
+                        {
+                            point.Value = data->ImageBuffer[(y + height + point.OffsetY) % height][(x + width + point.OffsetX) % width];
+                        }
+                        totalFittingError += kernel(windowPoints, x, y);
+                    }
+                }
+                return totalFittingError;
+            }
+
+            //kernel(order) for the orders 0 to count - 1 in this order, until the deadline
+            //The waves keep the priority order, each worker checks the deadline before a tile,
+            //so the deadline is overrun by one tile per worker at most
+            //Returns the flags of the processed orders
+            template<typename Kernel>
+            static inline std::vector<char> ProcessUntil(const int count, const std::chrono::steady_clock::time_point& deadline, Kernel kernel)
+            {
+                std::vector<char> processed(count, 0);
+                std::vector<int> orders(count);
+                std::iota(orders.begin(), orders.end(), 0);
+
+                const auto waveSize = std::max((int)std::thread::hardware_concurrency(), 1) * 4;
+                for(auto waveStart = 0; waveStart < count && std::chrono::steady_clock::now() < deadline; waveStart += waveSize)
+                {
+                    std::for_each(std::execution::par, orders.begin() + waveStart, orders.begin() + std::min(waveStart + waveSize, count), [&](const int order)
+                    {
+                        if(std::chrono::steady_clock::now() >= deadline) return;
+                        kernel(order);
+                        processed[order] = 1;
+                    });
+                }
+                return processed;
+            }
+
+            //modelMap: model of each pixel
+            FloatingPointImageData* Denoise(const FloatingPointImageData* data, const std::chrono::steady_clock::time_point& deadline, std::atomic<int>* processedPixel, std::vector<std::vector<double>>& modelMap)
+            {
+                const auto start = std::chrono::steady_clock::now();
+
+                auto width = data->Width;
+                auto height = data->Height;
+                const auto tileSize = std::max(setting_.AnytimeTileSize, 1);
+                const auto tileCountX = (width + tileSize - 1) / tileSize;
+                const auto tileCountY = (height + tileSize - 1) / tileSize;
+                if(mask_ != nullptr && (mask_->Width != width || mask_->Height != height)) throw std::invalid_argument("mask must have the same size as the image");
+
+                //Pixels outside of the mask and tiles not reached keep the input
+                auto imageBuffer = data->ImageBuffer;
+                auto normalBuffer = data->NormalBuffer;
+                modelMap.assign(height, std::vector<double>(width, -1.0));
+
+                //Tiles outside of the mask are skipped entirely
+                std::vector<int> tileIndices;
+                for(auto tile = 0; tile < tileCountX * tileCountY; ++tile)
+                {
+                    const auto startX = (tile % tileCountX) * tileSize;
+                    const auto startY = (tile / tileCountX) * tileSize;
+                    if(mask_ != nullptr && !mask_->IsTileInside(startX, startY, std::min(startX + tileSize, width), std::min(startY + tileSize, height))) continue;
+                    tileIndices.push_back(tile);
+                }
+                const auto tileCount = (int)tileIndices.size();
+
+                //Circle, the fitting error of each tile is its priority
+                std::vector<double> tileErrors(tileCount, 0.0);
+                auto circleTiles = ProcessUntil(tileCount, deadline, [&](const int order)
+                {
+                    auto windowPoints = Misc::ImageUtility::GetWindowPoints<ImagePoint>(WINDOW_SIZE);
+                    tileErrors[order] = ProcessTile(data, mask_, tileIndices[order], tileSize, windowPoints, [&](std::vector<ImagePoint>& points, const int x, const int y)
+                    {
+                        auto error = 0.0;
+                        circle_.DenoiseWindow(points, imageBuffer[y][x], normalBuffer[y][x], error, false);
+                        modelMap[y][x] = 0;
+
+                        if(processedPixel != nullptr) (*processedPixel)++;
+                        return error;
+                    });
+                });
+
+                std::vector<int> refineOrders;
+                for(auto order = 0; order < tileCount; ++order)
+                {
+                    if(circleTiles[order]) refineOrders.push_back(order);
+                }
+                std::sort(refineOrders.begin(), refineOrders.end(), [&](const int a, const int b) { return tileErrors[a] > tileErrors[b]; });
+
+                const auto circleElapsed = std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::steady_clock::now() - start).count();
+
+                //C++17
+                std::atomic<int> errorPixel(0);
+
+                auto refinedTiles = ProcessUntil((int)refineOrders.size(), deadline, [&](const int order)
+                {
+                    auto windowPoints = Misc::ImageUtility::GetWindowPoints<ImagePoint>(WINDOW_SIZE);
+                    ProcessTile(data, mask_, tileIndices[refineOrders[order]], tileSize, windowPoints, [&](std::vector<ImagePoint>& points, const int x, const int y)
+                    {
+                        auto denoisedPixel = 0.0;
+                        auto fittingError = 0.0;
+                        Eigen::Vector3d normal;
+                        if(refiner_.DenoiseWindow(points, denoisedPixel, normal, fittingError, false))
+                        {
+                            imageBuffer[y][x] = denoisedPixel;
+                            normalBuffer[y][x] = normal;
+                            modelMap[y][x] = 1;
+                        }
+                        else
+                        {
+                            //Keep the Circle fit
+                            errorPixel++;
+                        }
+                        return fittingError;
+                    });
+                });
+
+                auto elapsed = std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::steady_clock::now() - start).count();
+                if(!quiet_)
+                {
+                    std::cout << "Circle tiles: "s << std::count(circleTiles.begin(), circleTiles.end(), 1) << "/"s << tileCount << " in "s << circleElapsed << "ms, refined tiles: "s << std::count(refinedTiles.begin(), refinedTiles.end(), 1) << "/"s << refineOrders.size() << " in "s << elapsed << "ms"s << std::endl;
+                    std::cout << "Error Pixel: "s << errorPixel << std::endl;
+                }
+
+                return new FloatingPointImageData(width, height, imageBuffer, normalBuffer);
+            }
+
+            //Deadline of the share of the budget, the time left over by a plane carries over to the next one
+            inline std::chrono::steady_clock::time_point GetDeadline(const std::chrono::steady_clock::time_point& start, const double share) const
+            {
+                return start + std::chrono::microseconds((long long)(setting_.TimeBudget * 1000 * share));
+            }
+
+        public:
+            explicit AnytimeDenoiseDataRepository(const DenoiseSetting& setting = DenoiseSetting()) : IDenoiseImageDataRepository(setting), circle_(setting), refiner_(GetRefinerSetting(setting))
+            {
+            }
+            virtual ~AnytimeDenoiseDataRepository() = default;
+
+            virtual FloatingPointImageData* Process(const FloatingPointImageData* data, std::atomic<int>* processedPixel = nullptr) override
+            {
+                std::vector<std::vector<double>> modelMap;
+                return Denoise(data, GetDeadline(std::chrono::steady_clock::now(), 1.0), processedPixel, modelMap);
+            }
+
+            //Same as IDenoiseImageDataRepository::ProcessPasses(), with the model maps of the last pass
+            //The budget is for the whole call, each channel and pass gets an equal share of it
+            virtual std::vector<FloatingPointImageData*> ProcessPasses(const std::vector<const FloatingPointImageData*>& data, const int passCount, std::atomic<int>* processedPixel = nullptr, ModelMaps* modelMaps = nullptr) override
+            {
+                if(passCount < 1) throw std::invalid_argument("pass count must be greater than 0");
+                if(modelMaps != nullptr) modelMaps->clear();
+
+                const auto start = std::chrono::steady_clock::now();
+                const auto planeCount = (double)(data.size() * passCount);
+                auto plane = 0;
+
+                std::vector<FloatingPointImageData*> results;
+                for(auto pass = 0; pass < passCount; ++pass)
+                {
+                    std::vector<std::unique_ptr<FloatingPointImageData>> previous(results.begin(), results.end());
+                    auto sources = pass == 0 ? data : std::vector<const FloatingPointImageData*>(results.begin(), results.end());
+
+                    results.clear();
+                    for(auto source : sources)
+                    {
+                        std::vector<std::vector<double>> modelMap;
+                        results.push_back(Denoise(source, GetDeadline(start, ++plane / planeCount), processedPixel, modelMap));
+
+                        if(modelMaps == nullptr || pass < passCount - 1) continue;
+                        auto height = (int)modelMap.size();
+                        auto width = (int)modelMap[0].size();
+                        modelMaps->emplace_back(new FloatingPointImageData(width, height, modelMap, std::vector<std::vector<Eigen::Vector3d>>(height, std::vector<Eigen::Vector3d>(width, Eigen::Vector3d(0, 0, 1)))));
+                    }
+                }
+                return results;
+            }
+        };
+
+        typedef AnytimeDenoiseDataRepository<EllipseDenoiseDataRepository> AnytimeEllipseDenoiseDataRepository;
+        typedef AnytimeDenoiseDataRepository<HyperEllipseDenoiseDataRepository> AnytimeHyperEllipseDenoiseDataRepository;
+    }
+}
@@ -12,9 +12,15 @@ namespace ImageInformationAnalyzer
         using namespace Domain;
         using namespace Misc;
 
-        class CircleDenoiseDataRepository : public IDenoiseImageDataRepository
+        class CircleDenoiseDataRepository : public DenoiseImageDataRepositoryBase<CircleDenoiseDataRepository>
         {
+            friend class DenoiseImageDataRepositoryBase<CircleDenoiseDataRepository>;
+            template<typename Refiner> friend class AdaptiveDenoiseDataRepository;
+            template<typename Refiner> friend class AnytimeDenoiseDataRepository;
+
         protected:
+            typedef ImageUtility::ImagePointBase ImagePoint;
+
             Eigen::FullPivLU<Eigen::Matrix3d> windowLUMatrix_;
 
             //WindowSizeが決まれば一意に決まる行列
@@ -52,7 +58,8 @@ namespace ImageInformationAnalyzer
             }
 
             //Param: A,C,E
-            inline std::tuple<double, double, double> GetParamAandCandE(const std::vector<ImageUtility::ImagePointBase>& windowPoints) const
+            template<typename Point>
+            inline std::tuple<double, double, double> GetParamAandCandE(const std::vector<Point>& windowPoints) const
             {
                 //Ax = bを解く
                 auto b1 = 0.0;
@@ -75,7 +82,8 @@ namespace ImageInformationAnalyzer
             }
 
             //Param: B, D
-            inline std::tuple<double, double> GetParamBandD(const std::vector<ImageUtility::ImagePointBase>& windowPoints) const
+            template<typename Point>
+            inline std::tuple<double, double> GetParamBandD(const std::vector<Point>& windowPoints) const
             {
                 auto B1 = 0.0;
                 auto B2 = 0.0;
@@ -97,7 +105,7 @@ namespace ImageInformationAnalyzer
             }
 
         public:
-            explicit CircleDenoiseDataRepository()
+            explicit CircleDenoiseDataRepository(const DenoiseSetting& setting = DenoiseSetting()) : DenoiseImageDataRepositoryBase(setting)
             {
                 auto windowPoints = ImageUtility::GetWindowPoints<ImageUtility::ImagePointBase>(WINDOW_SIZE);
                 windowLUMatrix_ = CreateWindowLUMatrix(windowPoints);
@@ -105,13 +113,11 @@ namespace ImageInformationAnalyzer
             virtual ~CircleDenoiseDataRepository() = default;
 
         protected:
-            virtual inline bool DenoisePixel(const FloatingPointImageData* data, const int x, const int y, const int windowSize, double& denoisedPixel, Eigen::Vector3d& normal, double& fittingError) override
+            //Any point type derived from ImagePointBase, so that the adaptive mode can share the window with the ellipse fit
+            //Closed form, the tier does not matter
+            template<typename Point>
+            inline bool DenoiseWindow(std::vector<Point>& windowPoints, double& denoisedPixel, Eigen::Vector3d& normal, double& fittingError, const bool)
             {
-                auto width = data->Width;
-                auto height = data->Height;
-
-                auto windowPoints = ImageUtility::GetWindowPoints<ImageUtility::ImagePointBase>(data, x, y, windowSize);
-
                 //Oを真値として、Sを実測値とする
                 //O = a*x^2 + b*x + c*y^2 + d*y + e
                 //誤差 = S - Oとしたときに誤差が0となる
@@ -29,13 +29,17 @@ namespace ImageInformationAnalyzer
                 auto A11 = 0.0;
                 auto A12 = 0.0;
                 auto A21 = 0.0;
-                auto A22 = (double)windowBufferSize;
+                auto A22 = 0.0;
 
                 auto c1 = 0.0;
                 auto c2 = 0.0;
 
                 for(auto i = 0; i < windowBufferSize; i++)
                 {
+                    //Points outside of the mask are not part of the fit
+                    if(!IsInsideMask(mask_, window1[i].X, window1[i].Y)) continue;
+
+                    A22 += 1;
                     A11 += std::pow(window2[i].Value, 2);
                     A12 += window2[i].Value;
 
@@ -63,10 +67,16 @@ namespace ImageInformationAnalyzer
             explicit EachPixelSpectrumDifferentialDataRepository() = default;
             virtual ~EachPixelSpectrumDifferentialDataRepository() = default;
 
+            virtual int GetWindowRadius() const override
+            {
+                return WINDOW_SIZE / 2;
+            }
+
             virtual FloatingPointImageData* Process(const FloatingPointImageData* data1, const FloatingPointImageData* data2, std::atomic<int>* processedPixel = nullptr) override
             {
                 auto width = data1->Width;
                 auto height = data1->Height;
+                if(mask_ != nullptr && (mask_->Width != width || mask_->Height != height)) throw std::invalid_argument("mask must have the same size as the image");
 
                 //Prepare buffers
                 std::vector<std::vector<double>> imageBuffer;
@@ -86,14 +96,16 @@ namespace ImageInformationAnalyzer
                 //Set to 0
                 if(processedPixel != nullptr) *processedPixel = 0;
 
+                //Pixels inside of the mask only
                 std::vector<std::tuple<int, int, double, double, double>> processBuffer;
-                processBuffer.resize((size_t)width * height);
+                processBuffer.reserve(mask_ != nullptr ? (size_t)mask_->GetPixelCount() : (size_t)width * height);
 
                 for(auto y = 0; y < height; ++y)
                 {
                     for(auto x = 0; x < width; ++x)
                     {
-                        processBuffer[(size_t)y * width + x] = std::tuple(x, y, data1->ImageBuffer[y][x], data2->ImageBuffer[y][x], 0.0);
+                        if(!IsInsideMask(mask_, x, y)) continue;
+                        processBuffer.push_back(std::tuple(x, y, data1->ImageBuffer[y][x], data2->ImageBuffer[y][x], 0.0));
                     }
                 }
 
@@ -102,7 +114,7 @@ namespace ImageInformationAnalyzer
             #else
                 auto parallelPolicy = std::execution::par;
             #endif
-                std::for_each(parallelPolicy, processBuffer.begin(), processBuffer.end(), [&](std::tuple<int, int, double, double, double> param)
+                std::for_each(parallelPolicy, processBuffer.begin(), processBuffer.end(), [&](std::tuple<int, int, double, double, double>& param)
                 {
                     const auto x = std::get<0>(param);
                     const auto y = std::get<1>(param);
@@ -119,7 +131,7 @@ namespace ImageInformationAnalyzer
                     auto b = std::get<1>(coef);
 
                     //Diff
-                    std::get<4>(processBuffer[(size_t)y * width + x]) = ImageUtility::DoubleSub(image1Pixel, ImageUtility::DoubleAdd(a * image2Pixel, b));
+                    std::get<4>(param) = ImageUtility::DoubleSub(image1Pixel, ImageUtility::DoubleAdd(a * image2Pixel, b));
 
                     //Next
                     if(processedPixel != nullptr) (*processedPixel)++;
@@ -2,6 +2,7 @@
 
 #include "DenoiseImageData.hpp"
 #include "ImageUtility.hpp"
+#include "MatrixUtility.hpp"
 
 #include <tuple>
 
@@ -12,8 +13,16 @@ namespace ImageInformationAnalyzer
         using namespace Domain;
         using namespace Misc;
 
-        class EllipseDenoiseDataRepository : public IDenoiseImageDataRepository
+        //Common part of the ellipse fits, Derived::Renormalize() is called without virtual dispatch (CRTP)
+        template<typename Derived>
+        class EllipseDenoiseDataRepositoryBase : public DenoiseImageDataRepositoryBase<Derived>
         {
+            friend class DenoiseImageDataRepositoryBase<Derived>;
+            template<typename Refiner> friend class AdaptiveDenoiseDataRepository;
+            template<typename Fitter> friend class PyramidDenoiseDataRepository;
+            template<typename Refiner> friend class AnytimeDenoiseDataRepository;
+            template<typename Fitter> friend class TemporalDenoiseDataRepository;
+
         protected:
             const int MAX_LOOP = 1000;
             const double ERROR_THRESHOLD = 0.0001;
@@ -25,6 +34,7 @@ namespace ImageInformationAnalyzer
                 Eigen::Matrix<double, 7, 7> Variance0Matrix;
                 Eigen::Matrix<double, 7, 7> OperatorSMatrix;
             };
+            typedef ImagePointEllipse ImagePoint;
 
             //A*x^2 + B*2xy + C*y^2 + D*2f0x + E*2f0y + F * f0^2  + G * (-2f0z) = 0
             //θ = [A, B, C, D, E, F, G]
@@ -32,6 +42,12 @@ namespace ImageInformationAnalyzer
             //(θ, ζ) = 0
             //(θ, ζtζθ) = 0
 
+            //Loop limit of the tier
+            inline int GetMaxLoop(const bool secondTier) const
+            {
+                return this->setting_.TwoTierScheduling && !secondTier ? std::min(this->setting_.FirstTierMaxLoop, MAX_LOOP) : MAX_LOOP;
+            }
+
             inline Eigen::Matrix<double, 7, 1> GetZetaVector(const double x, const double y, const double z, const double f0)
             {
                 Eigen::Matrix<double, 7, 1> zeta;
@@ -61,16 +77,35 @@ namespace ImageInformationAnalyzer
                 return 4 * mat;
             }
 
-            //くりこみ法
-            virtual bool Renormalize(Eigen::Matrix<double, 7, 1>& theta0, const std::vector<ImagePointEllipse>& windowPoints)
+            //Only the hyper renormalization uses S[zeta * e^t]
+            inline Eigen::Matrix<double, 7, 7> GetOperatorSMatrix(Eigen::Matrix<double, 7, 1>&)
             {
-                std::vector<double> Ws;
-                for(auto i = 0; i < windowPoints.size(); i++)
+                return Eigen::Matrix<double, 7, 7>().Zero();
+            }
+
+            //Weights of the first iteration: 1 without a start value, otherwise those of theta0 (warm start)
+            inline std::vector<double> GetInitialWeights(const Eigen::Matrix<double, 7, 1>& theta0, const std::vector<ImagePointEllipse>& windowPoints)
+            {
+                std::vector<double> Ws(windowPoints.size(), 1.0);
+                if(theta0.isZero()) return Ws;
+
+                for(auto i = 0; i < windowPoints.size(); ++i)
                 {
-                    Ws.push_back(1.0);//1.0で初期化
+                    auto variance = theta0.dot(windowPoints[i].Variance0Matrix * theta0);
+                    if(variance > 0) Ws[i] = 1 / variance;
                 }
+                return Ws;
+            }
 
-                for(auto loop = 0; loop < MAX_LOOP; ++loop)
+            //くりこみ法
+            //theta0: start value (zero for a cold start) and result
+            //secondTier: the full loop limit, and the sign of theta is ignored when checking the convergence
+            inline bool Renormalize(Eigen::Matrix<double, 7, 1>& theta0, const std::vector<ImagePointEllipse>& windowPoints, const bool secondTier)
+            {
+                auto Ws = GetInitialWeights(theta0, windowPoints);
+
+                const auto maxLoop = GetMaxLoop(secondTier);
+                for(auto loop = 0; loop < maxLoop; ++loop)
                 {
                     //Mの算出
                     Eigen::Matrix<double, 7, 7> M = Eigen::Matrix<double, 7, 7>().Zero();
@@ -94,15 +129,13 @@ namespace ImageInformationAnalyzer
                     //なのでNとMが逆になる
 
                     //一般固有値を解く
-                    Eigen::GeneralizedSelfAdjointEigenSolver<Eigen::Matrix<double, 7, 7>> GES(N, M);
-                    //Eigen::SelfAdjointEigenSolver<Eigen::Matrix<double, 7, 7>> SES(M);
-
                     //最大固有値
-                    Eigen::Matrix<double, 7, 1> theta = GES.eigenvectors().col(6).normalized();
+                    //Only the largest eigenpair is needed, seeded with the previous theta
+                    Eigen::Matrix<double, 7, 1> theta = MatrixUtility::GetLargestGeneralizedEigenvector<7>(N, M, theta0);
                     //Eigen::Matrix<double, 7, 1> theta = SES.eigenvectors().col(0).normalized();
 
                     //終了チェック
-                    auto distance = GetVectorDistance(theta0, theta);
+                    auto distance = secondTier ? GetDirectionDistance(theta0, theta) : GetVectorDistance(theta0, theta);
                     if(distance <= ERROR_THRESHOLD)
                     {
                         theta0 = theta;
@@ -117,7 +150,7 @@ namespace ImageInformationAnalyzer
                     }
                     theta0 = theta;
 
-                    if(loop == MAX_LOOP - 1)
+                    if(loop == maxLoop - 1)
                     {
                         //std::cout << "detected max loop!: "s << distance << std::endl;
                         return false;
@@ -139,36 +172,43 @@ namespace ImageInformationAnalyzer
                 return result;
             }
 
+            //Eigenvectors have no sign, a flipping fallback solution must not keep the loop running
+            static inline double GetDirectionDistance(const Eigen::Matrix<double, 7, 1>& theta1, const Eigen::Matrix<double, 7, 1>& theta2)
+            {
+                return std::min(GetVectorDistance(theta1, theta2), GetVectorDistance(theta1, -theta2));
+            }
+
         public:
-            explicit EllipseDenoiseDataRepository()
+            explicit EllipseDenoiseDataRepositoryBase(const DenoiseSetting& setting = DenoiseSetting()) : DenoiseImageDataRepositoryBase<Derived>(setting)
             {
             }
-            virtual ~EllipseDenoiseDataRepository() = default;
+            virtual ~EllipseDenoiseDataRepositoryBase() = default;
 
         protected:       
-            virtual inline bool DenoisePixel(const FloatingPointImageData* data, const int x, const int y, const int windowSize, double& denoisedPixel, Eigen::Vector3d& normal, double& fittingError) override
+            inline bool DenoiseWindow(std::vector<ImagePointEllipse>& windowPoints, double& denoisedPixel, Eigen::Vector3d& normal, double& fittingError, const bool secondTier)
             {
-                auto width = data->Width;
-                auto height = data->Height;
-
-                auto windowPoints = ImageUtility::GetWindowPoints<ImagePointEllipse>(data, x, y, windowSize);
+                Eigen::Matrix<double, 7, 1> theta = Eigen::Matrix<double, 7, 1>().Zero();
+                return FitWindow(windowPoints, theta, denoisedPixel, normal, fittingError, secondTier);
+            }
 
-                auto f0 = windowSize;
+            //theta: start value of the renormalization (zero for a cold start) and the fitted conic
+            inline bool FitWindow(std::vector<ImagePointEllipse>& windowPoints, Eigen::Matrix<double, 7, 1>& theta, double& denoisedPixel, Eigen::Vector3d& normal, double& fittingError, const bool secondTier)
+            {
+                const int f0 = IDenoiseImageDataRepository::WINDOW_SIZE;
 
                 for(auto i = 0; i < windowPoints.size(); ++i)
                 {
                     windowPoints[i].ZetaVector = GetZetaVector(windowPoints[i].OffsetX, windowPoints[i].OffsetY, windowPoints[i].Value, f0);
                     windowPoints[i].ZetaMatrix = GetZetaMatrix(windowPoints[i].OffsetX, windowPoints[i].OffsetY, windowPoints[i].Value, f0);
                     windowPoints[i].Variance0Matrix = GetVariance0(windowPoints[i].OffsetX, windowPoints[i].OffsetY, f0);
-                    windowPoints[i].OperatorSMatrix = Eigen::Matrix<double, 7, 7>().Zero();
+                    windowPoints[i].OperatorSMatrix = static_cast<Derived*>(this)->GetOperatorSMatrix(windowPoints[i].ZetaVector);
                 }
 
                 //最適化
-                Eigen::Matrix<double, 7, 1> theta = Eigen::Matrix<double, 7, 1>().Zero();
-                if(!Renormalize(theta, windowPoints))
+                if(!static_cast<Derived*>(this)->Renormalize(theta, windowPoints, secondTier))
                 {
                     //計算が収束しなかった場合
-                    denoisedPixel = data->ImageBuffer[y][x];
+                    denoisedPixel = windowPoints[windowPoints.size() / 2].Value;
                     normal = Eigen::Vector3d(0, 0, 1);
                     fittingError = 0;
                     return false;
@@ -217,5 +257,14 @@ namespace ImageInformationAnalyzer
                 return true;
             }
         };
+
+        class EllipseDenoiseDataRepository : public EllipseDenoiseDataRepositoryBase<EllipseDenoiseDataRepository>
+        {
+        public:
+            explicit EllipseDenoiseDataRepository(const DenoiseSetting& setting = DenoiseSetting()) : EllipseDenoiseDataRepositoryBase(setting)
+            {
+            }
+            virtual ~EllipseDenoiseDataRepository() = default;
+        };
     }
 }
\ No newline at end of file
@@ -0,0 +1 @@
+#include "FileRowSpillDataRepository.hpp"
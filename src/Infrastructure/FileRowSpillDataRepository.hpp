@@ -0,0 +1,84 @@
+#pragma once
+
+#include "RowStreamData.hpp"
+
+#include <filesystem>
+#include <fstream>
+#include <stdexcept>
+#include <string>
+
+namespace ImageInformationAnalyzer
+{
+    namespace Infrastructure
+    {
+        using namespace Domain;
+        using namespace std::literals::string_literals;
+
+        //Spill in a temporary binary file, row y of all the planes at y * width * planeCount doubles
+        class FileRowSpillDataRepository : public IRowSpillDataRepository
+        {
+            std::string filePath_;
+            std::fstream file_;
+            int width_;
+            int planeCount_;
+
+            inline std::streamoff GetOffset(const int y) const
+            {
+                return (std::streamoff)y * width_ * planeCount_ * sizeof(double);
+            }
+
+        public:
+            explicit FileRowSpillDataRepository() : width_(0), planeCount_(0)
+            {
+            }
+            virtual ~FileRowSpillDataRepository()
+            {
+                Remove();
+            }
+
+            virtual void Create(const std::string& filePath, const int width, const int planeCount) override
+            {
+                Remove();
+
+                file_.open(filePath, std::ios::in | std::ios::out | std::ios::binary | std::ios::trunc);
+                if(!file_) throw std::runtime_error("cannot create the spill file: "s + filePath);
+
+                filePath_ = filePath;
+                width_ = width;
+                planeCount_ = planeCount;
+            }
+
+            virtual void WriteRow(const int y, const std::vector<const std::vector<double>*>& planes) override
+            {
+                file_.seekp(GetOffset(y));
+                for(auto plane : planes)
+                {
+                    file_.write(reinterpret_cast<const char*>(plane->data()), width_ * sizeof(double));
+                }
+                if(!file_) throw std::runtime_error("cannot write the spill file: "s + filePath_);
+            }
+
+            virtual void ReadRow(const int y, const std::vector<std::vector<double>*>& planes) override
+            {
+                file_.seekg(GetOffset(y));
+                for(auto plane : planes)
+                {
+                    plane->resize(width_);
+                    file_.read(reinterpret_cast<char*>(plane->data()), width_ * sizeof(double));
+                }
+                if(!file_) throw std::runtime_error("cannot read the spill file: "s + filePath_);
+            }
+
+            virtual void Remove() override
+            {
+                if(filePath_.empty()) return;
+
+                file_.close();
+                file_.clear();
+                std::error_code error;
+                std::filesystem::remove(filePath_, error);
+                filePath_.clear();
+            }
+        };
+    }
+}
@@ -2,6 +2,7 @@
 
 #include "ImageFileData.hpp"
 
+#include <algorithm>
 #include <stdexcept>
 #include <opencv2/opencv.hpp>
 
@@ -50,9 +51,10 @@ namespace ImageInformationAnalyzer
                     for(auto x = 0; x < img.cols; ++x)
                     {
                         //BGR
-                        img.data[y * img.step + x * img.elemSize() + 0] = static_cast<uchar>(b[y][x] + 0.5);
-                        img.data[y * img.step + x * img.elemSize() + 1] = static_cast<uchar>(g[y][x] + 0.5);
-                        img.data[y * img.step + x * img.elemSize() + 2] = static_cast<uchar>(r[y][x] + 0.5);
+                        //Denoised values may overshoot
+                        img.data[y * img.step + x * img.elemSize() + 0] = static_cast<uchar>(std::clamp(b[y][x], 0.0, 255.0) + 0.5);
+                        img.data[y * img.step + x * img.elemSize() + 1] = static_cast<uchar>(std::clamp(g[y][x], 0.0, 255.0) + 0.5);
+                        img.data[y * img.step + x * img.elemSize() + 2] = static_cast<uchar>(std::clamp(r[y][x], 0.0, 255.0) + 0.5);
                     }
                 }
 
@@ -88,6 +90,24 @@ namespace ImageInformationAnalyzer
                 return new FloatingPointImageData(width, height, imageBuffer, normalBuffer);
             }
 
+            //One decode for the three channels
+            virtual std::vector<FloatingPointImageData*> LoadChannels(const std::string& filePath) override
+            {
+                auto imgMat = cv::imread(filePath);
+                if(imgMat.empty()) throw std::invalid_argument("file not found!: "s + filePath);
+
+                auto width = imgMat.cols;
+                auto height = imgMat.rows;
+                std::vector<std::vector<Eigen::Vector3d>> normalBuffer(height, std::vector<Eigen::Vector3d>(width, Eigen::Vector3d(0, 0, 1)));//dummy
+
+                std::vector<FloatingPointImageData*> channels;
+                for(auto channel : { IImageFileDataRepository::Channel::R, IImageFileDataRepository::Channel::G, IImageFileDataRepository::Channel::B })
+                {
+                    channels.push_back(new FloatingPointImageData(width, height, ReadCVMat(imgMat, channel), normalBuffer));
+                }
+                return channels;
+            }
+
             virtual bool Store(const FloatingPointImageData* r, const FloatingPointImageData* g, const FloatingPointImageData* b, const std::string& filePath) override
             {
                 auto width = r->Width;
@@ -0,0 +1 @@
+#include "GraphicRowStreamDataRepository.hpp"
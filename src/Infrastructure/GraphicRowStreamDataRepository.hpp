@@ -0,0 +1,251 @@
+#pragma once
+
+#include "RowStreamData.hpp"
+
+#include <algorithm>
+#include <cctype>
+#include <filesystem>
+#include <fstream>
+#include <stdexcept>
+#include <opencv2/opencv.hpp>
+
+namespace ImageInformationAnalyzer
+{
+    namespace Infrastructure
+    {
+        using namespace Domain;
+        using namespace std::literals::string_literals;
+
+        //Binary PPM / PGM (8 bit) are read row by row
+        //The other formats are decoded by OpenCV at once and kept as 8 bit, 3 bytes per pixel instead of the floating point planes
+        class GraphicRowSourceDataRepository : public IRowSourceDataRepository
+        {
+            std::ifstream file_;
+            cv::Mat image_;
+
+            int width_;
+            int height_;
+            int channelCount_;
+            int nextRow_;
+
+            std::vector<unsigned char> line_;
+
+            //Header token, # starts a comment
+            inline std::string ReadToken()
+            {
+                std::string token;
+                auto c = file_.get();
+                while(file_ && (std::isspace(c) || c == '#'))
+                {
+                    if(c == '#')
+                    {
+                        while(file_ && c != '\n') c = file_.get();
+                    }
+                    c = file_.get();
+                }
+                while(file_ && !std::isspace(c))
+                {
+                    token.push_back((char)c);
+                    c = file_.get();
+                }
+                //The single white space after the last token is consumed as well
+                return token;
+            }
+
+            inline void OpenNetpbm(const std::string& filePath)
+            {
+                file_.open(filePath, std::ios::binary);
+                if(!file_) throw std::invalid_argument("file not found!: "s + filePath);
+
+                auto magic = ReadToken();
+                if(magic != "P6"s && magic != "P5"s) throw std::invalid_argument("binary PPM / PGM only: "s + filePath);
+                channelCount_ = magic == "P6"s ? 3 : 1;
+
+                width_ = std::stoi(ReadToken());
+                height_ = std::stoi(ReadToken());
+                if(std::stoi(ReadToken()) != 255) throw std::invalid_argument("8 bit PPM / PGM only: "s + filePath);
+
+                line_.resize((size_t)width_ * channelCount_);
+            }
+
+        public:
+            explicit GraphicRowSourceDataRepository() : width_(0), height_(0), channelCount_(0), nextRow_(0)
+            {
+            }
+            virtual ~GraphicRowSourceDataRepository() = default;
+
+            virtual void Open(const std::string& filePath) override
+            {
+                file_.close();
+                file_.clear();
+                image_.release();
+                nextRow_ = 0;
+
+                auto extension = std::filesystem::path(filePath).extension().string();
+                std::transform(extension.begin(), extension.end(), extension.begin(), [](unsigned char c) { return (char)std::tolower(c); });
+                if(extension == ".ppm"s || extension == ".pgm"s || extension == ".pnm"s)
+                {
+                    OpenNetpbm(filePath);
+                    return;
+                }
+
+                image_ = cv::imread(filePath);
+                if(image_.empty()) throw std::invalid_argument("file not found!: "s + filePath);
+                if(image_.depth() != CV_8U) throw std::invalid_argument("8 bit images only");
+
+                width_ = image_.cols;
+                height_ = image_.rows;
+                channelCount_ = image_.channels();
+            }
+
+            virtual int GetWidth() const override
+            {
+                return width_;
+            }
+
+            virtual int GetHeight() const override
+            {
+                return height_;
+            }
+
+            virtual bool ReadRow(std::vector<double>& r, std::vector<double>& g, std::vector<double>& b) override
+            {
+                if(nextRow_ >= height_) return false;
+
+                r.resize(width_);
+                g.resize(width_);
+                b.resize(width_);
+
+                if(!image_.empty())
+                {
+                    //BGR, grayscale is spread to the three planes
+                    const auto* line = image_.data + nextRow_ * image_.step;
+                    for(auto x = 0; x < width_; ++x)
+                    {
+                        const auto* pixel = line + x * image_.elemSize();
+                        r[x] = (double)pixel[channelCount_ >= 3 ? 2 : 0];
+                        g[x] = (double)pixel[channelCount_ >= 3 ? 1 : 0];
+                        b[x] = (double)pixel[0];
+                    }
+                }
+                else
+                {
+                    file_.read(reinterpret_cast<char*>(line_.data()), line_.size());
+                    if(!file_) throw std::runtime_error("file is truncated at row "s + std::to_string(nextRow_));
+
+                    //RGB
+                    for(auto x = 0; x < width_; ++x)
+                    {
+                        const auto* pixel = line_.data() + (size_t)x * channelCount_;
+                        r[x] = (double)pixel[0];
+                        g[x] = (double)pixel[channelCount_ >= 3 ? 1 : 0];
+                        b[x] = (double)pixel[channelCount_ >= 3 ? 2 : 0];
+                    }
+                }
+
+                nextRow_++;
+                return true;
+            }
+
+            virtual size_t GetBufferBytes() const override
+            {
+                return image_.empty() ? line_.size() : image_.total() * image_.elemSize();
+            }
+        };
+
+        //Binary PPM is written row by row at the place of each row
+        //The other formats are collected as 8 bit and stored by OpenCV on Close()
+        class GraphicRowSinkDataRepository : public IRowSinkDataRepository
+        {
+            std::string filePath_;
+            std::fstream file_;
+            std::streamoff headerSize_;
+            cv::Mat image_;
+
+            int width_;
+            int height_;
+
+            std::vector<unsigned char> line_;
+
+            //Same rounding as GraphicFileDataRepository::WriteCVMat()
+            static inline unsigned char ToByte(const double value)
+            {
+                return static_cast<unsigned char>(std::clamp(value, 0.0, 255.0) + 0.5);
+            }
+
+        public:
+            explicit GraphicRowSinkDataRepository() : headerSize_(0), width_(0), height_(0)
+            {
+            }
+            virtual ~GraphicRowSinkDataRepository() = default;
+
+            virtual void Create(const std::string& filePath, const int width, const int height) override
+            {
+                Close();
+
+                filePath_ = filePath;
+                width_ = width;
+                height_ = height;
+
+                auto extension = std::filesystem::path(filePath).extension().string();
+                std::transform(extension.begin(), extension.end(), extension.begin(), [](unsigned char c) { return (char)std::tolower(c); });
+                if(extension == ".ppm"s || extension == ".pnm"s)
+                {
+                    file_.open(filePath, std::ios::in | std::ios::out | std::ios::binary | std::ios::trunc);
+                    if(!file_) throw std::runtime_error("cannot create "s + filePath);
+
+                    auto header = "P6\n"s + std::to_string(width) + " "s + std::to_string(height) + "\n255\n"s;
+                    file_.write(header.data(), header.size());
+                    headerSize_ = (std::streamoff)header.size();
+                    line_.resize((size_t)width * 3);
+                    return;
+                }
+                if(extension != ".png"s && extension != ".bmp"s && extension != ".jpg"s && extension != ".jpeg"s) throw std::invalid_argument("unsupported extension: "s + extension);
+
+                image_ = cv::Mat(height, width, CV_8UC3);
+            }
+
+            virtual void WriteRow(const int y, const std::vector<double>& r, const std::vector<double>& g, const std::vector<double>& b) override
+            {
+                if(y < 0 || y >= height_) throw std::invalid_argument("row is out of the image");
+
+                if(!image_.empty())
+                {
+                    //BGR
+                    auto* line = image_.data + y * image_.step;
+                    for(auto x = 0; x < width_; ++x)
+                    {
+                        line[x * 3 + 0] = ToByte(b[x]);
+                        line[x * 3 + 1] = ToByte(g[x]);
+                        line[x * 3 + 2] = ToByte(r[x]);
+                    }
+                    return;
+                }
+
+                for(auto x = 0; x < width_; ++x)
+                {
+                    line_[(size_t)x * 3 + 0] = ToByte(r[x]);
+                    line_[(size_t)x * 3 + 1] = ToByte(g[x]);
+                    line_[(size_t)x * 3 + 2] = ToByte(b[x]);
+                }
+                file_.seekp(headerSize_ + (std::streamoff)y * line_.size());
+                file_.write(reinterpret_cast<const char*>(line_.data()), line_.size());
+                if(!file_) throw std::runtime_error("cannot write "s + filePath_);
+            }
+
+            virtual void Close() override
+            {
+                if(!image_.empty() && !cv::imwrite(filePath_, image_)) throw std::runtime_error("cannot write "s + filePath_);
+
+                image_.release();
+                file_.close();
+                filePath_.clear();
+            }
+
+            virtual size_t GetBufferBytes() const override
+            {
+                return image_.empty() ? line_.size() : image_.total() * image_.elemSize();
+            }
+        };
+    }
+}
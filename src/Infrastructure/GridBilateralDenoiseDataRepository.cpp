@@ -0,0 +1 @@
+#include "GridBilateralDenoiseDataRepository.hpp"
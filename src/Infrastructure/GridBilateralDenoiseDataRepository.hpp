@@ -0,0 +1,159 @@
+#pragma once
+
+#include "FloatingPointImageData.hpp"
+#include "DenoiseImageData.hpp"
+#include "ImageUtility.hpp"
+
+namespace ImageInformationAnalyzer
+{
+    namespace Infrastructure
+    {
+        using namespace Domain;
+        using namespace Misc;
+
+        //Bilateral grid (Chen et al.): splat into a coarse (x, y, value) grid, blur it, read back by trilinear interpolation
+        //Spatial cell: DenoiseSetting::FilterRadius pixels, range cell: DenoiseSetting::BilateralRangeSigma
+        class GridBilateralDenoiseDataRepository : public IDenoiseImageDataRepository
+        {
+            //Cells of the grid, with one padding cell on each side
+            struct Grid
+            {
+                int Width;
+                int Height;
+                int Depth;
+                std::vector<double> Values;
+                std::vector<double> Weights;
+
+                inline size_t GetIndex(const int x, const int y, const int z) const
+                {
+                    return ((size_t)z * Height + y) * Width + x;
+                }
+            };
+
+            //[1 2 1] along one axis
+            static inline void Blur(std::vector<double>& cells, const Grid& grid, const int stepX, const int stepY, const int stepZ)
+            {
+                auto source = cells;
+                for(auto z = stepZ; z < grid.Depth - stepZ; ++z)
+                {
+                    for(auto y = stepY; y < grid.Height - stepY; ++y)
+                    {
+                        for(auto x = stepX; x < grid.Width - stepX; ++x)
+                        {
+                            cells[grid.GetIndex(x, y, z)] = 2 * source[grid.GetIndex(x, y, z)]
+                                + source[grid.GetIndex(x - stepX, y - stepY, z - stepZ)]
+                                + source[grid.GetIndex(x + stepX, y + stepY, z + stepZ)];
+                        }
+                    }
+                }
+            }
+
+            static inline double Interpolate(const std::vector<double>& cells, const Grid& grid, const double x, const double y, const double z)
+            {
+                const auto x0 = std::clamp((int)x, 0, grid.Width - 2);
+                const auto y0 = std::clamp((int)y, 0, grid.Height - 2);
+                const auto z0 = std::clamp((int)z, 0, grid.Depth - 2);
+                const auto fx = x - x0;
+                const auto fy = y - y0;
+                const auto fz = z - z0;
+
+                auto value = 0.0;
+                for(auto k = 0; k < 2; ++k)
+                {
+                    for(auto j = 0; j < 2; ++j)
+                    {
+                        for(auto i = 0; i < 2; ++i)
+                        {
+                            auto weight = (i == 0 ? 1 - fx : fx) * (j == 0 ? 1 - fy : fy) * (k == 0 ? 1 - fz : fz);
+                            value += weight * cells[grid.GetIndex(x0 + i, y0 + j, z0 + k)];
+                        }
+                    }
+                }
+                return value;
+            }
+
+        public:
+            explicit GridBilateralDenoiseDataRepository(const DenoiseSetting& setting = DenoiseSetting()) : IDenoiseImageDataRepository(setting)
+            {
+                //The range cells divide the value range
+                if(!(setting.BilateralRangeSigma > 0)) throw std::invalid_argument("bilateral range sigma must be greater than 0");
+            }
+            virtual ~GridBilateralDenoiseDataRepository() = default;
+
+            //Blur over the neighbouring cells. The cells start at the image origin, so a tile is close to but not the same as the whole image
+            virtual int GetWindowRadius() const override
+            {
+                return 2 * std::max(setting_.FilterRadius, 1);
+            }
+
+            virtual FloatingPointImageData* Process(const FloatingPointImageData* data, std::atomic<int>* processedPixel = nullptr) override
+            {
+                auto width = data->Width;
+                auto height = data->Height;
+                const auto spatialSigma = (double)std::max(setting_.FilterRadius, 1);
+                const auto rangeSigma = setting_.BilateralRangeSigma;
+
+                const auto& image = data->ImageBuffer;
+                auto minValue = image[0][0];
+                auto maxValue = image[0][0];
+                for(const auto& line : image)
+                {
+                    for(auto value : line)
+                    {
+                        minValue = std::min(minValue, value);
+                        maxValue = std::max(maxValue, value);
+                    }
+                }
+
+                Grid grid;
+                grid.Width = (int)(width / spatialSigma) + 3;
+                grid.Height = (int)(height / spatialSigma) + 3;
+                grid.Depth = (int)((maxValue - minValue) / rangeSigma) + 3;
+                grid.Values.resize((size_t)grid.Width * grid.Height * grid.Depth, 0.0);
+                grid.Weights.resize(grid.Values.size(), 0.0);
+
+                //Splat
+                for(auto y = 0; y < height; ++y)
+                {
+                    for(auto x = 0; x < width; ++x)
+                    {
+                        auto index = grid.GetIndex((int)std::lround(x / spatialSigma) + 1, (int)std::lround(y / spatialSigma) + 1, (int)std::lround((image[y][x] - minValue) / rangeSigma) + 1);
+                        grid.Values[index] += image[y][x];
+                        grid.Weights[index] += 1.0;
+                    }
+                }
+
+                //Blur
+                for(auto cells : { &grid.Values, &grid.Weights })
+                {
+                    Blur(*cells, grid, 1, 0, 0);
+                    Blur(*cells, grid, 0, 1, 0);
+                    Blur(*cells, grid, 0, 0, 1);
+                }
+
+                //Slice
+                std::vector<std::vector<double>> imageBuffer(height, std::vector<double>(width));
+                auto totalResidual = 0.0;
+                for(auto y = 0; y < height; ++y)
+                {
+                    for(auto x = 0; x < width; ++x)
+                    {
+                        auto gridX = x / spatialSigma + 1;
+                        auto gridY = y / spatialSigma + 1;
+                        auto gridZ = (image[y][x] - minValue) / rangeSigma + 1;
+
+                        auto weight = Interpolate(grid.Weights, grid, gridX, gridY, gridZ);
+                        imageBuffer[y][x] = weight > 0 ? Interpolate(grid.Values, grid, gridX, gridY, gridZ) / weight : image[y][x];
+                        totalResidual += std::abs(imageBuffer[y][x] - image[y][x]);
+                    }
+                    if(processedPixel != nullptr) (*processedPixel) += width;
+                }
+
+                if(!quiet_) std::cout << "Residual/pixel: "s << totalResidual / ((double)width * height) << std::endl;
+
+                //The grid is built from the whole image, the mask only selects the output
+                return RestoreOutsideMask(data, new FloatingPointImageData(width, height, imageBuffer, ImageUtility::GetGradientNormals(imageBuffer)));
+            }
+        };
+    }
+}
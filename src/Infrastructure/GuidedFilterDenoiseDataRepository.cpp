@@ -0,0 +1 @@
+#include "GuidedFilterDenoiseDataRepository.hpp"
@@ -0,0 +1,88 @@
+#pragma once
+
+#include "FloatingPointImageData.hpp"
+#include "DenoiseImageData.hpp"
+#include "ImageUtility.hpp"
+
+namespace ImageInformationAnalyzer
+{
+    namespace Infrastructure
+    {
+        using namespace Domain;
+        using namespace Misc;
+
+        //Self guided filter (He et al.): a local linear model q = a * I + b per window
+        //Only box sums, so the cost per pixel does not depend on DenoiseSetting::FilterRadius
+        class GuidedFilterDenoiseDataRepository : public IDenoiseImageDataRepository
+        {
+        public:
+            explicit GuidedFilterDenoiseDataRepository(const DenoiseSetting& setting = DenoiseSetting()) : IDenoiseImageDataRepository(setting)
+            {
+            }
+            virtual ~GuidedFilterDenoiseDataRepository() = default;
+
+            //The coefficients are box means themselves
+            virtual int GetWindowRadius() const override
+            {
+                return 2 * std::max(setting_.FilterRadius, 1);
+            }
+
+            virtual FloatingPointImageData* Process(const FloatingPointImageData* data, std::atomic<int>* processedPixel = nullptr) override
+            {
+                auto width = data->Width;
+                auto height = data->Height;
+                const auto radius = std::max(setting_.FilterRadius, 1);
+                const auto count = (double)(2 * radius + 1) * (2 * radius + 1);
+                const auto epsilon = setting_.GuidedFilterEpsilon;
+
+                const auto& image = data->ImageBuffer;
+                std::vector<std::vector<double>> squared(height, std::vector<double>(width));
+                for(auto y = 0; y < height; ++y)
+                {
+                    for(auto x = 0; x < width; ++x)
+                    {
+                        squared[y][x] = image[y][x] * image[y][x];
+                    }
+                }
+
+                auto meanI = ImageUtility::BoxSum(image, radius);
+                auto meanII = ImageUtility::BoxSum(squared, radius);
+
+                //a, b of each window (reuses the buffers)
+                auto& a = meanII;
+                auto& b = meanI;
+                for(auto y = 0; y < height; ++y)
+                {
+                    for(auto x = 0; x < width; ++x)
+                    {
+                        auto mean = meanI[y][x] / count;
+                        auto variance = std::max(meanII[y][x] / count - mean * mean, 0.0);
+                        a[y][x] = variance / (variance + epsilon);
+                        b[y][x] = mean - a[y][x] * mean;
+                    }
+                }
+
+                //Every pixel is covered by (2r+1)^2 windows
+                auto meanA = ImageUtility::BoxSum(a, radius);
+                auto meanB = ImageUtility::BoxSum(b, radius);
+
+                std::vector<std::vector<double>> imageBuffer(height, std::vector<double>(width));
+                auto totalResidual = 0.0;
+                for(auto y = 0; y < height; ++y)
+                {
+                    for(auto x = 0; x < width; ++x)
+                    {
+                        imageBuffer[y][x] = meanA[y][x] / count * image[y][x] + meanB[y][x] / count;
+                        totalResidual += std::abs(imageBuffer[y][x] - image[y][x]);
+                    }
+                    if(processedPixel != nullptr) (*processedPixel) += width;
+                }
+
+                if(!quiet_) std::cout << "Residual/pixel: "s << totalResidual / ((double)width * height) << std::endl;
+
+                //Box sums cost the same for any region, so the mask only selects the output
+                return RestoreOutsideMask(data, new FloatingPointImageData(width, height, imageBuffer, ImageUtility::GetGradientNormals(imageBuffer)));
+            }
+        };
+    }
+}
@@ -3,6 +3,7 @@
 #include "FloatingPointImageData.hpp"
 #include "EllipseDenoiseDataRepository.hpp"
 
+#include <cassert>
 #include <tuple>
 
 namespace ImageInformationAnalyzer
@@ -11,8 +12,10 @@ namespace ImageInformationAnalyzer
     {
         using namespace Domain;
 
-        class HyperEllipseDenoiseDataRepository : public EllipseDenoiseDataRepository
+        class HyperEllipseDenoiseDataRepository : public EllipseDenoiseDataRepositoryBase<HyperEllipseDenoiseDataRepository>
         {
+            friend class EllipseDenoiseDataRepositoryBase<HyperEllipseDenoiseDataRepository>;
+
         protected:
             inline Eigen::Matrix<double, 7, 7> GetOperatorS(Eigen::Matrix<double, 7, 7>& mat)
             {
@@ -29,28 +32,57 @@ namespace ImageInformationAnalyzer
                 return GetOperatorS(A);
             }
 
+            inline Eigen::Matrix<double, 7, 7> GetOperatorSMatrix(Eigen::Matrix<double, 7, 1>& zeta)
+            {
+                return GetOperatorSeZeta(zeta);
+            }
+
             //対称行列に対するランク6の逆行列
-            inline Eigen::Matrix<double, 7, 7> CalcMi6(const Eigen::Matrix<double, 7, 7>& M)
+            //The smallest eigenvector of M is close to theta, so it seeds the inverse iteration
+            inline Eigen::Matrix<double, 7, 7> CalcMi6(const Eigen::Matrix<double, 7, 7>& M, const Eigen::Matrix<double, 7, 1>& theta)
             {
-                // Eigen Solver for Self Adjoint Matrix
-                Eigen::SelfAdjointEigenSolver<Eigen::Matrix<double, 7, 7>> GES(M);
+                return MatrixUtility::GetTruncatedInverse<7>(M, theta);
+            }
 
-                Eigen::Matrix<double, 7, 7> Mi = Eigen::Matrix<double, 7, 7>().Zero();
-                for(int i = 1; i < 7; i++)
-                {
-                    //対称行列なのでこの性質が適用できる = 固有ベクトルで逆行列作成
-                    Mi += GES.eigenvectors().col(i) * GES.eigenvectors().col(i).transpose() / GES.eigenvalues()(i);
-                }
-                return Mi;
+            //V0 * v with the non-zero elements of V0 only (19 of 49), see GetVariance0()
+            static inline Eigen::Matrix<double, 7, 1> MultiplyVariance0(const ImagePointEllipse& point, const Eigen::Matrix<double, 7, 1>& v, const double f0)
+            {
+                const double x = point.OffsetX;
+                const double y = point.OffsetY;
+
+                Eigen::Matrix<double, 7, 1> result;
+                result <<
+                    x * x * v(0) + x * y * v(1) + f0 * x * v(3),
+                    x * y * v(0) + (x * x + y * y) * v(1) + x * y * v(2) + f0 * y * v(3) + f0 * x * v(4),
+                    x * y * v(1) + y * y * v(2) + f0 * y * v(4),
+                    f0 * x * v(0) + f0 * y * v(1) + f0 * f0 * v(3),
+                    f0 * x * v(1) + f0 * y * v(2) + f0 * f0 * v(4),
+                    0,
+                    f0 * f0 * v(6);
+                return 4 * result;
             }
 
-            virtual bool Renormalize(Eigen::Matrix<double, 7, 1>& theta0, const std::vector<ImagePointEllipse>& windowPoints) override
+            //sum(c_i * V0_i): the elements of V0 are x^2, xy, y^2, x, y and constants,
+            //so the sum is the V0 of the weighted moments sum(c_i * x_i^2), ..., sum(c_i)
+            static inline Eigen::Matrix<double, 7, 7> GetVariance0Sum(const double xx, const double xy, const double yy, const double x, const double y, const double one, const double f0)
+            {
+                Eigen::Matrix<double, 7, 7> mat;
+
+                mat <<
+                    xx, xy, 0, f0 * x, 0, 0, 0,
+                    xy, xx + yy, xy, f0 * y, f0 * x, 0, 0,
+                    0, xy, yy, 0, f0 * y, 0, 0,
+                    f0 * x, f0 * y, 0, f0 * f0 * one, 0, 0, 0,
+                    0, f0 * x, f0 * y, 0, f0 * f0 * one, 0, 0,
+                    0, 0, 0, 0, 0, 0, 0,
+                    0, 0, 0, 0, 0, 0, f0 * f0 * one;
+
+                return 4 * mat;
+            }
+
+            inline bool Renormalize(Eigen::Matrix<double, 7, 1>& theta0, const std::vector<ImagePointEllipse>& windowPoints, const bool secondTier)
             { 
-                std::vector<double> Ws;
-                for(auto i = 0; i < windowPoints.size(); i++)
-                {
-                    Ws.push_back(1.0);//1.0で初期化
-                }
+                auto Ws = GetInitialWeights(theta0, windowPoints);
 
                 std::vector<Eigen::Matrix<double, 7, 7>> coeffNs;
 
@@ -60,7 +92,9 @@ namespace ImageInformationAnalyzer
                     coeffNs.push_back(coeffN);
                 }
 
-                for(auto loop = 0; loop < MAX_LOOP; loop++)
+                const double f0 = WINDOW_SIZE;
+                const auto maxLoop = GetMaxLoop(secondTier);
+                for(auto loop = 0; loop < maxLoop; loop++)
                 {
                     //Mの算出
                     Eigen::Matrix<double, 7, 7> M = Eigen::Matrix<double, 7, 7>().Zero();
@@ -71,18 +105,53 @@ namespace ImageInformationAnalyzer
                     M = M / windowPoints.size();
 
                     //Miの算出
-                    auto Mi = CalcMi6(M);
+                    auto Mi = CalcMi6(M, theta0);
 
                     //Nの算出
                     Eigen::Matrix<double, 7, 7> N1 = Eigen::Matrix<double, 7, 7>().Zero();
                     Eigen::Matrix<double, 7, 7> N2 = Eigen::Matrix<double, 7, 7>().Zero();
+                    //Weighted moments of the (zeta, Mi * zeta) * V0 terms
+                    auto momentXX = 0.0;
+                    auto momentXY = 0.0;
+                    auto momentYY = 0.0;
+                    auto momentX = 0.0;
+                    auto momentY = 0.0;
+                    auto moment1 = 0.0;
+                #ifdef _DEBUG
+                    //Reference: the dense products of the original formulation
+                    Eigen::Matrix<double, 7, 7> referenceN2 = Eigen::Matrix<double, 7, 7>().Zero();
+                #endif
                     for(auto i = 0; i < windowPoints.size(); i++)
                     {
                         N1 += Ws[i] * coeffNs[i];
 
+                        //ZetaMatrix = zeta * zeta^t, so V0 * Mi * ZetaMatrix = p * zeta^t with p = V0 * Mi * zeta
+                        //and 2S[p * zeta^t] = p * zeta^t + zeta * p^t: matrix-vector products only
+                        const auto& zeta = windowPoints[i].ZetaVector;
+                        Eigen::Matrix<double, 7, 1> Mizeta = Mi * zeta;
+                        Eigen::Matrix<double, 7, 1> p = MultiplyVariance0(windowPoints[i], Mizeta, f0);
+                        const auto weight = Ws[i] * Ws[i];
+                        N2 += weight * (p * zeta.transpose() + zeta * p.transpose());
+
+                        const double x = windowPoints[i].OffsetX;
+                        const double y = windowPoints[i].OffsetY;
+                        const auto c = weight * zeta.dot(Mizeta);
+                        momentXX += c * x * x;
+                        momentXY += c * x * y;
+                        momentYY += c * y * y;
+                        momentX += c * x;
+                        momentY += c * y;
+                        moment1 += c;
+
+                    #ifdef _DEBUG
                         Eigen::Matrix<double, 7, 7> tmpMat = windowPoints[i].Variance0Matrix * Mi * windowPoints[i].ZetaMatrix;
-                        N2 += Ws[i] * Ws[i] * (windowPoints[i].ZetaVector.transpose() * Mi * windowPoints[i].ZetaVector * windowPoints[i].Variance0Matrix + 2 * GetOperatorS(tmpMat));
+                        referenceN2 += Ws[i] * Ws[i] * (windowPoints[i].ZetaVector.transpose() * Mi * windowPoints[i].ZetaVector * windowPoints[i].Variance0Matrix + 2 * GetOperatorS(tmpMat));
+                    #endif
                     }
+                    N2 += GetVariance0Sum(momentXX, momentXY, momentYY, momentX, momentY, moment1, f0);
+                #ifdef _DEBUG
+                    assert((N2 - referenceN2).norm() <= 1e-9 * std::max(referenceN2.norm(), 1.0));
+                #endif
                     N1 = N1 / windowPoints.size();
                     N2 = N2 / (windowPoints.size() * windowPoints.size());
 
@@ -92,13 +161,11 @@ namespace ImageInformationAnalyzer
                     //なのでNとMが逆になる
 
                     //一般固有値を解く
-                    Eigen::GeneralizedSelfAdjointEigenSolver<Eigen::Matrix<double, 7, 7>> GES(N, M);
-
                     //最大固有値
-                    Eigen::Matrix<double, 7, 1> theta = GES.eigenvectors().col(6).normalized();
+                    Eigen::Matrix<double, 7, 1> theta = MatrixUtility::GetLargestGeneralizedEigenvector<7>(N, M, theta0);
 
                     //終了チェック
-                    auto distance = GetVectorDistance(theta0, theta);
+                    auto distance = secondTier ? GetDirectionDistance(theta0, theta) : GetVectorDistance(theta0, theta);
                     if(distance <= ERROR_THRESHOLD)
                     {
                         theta0 = theta;
@@ -113,7 +180,7 @@ namespace ImageInformationAnalyzer
                     }
                     theta0 = theta;
 
-                    if(loop == MAX_LOOP - 1)
+                    if(loop == maxLoop - 1)
                     {
                         //std::cout << "detected max loop!: "s << distance << std::endl;
                         return false;
@@ -124,82 +191,11 @@ namespace ImageInformationAnalyzer
             }
 
         public:
-            explicit HyperEllipseDenoiseDataRepository()
+            explicit HyperEllipseDenoiseDataRepository(const DenoiseSetting& setting = DenoiseSetting()) : EllipseDenoiseDataRepositoryBase(setting)
             {
             }
             virtual ~HyperEllipseDenoiseDataRepository() = default;
 
-        protected:
-            virtual inline bool DenoisePixel(const FloatingPointImageData* data, const int x, const int y, const int windowSize, double& denoisedPixel, Eigen::Vector3d& normal, double& fittingError) override
-            {
-                auto width = data->Width;
-                auto height = data->Height;
-
-                auto windowPoints = ImageUtility::GetWindowPoints<ImagePointEllipse>(data, x, y, windowSize);
-
-                auto f0 = windowSize;
-
-                for(auto i = 0; i < windowPoints.size(); ++i)
-                {
-                    windowPoints[i].ZetaVector = GetZetaVector(windowPoints[i].OffsetX, windowPoints[i].OffsetY, windowPoints[i].Value, f0);
-                    windowPoints[i].ZetaMatrix = GetZetaMatrix(windowPoints[i].OffsetX, windowPoints[i].OffsetY, windowPoints[i].Value, f0);
-                    windowPoints[i].Variance0Matrix = GetVariance0(windowPoints[i].OffsetX, windowPoints[i].OffsetY, f0);
-                    windowPoints[i].OperatorSMatrix = GetOperatorSeZeta(windowPoints[i].ZetaVector);
-                }
-
-                //最適化
-                Eigen::Matrix<double, 7, 1> theta = Eigen::Matrix<double, 7, 1>().Zero();
-                if(!Renormalize(theta, windowPoints))
-                {
-                    //計算が収束しなかった場合
-                    denoisedPixel = data->ImageBuffer[y][x];
-                    normal = Eigen::Vector3d(0, 0, 1);
-                    fittingError = 0;
-                    return false;
-                }
-
-                //z'(x,y) = (A*x^2 + B*2xy + C*y^2 + D*2f0x + E*2f0y + F * f0^2) / (G * 2f0)
-                //z'(0,0) = F * f0^2 / (G * 2f0) = F * f0 / (2*G)
-
-                auto A = theta(0);
-                auto B = theta(1);
-                auto C = theta(2);
-                auto D = theta(3);
-                auto E = theta(4);
-                auto F = theta(5);
-                auto G = theta(6);
-
-                //ノイズ除去済み値
-                denoisedPixel = F * f0 / (2 * G);
-
-                //観測値と推測値の差の合計
-                fittingError = 0;
-                for(auto i = 0; i < windowPoints.size(); i++)
-                {
-                    auto observedValue = (double)windowPoints[i].Value;
-                    auto estimatedValue =
-                        (A * windowPoints[i].OffsetX * windowPoints[i].OffsetX
-                            + B * windowPoints[i].OffsetX * windowPoints[i].OffsetY
-                            + C * windowPoints[i].OffsetY * windowPoints[i].OffsetY
-                            + D * 2 * f0 * windowPoints[i].OffsetX
-                            + E * 2 * f0 * windowPoints[i].OffsetY
-                            + F * f0 * f0) / (G * 2 * f0);
-                    fittingError += std::abs(ImageUtility::DoubleSub(observedValue, estimatedValue));
-                }
-
-                //dz'/dx = (2Ax + 2By + 2Df0) / (G * 2f0)
-                //dz'/dx(0,0) = D / G
-
-                //dz'/dy = (2Bx + 2Cy + 2Ef0) / (G * 2f0)
-                //dz'/dy(0,0) = E / G
-
-                //法線ベクトル
-                auto dzdx = D / G;
-                auto dzdy = E / G;
-                normal = Eigen::Vector3d(-dzdx, -dzdy, 1).normalized();
-
-                return true;
-            }
         };
     }
 }
\ No newline at end of file
@@ -0,0 +1 @@
+#include "MappedFileTileStorageDataRepository.hpp"
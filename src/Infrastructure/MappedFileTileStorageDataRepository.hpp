@@ -0,0 +1,253 @@
+#pragma once
+
+#include "TiledImageData.hpp"
+
+#ifdef _WIN32
+#ifndef NOMINMAX
+#define NOMINMAX//std::min / std::max
+#endif
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+#include <atomic>
+#include <cstring>
+#include <filesystem>
+#include <list>
+#include <map>
+#include <mutex>
+#include <stdexcept>
+#include <string>
+
+namespace ImageInformationAnalyzer
+{
+    namespace Infrastructure
+    {
+        using namespace Domain;
+        using namespace std::literals::string_literals;
+
+        //Each space is a scratch file that is removed when it is closed
+        //The files are mapped view by view, the least recently used views are unmapped when the mapped bytes exceed the budget
+        //An unmapped view is written back by the OS and read again on the next access
+        class MappedFileTileStorageDataRepository : public ITileStorageDataRepository
+        {
+            enum
+            {
+                //Multiple of the page size and of the allocation granularity of Windows (64KB)
+                VIEW_SIZE = 4 * 1024 * 1024
+            };
+
+            struct Space
+            {
+            #ifdef _WIN32
+                HANDLE File;
+                HANDLE Mapping;
+            #else
+                int File;
+            #endif
+                size_t Bytes;
+            };
+
+            struct View
+            {
+                int Id;
+                size_t Index;
+                char* Data;
+                size_t Bytes;
+            };
+
+            const size_t budget_;
+            const std::string directory_;
+
+            std::map<int, Space> spaces_;
+            int nextId_;
+
+            //Most recently used first
+            std::list<View> views_;
+            std::map<std::pair<int, size_t>, std::list<View>::iterator> viewIndices_;
+            size_t residentBytes_;
+            size_t peakResidentBytes_;
+
+            mutable std::mutex mutex_;
+
+            inline void Unmap(const View& view)
+            {
+            #ifdef _WIN32
+                UnmapViewOfFile(view.Data);
+            #else
+                munmap(view.Data, view.Bytes);
+            #endif
+                residentBytes_ -= view.Bytes;
+            }
+
+            //View index of space id, mapped if needed
+            char* GetView(const int id, const size_t index)
+            {
+                auto found = viewIndices_.find({ id, index });
+                if(found != viewIndices_.end())
+                {
+                    views_.splice(views_.begin(), views_, found->second);
+                    return found->second->Data;
+                }
+
+                const auto& space = spaces_.at(id);
+                const auto offset = index * VIEW_SIZE;
+                const auto bytes = std::min((size_t)VIEW_SIZE, space.Bytes - offset);
+
+                //Evict, the view in use is at least one
+                while(!views_.empty() && residentBytes_ + bytes > budget_)
+                {
+                    Unmap(views_.back());
+                    viewIndices_.erase({ views_.back().Id, views_.back().Index });
+                    views_.pop_back();
+                }
+
+            #ifdef _WIN32
+                auto* data = (char*)MapViewOfFile(space.Mapping, FILE_MAP_ALL_ACCESS, (DWORD)((unsigned long long)offset >> 32), (DWORD)(offset & 0xFFFFFFFF), bytes);
+                if(data == nullptr) throw std::runtime_error("MapViewOfFile() failed");
+            #else
+                auto* data = (char*)mmap(nullptr, bytes, PROT_READ | PROT_WRITE, MAP_SHARED, space.File, (off_t)offset);
+                if(data == MAP_FAILED) throw std::runtime_error("mmap() failed");
+            #endif
+
+                views_.push_front({ id, index, data, bytes });
+                viewIndices_[{ id, index }] = views_.begin();
+                residentBytes_ += bytes;
+                peakResidentBytes_ = std::max(peakResidentBytes_, residentBytes_);
+                return data;
+            }
+
+            //copy(pointer in the view, position in the buffer, bytes) for each view the range touches
+            template<typename Copy>
+            inline void ForEachView(const int id, const size_t offset, const size_t bytes, Copy copy)
+            {
+                std::lock_guard<std::mutex> lock(mutex_);
+
+                if(offset + bytes > spaces_.at(id).Bytes) throw std::out_of_range("range is outside of the space");
+
+                auto done = (size_t)0;
+                while(done < bytes)
+                {
+                    const auto index = (offset + done) / VIEW_SIZE;
+                    const auto viewOffset = (offset + done) % VIEW_SIZE;
+                    const auto length = std::min(bytes - done, (size_t)VIEW_SIZE - viewOffset);
+                    copy(GetView(id, index) + viewOffset, done, length);
+                    done += length;
+                }
+            }
+
+        public:
+            //budget: bytes mapped at the same time, at least one view. directory: scratch files, empty is the temporary directory
+            explicit MappedFileTileStorageDataRepository(const size_t budget, const std::string& directory = ""s)
+                : budget_(std::max(budget, (size_t)VIEW_SIZE)), directory_(directory.empty() ? std::filesystem::temp_directory_path().string() : directory), nextId_(0), residentBytes_(0), peakResidentBytes_(0)
+            {
+            }
+            virtual ~MappedFileTileStorageDataRepository()
+            {
+                while(!spaces_.empty())
+                {
+                    Release(spaces_.begin()->first);
+                }
+            }
+
+            virtual int Allocate(const size_t bytes) override
+            {
+                std::lock_guard<std::mutex> lock(mutex_);
+
+                //Unique among the processes and the instances
+                static std::atomic<int> fileCount(0);
+                auto path = (std::filesystem::path(directory_) / ("tiles_"s + std::to_string((unsigned long long)this) + "_"s + std::to_string(fileCount++) + ".scratch"s)).string();
+
+                Space space;
+                space.Bytes = bytes;
+            #ifdef _WIN32
+                path += "_"s + std::to_string(GetCurrentProcessId());
+                space.File = CreateFileA(path.c_str(), GENERIC_READ | GENERIC_WRITE, 0, nullptr, CREATE_NEW, FILE_ATTRIBUTE_TEMPORARY | FILE_FLAG_DELETE_ON_CLOSE, nullptr);
+                if(space.File == INVALID_HANDLE_VALUE) throw std::runtime_error("cannot create the scratch file: "s + path);
+
+                space.Mapping = CreateFileMappingA(space.File, nullptr, PAGE_READWRITE, (DWORD)((unsigned long long)bytes >> 32), (DWORD)(bytes & 0xFFFFFFFF), nullptr);
+                if(space.Mapping == nullptr)
+                {
+                    CloseHandle(space.File);
+                    throw std::runtime_error("cannot map the scratch file: "s + path);
+                }
+            #else
+                path += "_"s + std::to_string(getpid());
+                space.File = open(path.c_str(), O_RDWR | O_CREAT | O_EXCL, S_IRUSR | S_IWUSR);
+                if(space.File < 0) throw std::runtime_error("cannot create the scratch file: "s + path);
+
+                //Only the descriptor keeps the file, it is gone even if the process dies
+                unlink(path.c_str());
+                if(ftruncate(space.File, (off_t)bytes) != 0)
+                {
+                    close(space.File);
+                    throw std::runtime_error("cannot resize the scratch file: "s + path);
+                }
+            #endif
+
+                spaces_[nextId_] = space;
+                return nextId_++;
+            }
+
+            virtual void Release(const int id) override
+            {
+                std::lock_guard<std::mutex> lock(mutex_);
+
+                auto found = spaces_.find(id);
+                if(found == spaces_.end()) return;
+
+                for(auto view = views_.begin(); view != views_.end();)
+                {
+                    if(view->Id != id)
+                    {
+                        ++view;
+                        continue;
+                    }
+                    Unmap(*view);
+                    viewIndices_.erase({ view->Id, view->Index });
+                    view = views_.erase(view);
+                }
+
+            #ifdef _WIN32
+                CloseHandle(found->second.Mapping);
+                CloseHandle(found->second.File);
+            #else
+                close(found->second.File);
+            #endif
+                spaces_.erase(found);
+            }
+
+            virtual void Read(const int id, const size_t offset, void* destination, const size_t bytes) override
+            {
+                ForEachView(id, offset, bytes, [&](const char* view, const size_t position, const size_t length)
+                {
+                    std::memcpy((char*)destination + position, view, length);
+                });
+            }
+
+            virtual void Write(const int id, const size_t offset, const void* source, const size_t bytes) override
+            {
+                ForEachView(id, offset, bytes, [&](char* view, const size_t position, const size_t length)
+                {
+                    std::memcpy(view, (const char*)source + position, length);
+                });
+            }
+
+            virtual size_t GetResidentBytes() const override
+            {
+                std::lock_guard<std::mutex> lock(mutex_);
+                return residentBytes_;
+            }
+
+            virtual size_t GetPeakResidentBytes() const override
+            {
+                std::lock_guard<std::mutex> lock(mutex_);
+                return peakResidentBytes_;
+            }
+        };
+    }
+}
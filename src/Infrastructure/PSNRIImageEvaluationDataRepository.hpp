@@ -18,17 +18,20 @@ namespace ImageInformationAnalyzer
             {
                 auto width = data1->Width;
                 auto height = data1->Height;
+                auto pixelCount = GetPixelCount(data1);
 
                 auto mse = 0.0;
                 for(auto y = 0; y < height; ++y)
                 {
                     for(auto x = 0; x < width; ++x)
                     {
+                        if(!IsInsideMask(mask_, x, y)) continue;
+
                         auto diff = data1->ImageBuffer[y][x] - data2->ImageBuffer[y][x];
                         mse += diff * diff;
                     }
                 }
-                mse /= ((double)width * height);
+                mse /= pixelCount;
 
                 //PSNR
                 auto psnr = 10.0 * std::log10(maxValue * maxValue / mse);
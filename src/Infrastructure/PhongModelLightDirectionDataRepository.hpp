@@ -9,6 +9,10 @@
 #endif
 #include <ceres/ceres.h>
 
+#include <memory>
+#include <numeric>
+#include <thread>
+
 namespace ImageInformationAnalyzer
 {
     namespace Infrastructure
@@ -18,6 +22,7 @@ namespace ImageInformationAnalyzer
 
         class PhongModelLightDirectionDataRepository : public Domain::ILightEstimationDataRepository
         {
+        protected:
             struct CostFunctor
             {
                 explicit CostFunctor(Eigen::Vector3d point, Eigen::Vector3d normal, double skin, double value) : point_(point), normal_(normal), skin_(skin), value_(value)
@@ -85,66 +90,92 @@ namespace ImageInformationAnalyzer
             };
 
         protected:
-            inline std::vector<std::vector<double>> GetAverageImage(const int width, const int height, const FloatingPointImageData* denoisedR, const FloatingPointImageData* denoisedG, const FloatingPointImageData* denoisedB)
+            //Grayscale and normal averages in one pass
+            inline void GetAverageImageAndNormal(const int width, const int height, const FloatingPointImageData* denoisedR, const FloatingPointImageData* denoisedG, const FloatingPointImageData* denoisedB, std::vector<std::vector<double>>& imageBuffer, std::vector<std::vector<Eigen::Vector3d>>& normalBuffer)
             {
-                std::vector<std::vector<double>> imageBuffer;
                 imageBuffer.resize(height);
+                normalBuffer.resize(height);
 
-                for(auto y = 0; y < height; ++y)
+                std::vector<int> rows(height);
+                std::iota(rows.begin(), rows.end(), 0);
+                std::for_each(std::execution::par, rows.begin(), rows.end(), [&](const int y)
                 {
                     imageBuffer[y].resize(width);
+                    normalBuffer[y].resize(width);
+
+                    const auto& lineR = denoisedR->ImageBuffer[y];
+                    const auto& lineG = denoisedG->ImageBuffer[y];
+                    const auto& lineB = denoisedB->ImageBuffer[y];
+                    const auto& normalLineR = denoisedR->NormalBuffer[y];
+                    const auto& normalLineG = denoisedG->NormalBuffer[y];
+                    const auto& normalLineB = denoisedB->NormalBuffer[y];
+
                     for(auto x = 0; x < width; ++x)
                     {
-                        auto r = denoisedR->ImageBuffer[y][x];
-                        auto g = denoisedG->ImageBuffer[y][x];
-                        auto b = denoisedB->ImageBuffer[y][x];
-
                         //ITU-R Rec BT.601
-                        imageBuffer[y][x] = 0.299 * r + 0.587 * g + 0.114 * b;
+                        imageBuffer[y][x] = 0.299 * lineR[x] + 0.587 * lineG[x] + 0.114 * lineB[x];
+
+                        //average
+                        normalBuffer[y][x] = (normalLineR[x] + normalLineG[x] + normalLineB[x]).normalized();
                     }
-                }
-                return imageBuffer;
+                });
             }
 
-            inline std::vector<std::vector<Eigen::Vector3d>> GetAverageNormal(const int width, const int height, const FloatingPointImageData* denoisedR, const FloatingPointImageData* denoisedG, const FloatingPointImageData* denoisedB)
-            {
-                std::vector<std::vector<Eigen::Vector3d>> normalBuffer;
-                normalBuffer.resize(height);
+            const LightEstimationSetting setting_;
 
-                for(auto y = 0; y < height; ++y)
-                {
-                    normalBuffer[y].resize(width);
-                    for(auto x = 0; x < width; ++x)
-                    {
-                        auto r = denoisedR->NormalBuffer[y][x];
-                        auto g = denoisedG->NormalBuffer[y][x];
-                        auto b = denoisedB->NormalBuffer[y][x];
+            //LightEstimationSetting::WarmStart: solution of the previous Process()
+            Eigen::Vector2d previousLight_;
+            Eigen::Vector2d previousCoef_;
+            bool hasPrevious_;
+            //Set while Process() starts from the previous solution
+            bool warm_;
 
-                        //average
-                        normalBuffer[y][x] = (r + g + b).normalized();
-                    }
-                }
-                return normalBuffer;
+            //The previous solution is already in the basin
+            inline int GetStartCount() const
+            {
+                return warm_ ? 1 : setting_.MultiStartCount;
             }
 
+            //Concurrent starts share progress: each start counts its own iterations, progress is their mean
             class Callback : public ceres::IterationCallback
             {
                 std::atomic<double>* progress_;
+                std::vector<std::atomic<int>>& iterations_;
+                const int index_;
             public:
-                explicit Callback(std::atomic<double>* progress) : progress_(progress)
+                explicit Callback(std::atomic<double>* progress, std::vector<std::atomic<int>>& iterations, const int index) : progress_(progress), iterations_(iterations), index_(index)
                 {
 
                 }
                 virtual ~Callback() = default;
                 virtual ceres::CallbackReturnType operator()(const  ceres::IterationSummary& summary) override
                 {
-                    if(progress_ != nullptr) *progress_ = summary.iteration / (double)MaxIteration;
+                    iterations_[index_] = summary.iteration;
+                    Report(progress_, iterations_);
                     return ceres::CallbackReturnType::SOLVER_CONTINUE;
                 }
+
+                //Never goes back within a Solve(), two starts may report out of order
+                static inline void Report(std::atomic<double>* progress, const std::vector<std::atomic<int>>& iterations)
+                {
+                    if(progress == nullptr) return;
+
+                    auto total = 0.0;
+                    for(const auto& iteration : iterations)
+                    {
+                        total += iteration;
+                    }
+                    const auto mean = total / (iterations.size() * (double)MaxIteration);
+
+                    auto current = progress->load();
+                    while(current < mean && !progress->compare_exchange_weak(current, mean));
+                }
             };
 
         public:
-            explicit PhongModelLightDirectionDataRepository() = default;
+            explicit PhongModelLightDirectionDataRepository(const LightEstimationSetting& setting = LightEstimationSetting()) : setting_(setting), previousLight_(0, 0), previousCoef_(0, 0), hasPrevious_(false), warm_(false)
+            {
+            }
             virtual ~PhongModelLightDirectionDataRepository() = default;
 
             constexpr static int MaxIteration = 100;
@@ -156,44 +187,122 @@ namespace ImageInformationAnalyzer
             {
                 auto width = denoisedR->Width;
                 auto height = denoisedR->Height;
+                if(mask_ != nullptr && (mask_->Width != width || mask_->Height != height)) throw std::invalid_argument("mask must have the same size as the image");
+                if(mask_ != nullptr && mask_->GetPixelCount() == 0) throw std::invalid_argument("mask must not be empty");
 
                 //average = grayscale
-                auto averageImageBuffer = GetAverageImage(width, height, denoisedR, denoisedG, denoisedB);
-                auto averageNormalBuffer = GetAverageNormal(width, height, denoisedR, denoisedG, denoisedB);
-
-                //output data
-                std::vector < std::vector <double>> imageBuffer;
-                imageBuffer.resize(height);
-                for(auto y = 0; y < height; ++y)
-                {
-                    imageBuffer[y].resize(width);
-                }
+                std::vector<std::vector<double>> averageImageBuffer;
+                std::vector<std::vector<Eigen::Vector3d>> averageNormalBuffer;
+                GetAverageImageAndNormal(width, height, denoisedR, denoisedG, denoisedB, averageImageBuffer, averageNormalBuffer);
 
                 //最適化されるパラメータ
                 Eigen::Vector2d resultLight(0, 0);
                 Eigen::Vector2d resultCoef(0, 0);
 
+                warm_ = setting_.WarmStart && hasPrevious_;
+                if(warm_)
+                {
+                    resultLight = previousLight_;
+                    resultCoef = previousCoef_;
+                }
+
+                EstimateParameters(width, height, averageImageBuffer, averageNormalBuffer, differentialB_G, pixelPitch, resultLight, resultCoef, progress);
+
+                previousLight_ = resultLight;
+                previousCoef_ = resultCoef;
+                hasPrevious_ = true;
+
+                //output data
+                auto imageBuffer = ReconstructSurface(width, height, averageImageBuffer, averageNormalBuffer, pixelPitch, resultLight, resultCoef);
+
+                return new FloatingPointImageData(width, height, imageBuffer, averageNormalBuffer);
+            }
+
+        protected:
+            constexpr static double LossScale = 0.2;
+
+            inline Eigen::Vector3d GetPosition(const int x, const int y, const int width, const int height, const double pixelPitch) const
+            {
+                return Eigen::Vector3d((x - width / 2.0) * pixelPitch, (y - height / 2.0) * pixelPitch, 0);
+            }
+
+            inline Point3D GetPoint(const int x, const int y, const int width, const int height, const std::vector<std::vector<double>>& averageImageBuffer, const std::vector<std::vector<Eigen::Vector3d>>& averageNormalBuffer, const std::vector<std::vector<double>>& differentialBuffer, const double pixelPitch) const
+            {
+                Point3D d;
+                d.Position = GetPosition(x, y, width, height, pixelPitch);
+                d.Normal = Eigen::Vector3d(averageNormalBuffer[y][x].x(), averageNormalBuffer[y][x].y(), averageNormalBuffer[y][x].z());
+                d.GrayscaleValue = averageImageBuffer[y][x];
+                d.SurfaceValue = differentialBuffer[y][x];
+                return d;
+            }
+
+            //Pixels inside of the mask only, nullptr is the whole image
+            inline std::vector<Point3D> GetPoints(const int width, const int height, const std::vector<std::vector<double>>& averageImageBuffer, const std::vector<std::vector<Eigen::Vector3d>>& averageNormalBuffer, const std::vector<std::vector<double>>& differentialBuffer, const double pixelPitch, const MaskData* mask) const
+            {
+                if(mask != nullptr)
+                {
+                    std::vector<Point3D> data;
+                    data.reserve(mask->GetPixelCount());
+                    for(auto y = 0; y < height; ++y)
+                    {
+                        for(auto x = 0; x < width; ++x)
+                        {
+                            if(mask->IsInside(x, y)) data.push_back(GetPoint(x, y, width, height, averageImageBuffer, averageNormalBuffer, differentialBuffer, pixelPitch));
+                        }
+                    }
+                    return data;
+                }
+
                 //情報取り出し
-                std::vector<Point3D> data;
-                for(auto y = 0; y < height; ++y)
+                std::vector<Point3D> data((size_t)width * height);
+
+                std::vector<int> rows(height);
+                std::iota(rows.begin(), rows.end(), 0);
+                std::for_each(std::execution::par, rows.begin(), rows.end(), [&](const int y)
                 {
                     for(auto x = 0; x < width; ++x)
                     {
-                        Point3D d;
-                        d.Position = Eigen::Vector3d((x - width / 2.0) * pixelPitch, (x - height / 2.0) * pixelPitch, 0);
-                        d.Normal = Eigen::Vector3d(averageNormalBuffer[y][x].x(), averageNormalBuffer[y][x].y(), averageNormalBuffer[y][x].z());
-                        d.GrayscaleValue = averageImageBuffer[y][x];
-                        d.SurfaceValue = differentialB_G->ImageBuffer[y][x];
-                        data.push_back(d);
+                        data[(size_t)y * width + x] = GetPoint(x, y, width, height, averageImageBuffer, averageNormalBuffer, differentialBuffer, pixelPitch);
+                    }
+                });
+                return data;
+            }
+
+            //Light directions to start from: the given one and a coarse grid over the light hemisphere
+            static inline std::vector<Eigen::Vector2d> GetStartLights(const Eigen::Vector2d& light, const int startCount)
+            {
+                std::vector<Eigen::Vector2d> lights;
+                lights.push_back(light);
+
+                const auto gridCount = startCount - 1;
+                if(gridCount <= 0) return lights;
+
+                const auto ringCount = std::min((gridCount + 7) / 8, 3);
+                const auto ringPointCount = (gridCount + ringCount - 1) / ringCount;
+                for(auto ring = 0; ring < ringCount; ++ring)
+                {
+                    auto theta = (ring + 1) * (M_PI / 2) / (ringCount + 1);
+                    for(auto i = 0; i < ringPointCount && lights.size() < startCount; ++i)
+                    {
+                        auto phi = -M_PI + (i + 0.5) * 2 * M_PI / ringPointCount;
+                        lights.push_back(Eigen::Vector2d(theta, phi));
                     }
                 }
+                return lights;
+            }
+
+            ceres::Solver::Summary SolveFrom(const std::vector<std::unique_ptr<ceres::CostFunction>>& costFunctions, ceres::LossFunction* lossFunction, Eigen::Vector2d& resultLight, Eigen::Vector2d& resultCoef, const int threadCount, Callback& callback)
+            {
+                //Cost functions are shared between the starts
+                ceres::Problem::Options problemOptions;
+                problemOptions.cost_function_ownership = ceres::DO_NOT_TAKE_OWNERSHIP;
+                problemOptions.loss_function_ownership = ceres::DO_NOT_TAKE_OWNERSHIP;
 
                 //情報挿入
-                ceres::Problem problem;
-                for(auto d : data)
+                ceres::Problem problem(problemOptions);
+                for(const auto& f : costFunctions)
                 {
-                    auto f = new ceres::AutoDiffCostFunction<CostFunctor, 1, 2, 2>(new CostFunctor(d.Position, d.Normal, d.SurfaceValue, d.GrayscaleValue));
-                    problem.AddResidualBlock(f, new ceres::CauchyLoss(0.2), resultLight.data(), resultCoef.data());
+                    problem.AddResidualBlock(f.get(), lossFunction, resultLight.data(), resultCoef.data());
                 }
 
                 //Upper and lower
@@ -208,19 +317,102 @@ namespace ImageInformationAnalyzer
                 problem.SetParameterLowerBound(resultCoef.data(), 1, -M_PI);
                 problem.SetParameterUpperBound(resultCoef.data(), 1, M_PI);
 
-                //Callback
-                Callback callback(progress);
-
                 //Solve
                 ceres::Solver::Options options;
                 //options.minimizer_progress_to_stdout = true;
                 options.function_tolerance = 1e-6;//default
                 options.max_num_iterations = MaxIteration;//Changed from 50
+                options.num_threads = threadCount;
                 options.update_state_every_iteration = true;
                 options.callbacks.push_back(&callback);
                 ceres::Solver::Summary summary;
                 ceres::Solve(options, &problem, &summary);
 
+                return summary;
+            }
+
+            //Fit the model to the points, starting from the given parameters
+            //With startCount > 1, the starts run concurrently and the lowest final cost wins
+            ceres::Solver::Summary Solve(const std::vector<Point3D>& data, Eigen::Vector2d& resultLight, Eigen::Vector2d& resultCoef, std::atomic<double>* progress, const int startCount = 1)
+            {
+                std::vector<std::unique_ptr<ceres::CostFunction>> costFunctions;
+                costFunctions.reserve(data.size());
+                for(const auto& d : data)
+                {
+                    costFunctions.emplace_back(new ceres::AutoDiffCostFunction<CostFunctor, 1, 2, 2>(new CostFunctor(d.Position, d.Normal, d.SurfaceValue, d.GrayscaleValue)));
+                }
+                ceres::CauchyLoss lossFunction(LossScale);
+
+                auto lights = GetStartLights(resultLight, startCount);
+                std::vector<Eigen::Vector2d> coefs(lights.size(), resultCoef);
+                std::vector<ceres::Solver::Summary> summaries(lights.size());
+
+                //Share the cores between the starts
+                const auto threadCount = std::max(1, (int)std::thread::hardware_concurrency() / (int)lights.size());
+
+                //A finished start counts as MaxIteration, so that the progress reaches 100% with the last one
+                std::vector<std::atomic<int>> iterations(lights.size());
+                for(auto& iteration : iterations)
+                {
+                    iteration = 0;
+                }
+                if(progress != nullptr) *progress = 0.0;
+
+                std::vector<int> startIndices(lights.size());
+                std::iota(startIndices.begin(), startIndices.end(), 0);
+                std::for_each(std::execution::par, startIndices.begin(), startIndices.end(), [&](const int index)
+                {
+                    Callback callback(progress, iterations, index);
+                    summaries[index] = SolveFrom(costFunctions, &lossFunction, lights[index], coefs[index], threadCount, callback);
+
+                    iterations[index] = MaxIteration;
+                    Callback::Report(progress, iterations);
+                });
+
+                auto best = 0;
+                for(auto i = 1; i < summaries.size(); ++i)
+                {
+                    if(summaries[i].final_cost < summaries[best].final_cost) best = i;
+                }
+                if(lights.size() > 1)
+                {
+                    std::cout << "Multi-start: best "s << best << "/"s << lights.size() << ", cost: "s << summaries[best].final_cost << std::endl;
+                }
+
+                resultLight = lights[best];
+                resultCoef = coefs[best];
+                return summaries[best];
+            }
+
+            //Same cost as the ceres problem (Cauchy loss), evaluated without building one
+            inline double EvaluateCost(const std::vector<Point3D>& data, const Eigen::Vector2d& light, const Eigen::Vector2d& coef) const
+            {
+                const auto scale2 = LossScale * LossScale;
+
+                return std::transform_reduce(std::execution::par, data.begin(), data.end(), 0.0, std::plus<double>(), [&](const Point3D& d)
+                {
+                    double residual = 0.0;
+                    CostFunctor(d.Position, d.Normal, d.SurfaceValue, d.GrayscaleValue)(light.data(), coef.data(), &residual);
+                    return 0.5 * scale2 * std::log1p(residual * residual / scale2);
+                });
+            }
+
+            //Whole pixel fit
+            virtual void EstimateParameters(const int width, const int height, const std::vector<std::vector<double>>& averageImageBuffer, const std::vector<std::vector<Eigen::Vector3d>>& averageNormalBuffer, const FloatingPointImageData* differentialB_G, const double pixelPitch, Eigen::Vector2d& resultLight, Eigen::Vector2d& resultCoef, std::atomic<double>* progress)
+            {
+                auto data = GetPoints(width, height, averageImageBuffer, averageNormalBuffer, differentialB_G->ImageBuffer, pixelPitch, mask_);
+                Solve(data, resultLight, resultCoef, progress, GetStartCount());
+            }
+
+            inline std::vector<std::vector<double>> ReconstructSurface(const int width, const int height, const std::vector<std::vector<double>>& averageImageBuffer, const std::vector<std::vector<Eigen::Vector3d>>& averageNormalBuffer, const double pixelPitch, const Eigen::Vector2d& resultLight, const Eigen::Vector2d& resultCoef)
+            {
+                std::vector < std::vector <double>> imageBuffer;
+                imageBuffer.resize(height);
+                for(auto y = 0; y < height; ++y)
+                {
+                    imageBuffer[y].resize(width);
+                }
+
                 //光源
                 Eigen::Vector3d lightPoint;
                 {
@@ -239,37 +431,72 @@ namespace ImageInformationAnalyzer
                     //std::cout << "Coefs: \n" << coefs << "\n--------" << std::endl;
                 }
 
+                //Loop invariants of the reconstruction
+                const auto eyeLength = EyeLength;
+                const auto coefDiffuse = coefs.x();
+                const auto coefSpecular = coefs.y();
+                const auto coefSkin = coefs.z();
+
                 //パラメータから復元
-                for(auto y = 0; y < height; ++y)
+                std::vector<int> rows(height);
+                std::iota(rows.begin(), rows.end(), 0);
+                std::for_each(std::execution::par, rows.begin(), rows.end(), [&](const int y)
                 {
+                    const auto* grayscaleLine = averageImageBuffer[y].data();
+                    const auto* normalLine = averageNormalBuffer[y].data();
+                    auto* outputLine = imageBuffer[y].data();
+
+                    //Same position as GetPosition(), on plain doubles so that the loop vectorizes
+                    const auto py = (y - height / 2.0) * pixelPitch;
+
+                    #pragma omp simd
                     for(auto x = 0; x < width; ++x)
                     {
-                        auto point = Eigen::Vector3d((x - width / 2.0) * pixelPitch, (x - height / 2.0) * pixelPitch, 0);
-                        auto normal = Eigen::Vector3d(averageNormalBuffer[y][x].x(), averageNormalBuffer[y][x].y(), averageNormalBuffer[y][x].z());
-                        auto grayscaleValue = averageImageBuffer[y][x];
+                        const auto px = (x - width / 2.0) * pixelPitch;
+
+                        const auto nx = normalLine[x].x();
+                        const auto ny = normalLine[x].y();
+                        const auto nz = normalLine[x].z();
 
                         //光源
-                        Eigen::Vector3d lightDir = lightPoint - point;
-                        lightDir.normalize();
+                        auto lx = lightPoint.x() - px;
+                        auto ly = lightPoint.y() - py;
+                        auto lz = lightPoint.z();
+                        const auto inverseLength = 1.0 / std::sqrt(lx * lx + ly * ly + lz * lz);
+                        lx *= inverseLength;
+                        ly *= inverseLength;
+                        lz *= inverseLength;
 
                         //視点ベクトル
-                        Eigen::Vector3d eyePoint(0, 0, EyeLength);
-                        auto eyeDir = eyePoint - point;
+                        const auto ex = -px;
+                        const auto ey = -py;
+                        const auto ez = eyeLength;
 
                         //反射ベクトル
-                        auto refDir = -eyeDir + (2.0) * normal.dot(eyeDir) * normal;
+                        const auto normalDotEye = 2.0 * (nx * ex + ny * ey + nz * ez);
+                        const auto rx = -ex + normalDotEye * nx;
+                        const auto ry = -ey + normalDotEye * ny;
+                        const auto rz = -ez + normalDotEye * nz;
 
                         //拡散反射と鏡面反射
-                        auto diffuse = normal.dot(lightDir);
-                        auto specular = pow(lightDir.dot(refDir), SpecularPower);
+                        const auto diffuse = nx * lx + ny * ly + nz * lz;
+                        const auto specularBase = lx * rx + ly * ry + lz * rz;
+                        auto specular = 0.0;
+                        if constexpr(SpecularPower == 3.0)
+                        {
+                            specular = specularBase * specularBase * specularBase;
+                        }
+                        else
+                        {
+                            specular = std::pow(specularBase, SpecularPower);
+                        }
 
                         //復元結果
-                        auto surfaceValue = ImageUtility::DoubleSub(grayscaleValue, coefs.x() * diffuse - coefs.y() * specular) / coefs.z();
-                        imageBuffer[y][x] = surfaceValue;
+                        outputLine[x] = ImageUtility::DoubleSub(grayscaleLine[x], coefDiffuse * diffuse - coefSpecular * specular) / coefSkin;
                     }
-                }
+                });
 
-                return new FloatingPointImageData(width, height, imageBuffer, averageNormalBuffer);
+                return imageBuffer;
             }
         };
     }
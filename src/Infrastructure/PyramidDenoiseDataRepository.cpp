@@ -0,0 +1 @@
+#include "PyramidDenoiseDataRepository.hpp"
@@ -0,0 +1,231 @@
+#pragma once
+
+#include "FloatingPointImageData.hpp"
+#include "EllipseDenoiseDataRepository.hpp"
+#include "HyperEllipseDenoiseDataRepository.hpp"
+
+#include <chrono>
+
+namespace ImageInformationAnalyzer
+{
+    namespace Infrastructure
+    {
+        using namespace Domain;
+
+        //Coarse to fine: Fitter runs on a gaussian pyramid (DenoiseSetting::PyramidLevels)
+        //The conic of the coarser level, moved to the pixel, is the start value of the renormalization (few iterations)
+        //and the guide where the fit does not converge
+        //With two tier scheduling a pixel that fails the first tier is refitted with the full loop limit from the same start value
+        template<typename Fitter>
+        class PyramidDenoiseDataRepository : public IDenoiseImageDataRepository
+        {
+            typedef typename Fitter::ImagePoint ImagePoint;
+            typedef Eigen::Matrix<double, 7, 1> Theta;
+
+            Fitter fitter_;
+
+            //Denoised coarser levels of the last Process() call, see GetLevels()
+            std::vector<std::unique_ptr<FloatingPointImageData>> levelResults_;
+
+            //Coarse conic in the coordinates of a pixel of the next finer level
+            //x_coarse = x_fine / 2, then the origin is moved by (a, b) fine pixels
+            static inline Theta GetFineTheta(const Theta& coarseTheta, const int a, const int b)
+            {
+                const double f0 = WINDOW_SIZE;
+                if(coarseTheta.isZero()) return coarseTheta;
+
+                auto A = coarseTheta(0) / 4;
+                auto B = coarseTheta(1) / 4;
+                auto C = coarseTheta(2) / 4;
+                auto D = coarseTheta(3) / 2;
+                auto E = coarseTheta(4) / 2;
+                auto F = coarseTheta(5);
+                auto G = coarseTheta(6);
+
+                Theta theta;
+                theta << A, B, C,
+                    D + (A * a + B * b) / f0,
+                    E + (B * a + C * b) / f0,
+                    F + (A * a * a + 2 * B * a * b + C * b * b + 2 * f0 * (D * a + E * b)) / (f0 * f0),
+                    G;
+                return theta.normalized();
+            }
+
+            //Value and normal of the conic at its origin, as the fitter computes them
+            static inline bool GetGuide(const Theta& theta, double& denoisedPixel, Eigen::Vector3d& normal)
+            {
+                const double f0 = WINDOW_SIZE;
+                if(theta.isZero() || theta(6) == 0) return false;
+
+                denoisedPixel = theta(5) * f0 / (2 * theta(6));
+                normal = Eigen::Vector3d(-theta(3) / theta(6), -theta(4) / theta(6), 1).normalized();
+                return true;
+            }
+
+            struct Level
+            {
+                std::unique_ptr<FloatingPointImageData> Data;
+                std::vector<std::vector<double>> ImageBuffer;
+                std::vector<std::vector<Eigen::Vector3d>> NormalBuffer;
+                std::vector<std::vector<Theta>> ThetaBuffer;
+            };
+
+        public:
+            explicit PyramidDenoiseDataRepository(const DenoiseSetting& setting = DenoiseSetting()) : IDenoiseImageDataRepository(setting), fitter_(setting)
+            {
+            }
+            virtual ~PyramidDenoiseDataRepository() = default;
+
+            //The window of the coarsest level, which gives the start values
+            virtual int GetWindowRadius() const override
+            {
+                return (WINDOW_SIZE / 2) << (std::max(setting_.PyramidLevels, 1) - 1);
+            }
+
+            virtual std::vector<FloatingPointImageData*> GetLevels() const override
+            {
+                std::vector<FloatingPointImageData*> levels;
+                for(const auto& level : levelResults_)
+                {
+                    levels.push_back(new FloatingPointImageData(*level));
+                }
+                return levels;
+            }
+
+            virtual FloatingPointImageData* Process(const FloatingPointImageData* data, std::atomic<int>* processedPixel = nullptr) override
+            {
+                //Levels, 0 is the full resolution. Each level must still hold a few windows
+                std::vector<Level> levels;
+                levels.resize(1);
+                levels[0].ImageBuffer = data->ImageBuffer;
+                while(levels.size() < std::max(setting_.PyramidLevels, 1))
+                {
+                    const auto& finer = levels.back().ImageBuffer;
+                    if(finer.size() < 4 * WINDOW_SIZE || finer[0].size() < 4 * WINDOW_SIZE) break;
+
+                    Level level;
+                    level.ImageBuffer = Misc::ImageUtility::PyramidDown(finer);
+                    levels.push_back(std::move(level));
+                }
+                for(auto& level : levels)
+                {
+                    auto height = (int)level.ImageBuffer.size();
+                    auto width = (int)level.ImageBuffer[0].size();
+                    level.Data.reset(new FloatingPointImageData(width, height, level.ImageBuffer, std::vector<std::vector<Eigen::Vector3d>>(height, std::vector<Eigen::Vector3d>(width, Eigen::Vector3d(0, 0, 1)))));
+                }
+
+                //Progress: the caller counts the pixels of level 0, all the levels share them in proportion to their pixels
+                const auto reportedPixels = (long long)(mask_ != nullptr ? mask_->GetPixelCount() : data->Width * data->Height);
+                auto totalPixels = reportedPixels;
+                for(auto l = 1; l < levels.size(); ++l)
+                {
+                    totalPixels += (long long)levels[l].Data->Width * levels[l].Data->Height;
+                }
+                std::atomic<long long> donePixels(0);
+
+                //C++17
+                std::atomic<int> errorPixel(0);
+
+                for(auto l = (int)levels.size() - 1; l >= 0; --l)
+                {
+                    auto start = std::chrono::system_clock::now();
+                    std::atomic<int> levelErrorPixel(0);
+                    std::atomic<int> secondTierPixel(0);
+
+                    auto& level = levels[l];
+                    const auto* coarser = l + 1 < levels.size() ? &levels[l + 1] : nullptr;
+                    auto width = level.Data->Width;
+                    auto height = level.Data->Height;
+
+                    level.NormalBuffer.assign(height, std::vector<Eigen::Vector3d>(width));
+                    level.ThetaBuffer.assign(height, std::vector<Theta>(width));
+                    std::vector<std::vector<double>> denoisedBuffer(height, std::vector<double>(width));
+                    std::vector<double> fittingErrors((size_t)width * height);
+
+                    //The coarser levels are cheap and give the start values around the mask, only the full resolution is masked
+                    std::vector<int> pixelIndices(fittingErrors.size());
+                    std::iota(pixelIndices.begin(), pixelIndices.end(), 0);
+                    if(l == 0 && mask_ != nullptr)
+                    {
+                        pixelIndices = GetMaskedPixelIndices(width, height);
+                        denoisedBuffer = level.ImageBuffer;
+                        level.NormalBuffer = data->NormalBuffer;
+                    }
+
+                    std::for_each(std::execution::par, pixelIndices.begin(), pixelIndices.end(), [&](const int index)
+                    {
+                        const auto x = index % width;
+                        const auto y = index / width;
+
+                        //Start value from the coarser level, cold start on the coarsest one
+                        Theta theta = Theta().Zero();
+                        if(coarser != nullptr)
+                        {
+                            auto coarseX = std::min(x / 2, coarser->Data->Width - 1);
+                            auto coarseY = std::min(y / 2, coarser->Data->Height - 1);
+                            theta = GetFineTheta(coarser->ThetaBuffer[coarseY][coarseX], x - 2 * coarseX, y - 2 * coarseY);
+                        }
+                        Theta guide = theta;
+
+                        auto windowPoints = Misc::ImageUtility::GetWindowPoints<ImagePoint>(level.Data.get(), x, y, WINDOW_SIZE);
+
+                        auto denoisedPixel = 0.0;
+                        auto fittingError = 0.0;
+                        Eigen::Vector3d normal;
+                        auto succeeded = fitter_.FitWindow(windowPoints, theta, denoisedPixel, normal, fittingError, false);
+                        if(!succeeded && setting_.TwoTierScheduling)
+                        {
+                            //Full loop limit from the same start value
+                            secondTierPixel++;
+                            theta = guide;
+                            succeeded = fitter_.FitWindow(windowPoints, theta, denoisedPixel, normal, fittingError, true);
+                        }
+                        if(!succeeded)
+                        {
+                            errorPixel++;
+                            levelErrorPixel++;
+
+                            //Coarse surface instead of the noisy center value
+                            GetGuide(guide, denoisedPixel, normal);
+                            theta = guide;
+                        }
+
+                        denoisedBuffer[y][x] = denoisedPixel;
+                        level.NormalBuffer[y][x] = normal;
+                        level.ThetaBuffer[y][x] = theta;
+                        fittingErrors[index] = fittingError;
+
+                        if(processedPixel != nullptr)
+                        {
+                            const auto done = donePixels++;
+                            (*processedPixel) += (int)((done + 1) * reportedPixels / totalPixels - done * reportedPixels / totalPixels);
+                        }
+                    });
+                    level.ImageBuffer = std::move(denoisedBuffer);
+
+                    auto end = std::chrono::system_clock::now();
+
+                    auto totalFittingError = 0.0;
+                    for(auto fittingError : fittingErrors)
+                    {
+                        totalFittingError += fittingError;
+                    }
+                    if(!quiet_) std::cout << "Pyramid level "s << l << ": "s << width << "x"s << height << ", "s << std::chrono::duration_cast<std::chrono::milliseconds>(end - start).count() << "ms, fitting error/pixel: "s << totalFittingError / std::max(pixelIndices.size(), (size_t)1) << ", error pixel: "s << levelErrorPixel << ", second tier pixel: "s << secondTierPixel << std::endl;
+                }
+                if(!quiet_) std::cout << "Error Pixel: "s << errorPixel << std::endl;
+
+                //Level 0 is the result itself
+                levelResults_.clear();
+                for(auto l = 1; l < levels.size(); ++l)
+                {
+                    levelResults_.emplace_back(new FloatingPointImageData(levels[l].Data->Width, levels[l].Data->Height, levels[l].ImageBuffer, levels[l].NormalBuffer));
+                }
+
+                return new FloatingPointImageData(data->Width, data->Height, levels[0].ImageBuffer, levels[0].NormalBuffer);
+            }
+        };
+
+        typedef PyramidDenoiseDataRepository<EllipseDenoiseDataRepository> PyramidEllipseDenoiseDataRepository;
+        typedef PyramidDenoiseDataRepository<HyperEllipseDenoiseDataRepository> PyramidHyperEllipseDenoiseDataRepository;
+    }
+}
@@ -0,0 +1,2 @@
+
+#include "PyramidPhongModelLightDirectionDataRepository.hpp"
\ No newline at end of file
@@ -0,0 +1,137 @@
+#pragma once
+
+#include "PhongModelLightDirectionDataRepository.hpp"
+
+namespace ImageInformationAnalyzer
+{
+    namespace Infrastructure
+    {
+        using namespace Domain;
+
+        class PyramidPhongModelLightDirectionDataRepository : public PhongModelLightDirectionDataRepository
+        {
+            enum
+            {
+                MIN_LEVEL_SIZE = 16
+            };
+
+            struct Level
+            {
+                int Width;
+                int Height;
+                double PixelPitch;
+                std::vector<std::vector<double>> ImageBuffer;
+                std::vector<std::vector<Eigen::Vector3d>> NormalBuffer;
+                std::vector<std::vector<double>> DifferentialBuffer;
+                std::vector<std::vector<double>> MaskBuffer;
+                std::unique_ptr<MaskData> Mask;
+            };
+
+        protected:
+            //Level 0 is not stored, the caller owns the full resolution buffers
+            inline std::vector<Level> GetPyramid(const int width, const int height, const std::vector<std::vector<double>>& averageImageBuffer, const std::vector<std::vector<Eigen::Vector3d>>& averageNormalBuffer, const FloatingPointImageData* differentialB_G, const double pixelPitch)
+            {
+                std::vector<Level> levels;
+                for(auto level = 1; level <= setting_.PyramidLevelCount; ++level)
+                {
+                    const auto& previousImage = level == 1 ? averageImageBuffer : levels.back().ImageBuffer;
+                    const auto& previousNormal = level == 1 ? averageNormalBuffer : levels.back().NormalBuffer;
+                    const auto& previousDifferential = level == 1 ? differentialB_G->ImageBuffer : levels.back().DifferentialBuffer;
+                    const auto previousWidth = level == 1 ? width : levels.back().Width;
+                    const auto previousHeight = level == 1 ? height : levels.back().Height;
+                    const auto previousPitch = level == 1 ? pixelPitch : levels.back().PixelPitch;
+
+                    if((previousWidth + 1) / 2 < MIN_LEVEL_SIZE || (previousHeight + 1) / 2 < MIN_LEVEL_SIZE) break;
+
+                    Level next;
+                    next.Width = (previousWidth + 1) / 2;
+                    next.Height = (previousHeight + 1) / 2;
+                    next.PixelPitch = previousPitch * 2;
+                    next.ImageBuffer = ImageUtility::PyramidDown(previousImage);
+                    next.NormalBuffer = ImageUtility::PyramidDown(previousNormal);
+                    next.DifferentialBuffer = ImageUtility::PyramidDown(previousDifferential);
+
+                    //Coverage of the mask, a coarse pixel is inside if at least half of its footprint is
+                    if(mask_ != nullptr)
+                    {
+                        std::vector<std::vector<double>> previousMask;
+                        if(level == 1)
+                        {
+                            previousMask.assign(height, std::vector<double>(width));
+                            for(auto y = 0; y < height; ++y)
+                            {
+                                for(auto x = 0; x < width; ++x)
+                                {
+                                    previousMask[y][x] = mask_->IsInside(x, y) ? 1.0 : 0.0;
+                                }
+                            }
+                        }
+                        next.MaskBuffer = ImageUtility::PyramidDown(level == 1 ? previousMask : levels.back().MaskBuffer);
+
+                        std::vector<std::vector<unsigned char>> maskBuffer(next.Height, std::vector<unsigned char>(next.Width));
+                        for(auto y = 0; y < next.Height; ++y)
+                        {
+                            for(auto x = 0; x < next.Width; ++x)
+                            {
+                                maskBuffer[y][x] = next.MaskBuffer[y][x] >= 0.5 ? 1 : 0;
+                            }
+                        }
+                        next.Mask.reset(new MaskData(next.Width, next.Height, maskBuffer));
+
+                        //Too small a region for this level
+                        if(next.Mask->GetPixelCount() == 0) break;
+                    }
+
+                    for(auto& line : next.NormalBuffer)
+                    {
+                        for(auto& normal : line)
+                        {
+                            normal.normalize();
+                        }
+                    }
+                    levels.push_back(std::move(next));
+                }
+                return levels;
+            }
+
+            virtual void EstimateParameters(const int width, const int height, const std::vector<std::vector<double>>& averageImageBuffer, const std::vector<std::vector<Eigen::Vector3d>>& averageNormalBuffer, const FloatingPointImageData* differentialB_G, const double pixelPitch, Eigen::Vector2d& resultLight, Eigen::Vector2d& resultCoef, std::atomic<double>* progress) override
+            {
+                auto levels = GetPyramid(width, height, averageImageBuffer, averageNormalBuffer, differentialB_G, pixelPitch);
+
+                //Coarse to fine, each level starts from the previous solution
+                //A warm start is close enough for the finest level alone
+                const auto finestLevel = std::clamp(setting_.PyramidFinestLevel, 0, (int)levels.size());
+                const auto coarsestLevel = warm_ ? finestLevel : (int)levels.size();
+                for(auto level = coarsestLevel; level >= finestLevel; --level)
+                {
+                    auto start = std::chrono::system_clock::now();
+
+                    std::vector<Point3D> data;
+                    if(level == 0)
+                    {
+                        data = GetPoints(width, height, averageImageBuffer, averageNormalBuffer, differentialB_G->ImageBuffer, pixelPitch, mask_);
+                    }
+                    else
+                    {
+                        const auto& current = levels[level - 1];
+                        data = GetPoints(current.Width, current.Height, current.ImageBuffer, current.NormalBuffer, current.DifferentialBuffer, current.PixelPitch, current.Mask.get());
+                    }
+
+                    //Only the coarsest level needs to search for the basin
+                    auto summary = Solve(data, resultLight, resultCoef, progress, level == coarsestLevel ? GetStartCount() : 1);
+
+                    auto end = std::chrono::system_clock::now();
+                    auto elapsedMillisecounds = std::chrono::duration_cast<std::chrono::milliseconds>(end - start).count();
+
+                    std::cout << "Pyramid level "s << level << ": "s << data.size() << " pixels, cost/pixel: "s << summary.final_cost / data.size() << ", light("s << resultLight.x() << ", "s << resultLight.y() << "), "s << elapsedMillisecounds << "ms"s << std::endl;
+                }
+            }
+
+        public:
+            explicit PyramidPhongModelLightDirectionDataRepository(const LightEstimationSetting& setting) : PhongModelLightDirectionDataRepository(setting)
+            {
+            }
+            virtual ~PyramidPhongModelLightDirectionDataRepository() = default;
+        };
+    }
+}
@@ -16,6 +16,8 @@ namespace ImageInformationAnalyzer
 
             virtual Domain::HistogramData* Process(const FloatingPointImageData* data, const int histogramSize, const double histogramMinValue, const double histogramMaxValue) override
             {
+                if(mask_ != nullptr && (mask_->Width != data->Width || mask_->Height != data->Height)) throw std::invalid_argument("mask must have the same size as the image");
+
                 std::vector<double> histogram;
                 histogram.resize(histogramSize);
 
@@ -23,6 +25,8 @@ namespace ImageInformationAnalyzer
                 {
                     for(auto x = 0; x < data->Width; ++x)
                     {
+                        if(!IsInsideMask(mask_, x, y)) continue;
+
                         auto value = data->ImageBuffer[y][x];
 
                         if(value < histogramMinValue) continue;
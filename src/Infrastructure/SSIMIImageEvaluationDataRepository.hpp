@@ -18,6 +18,7 @@ namespace ImageInformationAnalyzer
             {
                 auto width = data1->Width;
                 auto height = data1->Height;
+                auto pixelCount = GetPixelCount(data1);
 
                 auto average1 = 0.0;
                 auto average2 = 0.0;
@@ -25,12 +26,14 @@ namespace ImageInformationAnalyzer
                 {
                     for(auto x = 0; x < width; ++x)
                     {
+                        if(!IsInsideMask(mask_, x, y)) continue;
+
                         average1 += data1->ImageBuffer[y][x];
                         average2 += data2->ImageBuffer[y][x];
                     }
                 }
-                average1 /= ((double)width * height);
-                average2 /= ((double)width * height);
+                average1 /= pixelCount;
+                average2 /= pixelCount;
 
                 auto variance1 = 0.0;
                 auto variance2 = 0.0;
@@ -40,14 +43,16 @@ namespace ImageInformationAnalyzer
                 {
                     for(auto x = 0; x < width; ++x)
                     {
+                        if(!IsInsideMask(mask_, x, y)) continue;
+
                         variance1 += (data1->ImageBuffer[y][x] - average1) * (data1->ImageBuffer[y][x] - average1);
                         variance2 += (data2->ImageBuffer[y][x] - average2) * (data2->ImageBuffer[y][x] - average2);
                         covariance += (data1->ImageBuffer[y][x] - average1) * (data2->ImageBuffer[y][x] - average2);
                     }
                 }
-                variance1 /= ((double)width * height);
-                variance2 /= ((double)width * height);
-                covariance /= ((double)width * height);
+                variance1 /= pixelCount;
+                variance2 /= pixelCount;
+                covariance /= pixelCount;
 
                 constexpr auto K1 = 0.01;
                 constexpr auto K2 = 0.03;
@@ -0,0 +1 @@
+#include "SimdEllipseDenoiseDataRepository.hpp"
@@ -0,0 +1,613 @@
+#pragma once
+
+#include "FloatingPointImageData.hpp"
+#include "EllipseDenoiseDataRepository.hpp"
+
+#include <memory>
+#include <numeric>
+
+namespace ImageInformationAnalyzer
+{
+    namespace Infrastructure
+    {
+        using namespace Domain;
+
+        //Renormalization of LANE_COUNT pixels in lockstep, one pixel per SIMD lane (AoSoA)
+        //Every window has the same offsets, so V0 is shared and only the -2f0z element of zeta differs between lanes
+        //Derived::CalcN() is called without virtual dispatch (CRTP)
+        template<typename Derived>
+        class SimdEllipseDenoiseDataRepositoryBase : public EllipseDenoiseDataRepository
+        {
+        protected:
+            enum
+            {
+            #ifdef USE_AVX
+                LANE_COUNT = 8, //two 256bit registers of double
+            #else
+                LANE_COUNT = 4, //two 128bit registers of double
+            #endif
+                POINT_COUNT = WINDOW_SIZE * WINDOW_SIZE,
+                EIGEN_MAX_LOOP = 64
+            };
+
+            typedef double LaneValue[LANE_COUNT];
+            typedef LaneValue LaneVector[7];
+            typedef LaneValue LaneMatrix[7][7];
+            typedef bool LaneMask[LANE_COUNT];
+
+            //Common to all pixels
+            struct WindowGeometry
+            {
+                double F0;
+                double OffsetX[POINT_COUNT];
+                double OffsetY[POINT_COUNT];
+                double Zeta[POINT_COUNT][6]; //x^2, 2xy, y^2, 2f0x, 2f0y, f0^2
+                double Variance0Matrix[POINT_COUNT][7][7];
+            };
+
+            struct LaneBatch
+            {
+                int Count;
+                int X[LANE_COUNT];
+                int Y[LANE_COUNT];
+                LaneValue Values[POINT_COUNT];
+                LaneValue ZetaZ[POINT_COUNT]; //-2f0z
+                LaneValue Weights[POINT_COUNT];
+                LaneMatrix M;
+                LaneMatrix N;
+                LaneMatrix L; //Cholesky factor of M
+                LaneMask CholeskySucceeded;
+                LaneVector Theta;
+                LaneMask Active;
+                LaneMask Converged;
+            };
+
+            inline void GetWindowGeometry(const int windowSize, WindowGeometry& geometry)
+            {
+                auto points = ImageUtility::GetWindowPoints<ImagePointEllipse>(windowSize);
+
+                geometry.F0 = windowSize;
+                for(auto i = 0; i < POINT_COUNT; ++i)
+                {
+                    geometry.OffsetX[i] = points[i].OffsetX;
+                    geometry.OffsetY[i] = points[i].OffsetY;
+
+                    auto zeta = GetZetaVector(points[i].OffsetX, points[i].OffsetY, 0, geometry.F0);
+                    auto variance0 = GetVariance0(points[i].OffsetX, points[i].OffsetY, geometry.F0);
+                    for(auto j = 0; j < 7; ++j)
+                    {
+                        if(j < 6) geometry.Zeta[i][j] = zeta(j);
+                        for(auto k = 0; k < 7; ++k)
+                        {
+                            geometry.Variance0Matrix[i][j][k] = variance0(j, k);
+                        }
+                    }
+                }
+            }
+
+            static inline void GetZeta(const LaneBatch& batch, const WindowGeometry& geometry, const int i, LaneVector& zeta)
+            {
+                for(auto j = 0; j < 6; ++j)
+                {
+                    for(auto l = 0; l < LANE_COUNT; ++l) zeta[j][l] = geometry.Zeta[i][j];
+                }
+                for(auto l = 0; l < LANE_COUNT; ++l) zeta[6][l] = batch.ZetaZ[i][l];
+            }
+
+            //Lane access for the scalar fallback
+            static inline Eigen::Matrix<double, 7, 7> GetLaneMatrix(const LaneMatrix& matrix, const int lane)
+            {
+                Eigen::Matrix<double, 7, 7> result;
+                for(auto j = 0; j < 7; ++j)
+                {
+                    for(auto k = 0; k < 7; ++k) result(j, k) = matrix[j][k][lane];
+                }
+                return result;
+            }
+
+            static inline Eigen::Matrix<double, 7, 1> GetLaneVector(const LaneVector& vector, const int lane)
+            {
+                Eigen::Matrix<double, 7, 1> result;
+                for(auto j = 0; j < 7; ++j) result(j) = vector[j][lane];
+                return result;
+            }
+
+            static inline void SetLaneVector(const Eigen::Matrix<double, 7, 1>& vector, const int lane, LaneVector& result)
+            {
+                for(auto j = 0; j < 7; ++j) result[j][lane] = vector(j);
+            }
+
+            static inline void Multiply(const LaneMatrix& matrix, const LaneVector& vector, LaneVector& result)
+            {
+                for(auto j = 0; j < 7; ++j)
+                {
+                    for(auto l = 0; l < LANE_COUNT; ++l) result[j][l] = 0;
+                    for(auto k = 0; k < 7; ++k)
+                    {
+                        #pragma omp simd
+                        for(auto l = 0; l < LANE_COUNT; ++l) result[j][l] += matrix[j][k][l] * vector[k][l];
+                    }
+                }
+            }
+
+            static inline void Dot(const LaneVector& a, const LaneVector& b, LaneValue& result)
+            {
+                for(auto l = 0; l < LANE_COUNT; ++l) result[l] = 0;
+                for(auto j = 0; j < 7; ++j)
+                {
+                    #pragma omp simd
+                    for(auto l = 0; l < LANE_COUNT; ++l) result[l] += a[j][l] * b[j][l];
+                }
+            }
+
+            static inline void Normalize(LaneVector& vector)
+            {
+                LaneValue norm;
+                Dot(vector, vector, norm);
+                for(auto l = 0; l < LANE_COUNT; ++l) norm[l] = 1 / std::sqrt(norm[l]);
+                for(auto j = 0; j < 7; ++j)
+                {
+                    #pragma omp simd
+                    for(auto l = 0; l < LANE_COUNT; ++l) vector[j][l] *= norm[l];
+                }
+            }
+
+            //Same as MatrixUtility::GetSeed()
+            static inline void GetSeed(const LaneVector& seed, LaneVector& result)
+            {
+                LaneValue norm;
+                Dot(seed, seed, norm);
+                for(auto j = 0; j < 7; ++j)
+                {
+                    for(auto l = 0; l < LANE_COUNT; ++l) result[j][l] = norm[l] > 0 ? seed[j][l] : 1.0;
+                }
+                Normalize(result);
+            }
+
+            //Lower triangle of the symmetric matrix, failed lanes get a dummy pivot
+            static inline void Cholesky(const LaneMatrix& matrix, LaneMatrix& lower, LaneMask& succeeded)
+            {
+                for(auto l = 0; l < LANE_COUNT; ++l) succeeded[l] = true;
+
+                for(auto j = 0; j < 7; ++j)
+                {
+                    for(auto i = j; i < 7; ++i)
+                    {
+                        LaneValue sum;
+                        for(auto l = 0; l < LANE_COUNT; ++l) sum[l] = matrix[i][j][l];
+                        for(auto k = 0; k < j; ++k)
+                        {
+                            #pragma omp simd
+                            for(auto l = 0; l < LANE_COUNT; ++l) sum[l] -= lower[i][k][l] * lower[j][k][l];
+                        }
+
+                        if(i == j)
+                        {
+                            for(auto l = 0; l < LANE_COUNT; ++l)
+                            {
+                                succeeded[l] = succeeded[l] && sum[l] > 0;
+                                lower[j][j][l] = std::sqrt(sum[l] > 0 ? sum[l] : 1.0);
+                            }
+                        }
+                        else
+                        {
+                            #pragma omp simd
+                            for(auto l = 0; l < LANE_COUNT; ++l) lower[i][j][l] = sum[l] / lower[j][j][l];
+                        }
+                    }
+                }
+            }
+
+            //L * L^t * result = vector
+            static inline void CholeskySolve(const LaneMatrix& lower, const LaneVector& vector, LaneVector& result)
+            {
+                for(auto i = 0; i < 7; ++i)
+                {
+                    for(auto l = 0; l < LANE_COUNT; ++l) result[i][l] = vector[i][l];
+                    for(auto k = 0; k < i; ++k)
+                    {
+                        #pragma omp simd
+                        for(auto l = 0; l < LANE_COUNT; ++l) result[i][l] -= lower[i][k][l] * result[k][l];
+                    }
+                    for(auto l = 0; l < LANE_COUNT; ++l) result[i][l] /= lower[i][i][l];
+                }
+                for(auto i = 6; i >= 0; --i)
+                {
+                    for(auto k = i + 1; k < 7; ++k)
+                    {
+                        #pragma omp simd
+                        for(auto l = 0; l < LANE_COUNT; ++l) result[i][l] -= lower[k][i][l] * result[k][l];
+                    }
+                    for(auto l = 0; l < LANE_COUNT; ++l) result[i][l] /= lower[i][i][l];
+                }
+            }
+
+            //Normalize, align the sign to previous, then the L1 distance
+            static inline void UpdateDirection(LaneVector& next, const LaneVector& previous, LaneValue& distance)
+            {
+                Normalize(next);
+
+                LaneValue sign;
+                Dot(next, previous, sign);
+                for(auto l = 0; l < LANE_COUNT; ++l)
+                {
+                    sign[l] = sign[l] < 0 ? -1.0 : 1.0;
+                    distance[l] = 0;
+                }
+                for(auto j = 0; j < 7; ++j)
+                {
+                    #pragma omp simd
+                    for(auto l = 0; l < LANE_COUNT; ++l)
+                    {
+                        next[j][l] *= sign[l];
+                        distance[l] += std::abs(next[j][l] - previous[j][l]);
+                    }
+                }
+            }
+
+            //M = 1/n * sum(W * zeta * zeta^t)
+            inline void CalcM(LaneBatch& batch, const WindowGeometry& geometry)
+            {
+                for(auto j = 0; j < 7; ++j)
+                {
+                    for(auto k = 0; k <= j; ++k)
+                    {
+                        for(auto l = 0; l < LANE_COUNT; ++l) batch.M[j][k][l] = 0;
+                    }
+                }
+
+                for(auto i = 0; i < POINT_COUNT; ++i)
+                {
+                    const auto& weights = batch.Weights[i];
+                    const auto& zetaZ = batch.ZetaZ[i];
+
+                    for(auto j = 0; j < 6; ++j)
+                    {
+                        for(auto k = 0; k <= j; ++k)
+                        {
+                            const auto zeta = geometry.Zeta[i][j] * geometry.Zeta[i][k];
+                            #pragma omp simd
+                            for(auto l = 0; l < LANE_COUNT; ++l) batch.M[j][k][l] += weights[l] * zeta;
+                        }
+                    }
+                    for(auto k = 0; k < 6; ++k)
+                    {
+                        #pragma omp simd
+                        for(auto l = 0; l < LANE_COUNT; ++l) batch.M[6][k][l] += weights[l] * (zetaZ[l] * geometry.Zeta[i][k]);
+                    }
+                    #pragma omp simd
+                    for(auto l = 0; l < LANE_COUNT; ++l) batch.M[6][6][l] += weights[l] * (zetaZ[l] * zetaZ[l]);
+                }
+
+                for(auto j = 0; j < 7; ++j)
+                {
+                    for(auto k = 0; k <= j; ++k)
+                    {
+                        for(auto l = 0; l < LANE_COUNT; ++l)
+                        {
+                            batch.M[j][k][l] = batch.M[j][k][l] / POINT_COUNT;
+                            batch.M[k][j][l] = batch.M[j][k][l];
+                        }
+                    }
+                }
+            }
+
+            //N = 1/n * sum(W * V0)
+            inline void CalcN(LaneBatch& batch, const WindowGeometry& geometry)
+            {
+                for(auto j = 0; j < 7; ++j)
+                {
+                    for(auto k = 0; k <= j; ++k)
+                    {
+                        for(auto l = 0; l < LANE_COUNT; ++l) batch.N[j][k][l] = 0;
+                    }
+                }
+
+                for(auto i = 0; i < POINT_COUNT; ++i)
+                {
+                    for(auto j = 0; j < 7; ++j)
+                    {
+                        for(auto k = 0; k <= j; ++k)
+                        {
+                            //V0 is sparse and the same for every lane
+                            const auto variance0 = geometry.Variance0Matrix[i][j][k];
+                            if(variance0 == 0) continue;
+
+                            #pragma omp simd
+                            for(auto l = 0; l < LANE_COUNT; ++l) batch.N[j][k][l] += batch.Weights[i][l] * variance0;
+                        }
+                    }
+                }
+
+                for(auto j = 0; j < 7; ++j)
+                {
+                    for(auto k = 0; k <= j; ++k)
+                    {
+                        for(auto l = 0; l < LANE_COUNT; ++l)
+                        {
+                            batch.N[j][k][l] = batch.N[j][k][l] / POINT_COUNT;
+                            batch.N[k][j][l] = batch.N[j][k][l];
+                        }
+                    }
+                }
+            }
+
+            //Lane version of MatrixUtility::GetLargestGeneralizedEigenvector(), seeded with batch.Theta
+            inline void SolveLargestGeneralizedEigenvector(const LaneBatch& batch, LaneVector& theta)
+            {
+                LaneMask done;
+                for(auto l = 0; l < LANE_COUNT; ++l) done[l] = !batch.Active[l] || !batch.CholeskySucceeded[l];
+
+                GetSeed(batch.Theta, theta);
+                for(auto loop = 0; loop < EIGEN_MAX_LOOP; ++loop)
+                {
+                    LaneVector Ntheta;
+                    LaneVector next;
+                    LaneValue distance;
+                    Multiply(batch.N, theta, Ntheta);
+                    CholeskySolve(batch.L, Ntheta, next);
+                    UpdateDirection(next, theta, distance);
+
+                    auto allDone = true;
+                    for(auto l = 0; l < LANE_COUNT; ++l)
+                    {
+                        if(done[l]) continue;
+                        for(auto j = 0; j < 7; ++j) theta[j][l] = next[j][l];
+                        done[l] = distance[l] <= 1e-12;
+                        allDone = allDone && done[l];
+                    }
+                    if(allDone) break;
+                }
+
+                //Eigenpair check, then the scalar solver for the lanes that failed
+                LaneVector Ntheta;
+                LaneVector Mtheta;
+                Multiply(batch.N, theta, Ntheta);
+                Multiply(batch.M, theta, Mtheta);
+                for(auto l = 0; l < LANE_COUNT; ++l)
+                {
+                    if(!batch.Active[l]) continue;
+
+                    auto vectorNtheta = GetLaneVector(Ntheta, l);
+                    auto vectorMtheta = GetLaneVector(Mtheta, l);
+                    auto vectorTheta = GetLaneVector(theta, l);
+                    auto mu = vectorTheta.dot(vectorNtheta) / vectorTheta.dot(vectorMtheta);
+                    if(batch.CholeskySucceeded[l] && mu > 0 && (vectorNtheta - mu * vectorMtheta).norm() <= 1e-8 * vectorNtheta.norm()) continue;
+
+                    SetLaneVector(MatrixUtility::GetLargestGeneralizedEigenvector<7>(GetLaneMatrix(batch.N, l), GetLaneMatrix(batch.M, l), GetLaneVector(batch.Theta, l)), l, theta);
+                }
+            }
+
+            //くりこみ法 for all lanes, converged lanes are masked until the whole batch is done
+            inline void RenormalizeLanes(LaneBatch& batch, const WindowGeometry& geometry, long long& activeLaneLoop, long long& laneLoop)
+            {
+                for(auto i = 0; i < POINT_COUNT; ++i)
+                {
+                    for(auto l = 0; l < LANE_COUNT; ++l) batch.Weights[i][l] = 1.0;
+                }
+                for(auto l = 0; l < LANE_COUNT; ++l)
+                {
+                    for(auto j = 0; j < 7; ++j) batch.Theta[j][l] = 0;
+                    batch.Active[l] = l < batch.Count;
+                    batch.Converged[l] = false;
+                }
+
+                for(auto loop = 0; loop < MAX_LOOP; ++loop)
+                {
+                    auto activeCount = 0;
+                    for(auto l = 0; l < LANE_COUNT; ++l) activeCount += batch.Active[l] ? 1 : 0;
+                    if(activeCount == 0) break;
+
+                    activeLaneLoop += activeCount;
+                    laneLoop += LANE_COUNT;
+
+                    CalcM(batch, geometry);
+                    Cholesky(batch.M, batch.L, batch.CholeskySucceeded);
+                    static_cast<Derived*>(this)->CalcN(batch, geometry);
+
+                    LaneVector theta;
+                    SolveLargestGeneralizedEigenvector(batch, theta);
+
+                    //終了チェック
+                    LaneValue distance;
+                    for(auto l = 0; l < LANE_COUNT; ++l) distance[l] = 0;
+                    for(auto j = 0; j < 7; ++j)
+                    {
+                        for(auto l = 0; l < LANE_COUNT; ++l) distance[l] += std::abs(batch.Theta[j][l] - theta[j][l]);
+                    }
+                    for(auto l = 0; l < LANE_COUNT; ++l)
+                    {
+                        if(!batch.Active[l]) continue;
+                        for(auto j = 0; j < 7; ++j) batch.Theta[j][l] = theta[j][l];
+                        if(distance[l] <= ERROR_THRESHOLD)
+                        {
+                            batch.Active[l] = false;
+                            batch.Converged[l] = true;
+                        }
+                    }
+
+                    //更新: W = 1 / (theta, V0 * theta)
+                    for(auto i = 0; i < POINT_COUNT; ++i)
+                    {
+                        LaneValue quadratic;
+                        for(auto l = 0; l < LANE_COUNT; ++l) quadratic[l] = 0;
+                        for(auto j = 0; j < 7; ++j)
+                        {
+                            for(auto k = 0; k < 7; ++k)
+                            {
+                                const auto variance0 = geometry.Variance0Matrix[i][j][k];
+                                if(variance0 == 0) continue;
+
+                                #pragma omp simd
+                                for(auto l = 0; l < LANE_COUNT; ++l) quadratic[l] += theta[j][l] * variance0 * theta[k][l];
+                            }
+                        }
+                        for(auto l = 0; l < LANE_COUNT; ++l)
+                        {
+                            if(batch.Active[l]) batch.Weights[i][l] = 1 / quadratic[l];
+                        }
+                    }
+                }
+            }
+
+        public:
+            explicit SimdEllipseDenoiseDataRepositoryBase(const DenoiseSetting& setting = DenoiseSetting()) : EllipseDenoiseDataRepository(setting)
+            {
+            }
+            virtual ~SimdEllipseDenoiseDataRepositoryBase() = default;
+
+            virtual FloatingPointImageData* Process(const FloatingPointImageData* data, std::atomic<int>* processedPixel = nullptr) override
+            {
+                auto width = data->Width;
+                auto height = data->Height;
+                auto pixelIndices = GetMaskedPixelIndices(width, height);
+                const auto pixelCount = (int)pixelIndices.size();
+
+                //Prepare buffers, pixels outside of the mask keep the input
+                auto imageBuffer = data->ImageBuffer;
+                auto normalBuffer = data->NormalBuffer;
+                std::vector<std::vector<double>> fittingErrorBuffer;
+                fittingErrorBuffer.resize(height);
+                for(auto y = 0; y < height; ++y)
+                {
+                    fittingErrorBuffer[y].resize(width);
+                }
+
+                auto geometry = std::make_unique<WindowGeometry>();
+                GetWindowGeometry(WINDOW_SIZE, *geometry);
+                const auto f0 = geometry->F0;
+
+                //Consecutive pixels of a row share a batch, their fits converge alike
+                std::vector<int> batchIndices((pixelCount + LANE_COUNT - 1) / LANE_COUNT);
+                std::iota(batchIndices.begin(), batchIndices.end(), 0);
+
+                std::atomic<int> errorPixel(0);
+                std::atomic<long long> activeLaneLoop(0);
+                std::atomic<long long> laneLoop(0);
+
+                std::for_each(std::execution::par, batchIndices.begin(), batchIndices.end(), [&](const int index)
+                {
+                    auto batch = std::make_unique<LaneBatch>();
+                    batch->Count = std::min((int)LANE_COUNT, pixelCount - index * LANE_COUNT);
+
+                    //Unused lanes repeat the last pixel
+                    for(auto l = 0; l < LANE_COUNT; ++l)
+                    {
+                        auto pixel = pixelIndices[index * LANE_COUNT + std::min(l, batch->Count - 1)];
+                        batch->X[l] = pixel % width;
+                        batch->Y[l] = pixel / width;
+
+                        for(auto i = 0; i < POINT_COUNT; ++i)
+                        {
+                            auto targetX = (batch->X[l] + width + (int)geometry->OffsetX[i]) % width;
+                            auto targetY = (batch->Y[l] + height + (int)geometry->OffsetY[i]) % height;
+
+                            batch->Values[i][l] = data->ImageBuffer[targetY][targetX];
+                            batch->ZetaZ[i][l] = -2 * f0 * batch->Values[i][l];
+                        }
+                    }
+
+                    auto batchActiveLaneLoop = 0ll;
+                    auto batchLaneLoop = 0ll;
+                    RenormalizeLanes(*batch, *geometry, batchActiveLaneLoop, batchLaneLoop);
+                    activeLaneLoop += batchActiveLaneLoop;
+                    laneLoop += batchLaneLoop;
+
+                    for(auto l = 0; l < batch->Count; ++l)
+                    {
+                        const auto x = batch->X[l];
+                        const auto y = batch->Y[l];
+
+                        if(!batch->Converged[l])
+                        {
+                            //計算が収束しなかった場合
+                            imageBuffer[y][x] = data->ImageBuffer[y][x];
+                            normalBuffer[y][x] = Eigen::Vector3d(0, 0, 1);
+                            fittingErrorBuffer[y][x] = 0;
+                            errorPixel++;
+                            continue;
+                        }
+
+                        auto A = batch->Theta[0][l];
+                        auto B = batch->Theta[1][l];
+                        auto C = batch->Theta[2][l];
+                        auto D = batch->Theta[3][l];
+                        auto E = batch->Theta[4][l];
+                        auto F = batch->Theta[5][l];
+                        auto G = batch->Theta[6][l];
+
+                        //ノイズ除去済み値
+                        imageBuffer[y][x] = F * f0 / (2 * G);
+
+                        //観測値と推測値の差の合計
+                        auto fittingError = 0.0;
+                        for(auto i = 0; i < POINT_COUNT; i++)
+                        {
+                            auto offsetX = geometry->OffsetX[i];
+                            auto offsetY = geometry->OffsetY[i];
+                            auto estimatedValue =
+                                (A * offsetX * offsetX
+                                    + B * offsetX * offsetY
+                                    + C * offsetY * offsetY
+                                    + D * 2 * f0 * offsetX
+                                    + E * 2 * f0 * offsetY
+                                    + F * f0 * f0) / (G * 2 * f0);
+                            fittingError += std::abs(ImageUtility::DoubleSub(batch->Values[i][l], estimatedValue));
+                        }
+                        fittingErrorBuffer[y][x] = fittingError;
+
+                        //法線ベクトル
+                        auto dzdx = D / G;
+                        auto dzdy = E / G;
+                        normalBuffer[y][x] = Eigen::Vector3d(-dzdx, -dzdy, 1).normalized();
+                    }
+
+                    if(processedPixel != nullptr) (*processedPixel) += batch->Count;
+                });
+
+                auto totalFittingError = 0.0;
+                for(const auto& line : fittingErrorBuffer)
+                {
+                    for(auto fittingError : line)
+                    {
+                        totalFittingError += fittingError;
+                    }
+                }
+                if(!quiet_)
+                {
+                    std::cout << "Error Pixel: "s << errorPixel << std::endl;
+                    std::cout << "Fitting error/pixel: "s << totalFittingError / std::max(pixelCount, 1) << std::endl;
+                    std::cout << "Lane utilisation: "s << 100.0 * activeLaneLoop / std::max(laneLoop.load(), 1ll) << "% of "s << (int)LANE_COUNT << " lanes"s << std::endl;
+                }
+
+                return new FloatingPointImageData(width, height, imageBuffer, normalBuffer);
+            }
+
+            //The lanes already batch the pixels, so the channels are processed one by one
+            virtual std::vector<FloatingPointImageData*> ProcessChannels(const std::vector<const FloatingPointImageData*>& data, std::atomic<int>* processedPixel = nullptr) override
+            {
+                return IDenoiseImageDataRepository::ProcessChannels(data, processedPixel);
+            }
+
+            virtual std::vector<FloatingPointImageData*> ProcessPasses(const std::vector<const FloatingPointImageData*>& data, const int passCount, std::atomic<int>* processedPixel = nullptr, ModelMaps* modelMaps = nullptr) override
+            {
+                return IDenoiseImageDataRepository::ProcessPasses(data, passCount, processedPixel, modelMaps);
+            }
+
+            //The inherited row path would run the scalar kernel of EllipseDenoiseDataRepository, whatever Derived fits
+            virtual int ProcessRow(const std::vector<std::vector<const std::vector<double>*>>&, std::vector<std::vector<double>>&) override
+            {
+                throw std::invalid_argument("the SIMD denoise modes can't stream, use ELLIPSE or HYPER_ELLIPSE");
+            }
+        };
+
+        class SimdEllipseDenoiseDataRepository : public SimdEllipseDenoiseDataRepositoryBase<SimdEllipseDenoiseDataRepository>
+        {
+        public:
+            explicit SimdEllipseDenoiseDataRepository(const DenoiseSetting& setting = DenoiseSetting()) : SimdEllipseDenoiseDataRepositoryBase<SimdEllipseDenoiseDataRepository>(setting)
+            {
+            }
+            virtual ~SimdEllipseDenoiseDataRepository() = default;
+        };
+    }
+}
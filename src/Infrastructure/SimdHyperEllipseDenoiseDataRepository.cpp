@@ -0,0 +1 @@
+#include "SimdHyperEllipseDenoiseDataRepository.hpp"
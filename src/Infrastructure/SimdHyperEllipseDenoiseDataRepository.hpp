@@ -0,0 +1,216 @@
+#pragma once
+
+#include "FloatingPointImageData.hpp"
+#include "SimdEllipseDenoiseDataRepository.hpp"
+
+namespace ImageInformationAnalyzer
+{
+    namespace Infrastructure
+    {
+        using namespace Domain;
+
+        //Lane version of HyperEllipseDenoiseDataRepository
+        class SimdHyperEllipseDenoiseDataRepository : public SimdEllipseDenoiseDataRepositoryBase<SimdHyperEllipseDenoiseDataRepository>
+        {
+            friend class SimdEllipseDenoiseDataRepositoryBase<SimdHyperEllipseDenoiseDataRepository>;
+
+        protected:
+            //Lane version of MatrixUtility::GetTruncatedInverse(), seeded with batch.Theta
+            inline void CalcMi6(const LaneBatch& batch, LaneMatrix& Mi)
+            {
+                LaneMask done;
+                for(auto l = 0; l < LANE_COUNT; ++l) done[l] = !batch.Active[l] || !batch.CholeskySucceeded[l];
+
+                //Smallest eigenvector by inverse iteration
+                LaneVector v;
+                GetSeed(batch.Theta, v);
+                for(auto loop = 0; loop < EIGEN_MAX_LOOP; ++loop)
+                {
+                    LaneVector next;
+                    LaneValue distance;
+                    CholeskySolve(batch.L, v, next);
+                    UpdateDirection(next, v, distance);
+
+                    auto allDone = true;
+                    for(auto l = 0; l < LANE_COUNT; ++l)
+                    {
+                        if(done[l]) continue;
+                        for(auto j = 0; j < 7; ++j) v[j][l] = next[j][l];
+                        done[l] = distance[l] <= 1e-12;
+                        allDone = allDone && done[l];
+                    }
+                    if(allDone) break;
+                }
+
+                //Lift the smallest eigenvalue
+                LaneValue trace;
+                for(auto l = 0; l < LANE_COUNT; ++l) trace[l] = 0;
+                for(auto j = 0; j < 7; ++j)
+                {
+                    for(auto l = 0; l < LANE_COUNT; ++l) trace[l] += batch.M[j][j][l];
+                }
+
+                LaneMatrix lifted;
+                for(auto j = 0; j < 7; ++j)
+                {
+                    for(auto k = 0; k < 7; ++k)
+                    {
+                        #pragma omp simd
+                        for(auto l = 0; l < LANE_COUNT; ++l) lifted[j][k][l] = batch.M[j][k][l] + trace[l] * v[j][l] * v[k][l];
+                    }
+                }
+
+                LaneMatrix liftedLower;
+                LaneMask liftedSucceeded;
+                Cholesky(lifted, liftedLower, liftedSucceeded);
+
+                //Inverse column by column
+                LaneMatrix inverse;
+                for(auto k = 0; k < 7; ++k)
+                {
+                    LaneVector unit;
+                    LaneVector column;
+                    for(auto j = 0; j < 7; ++j)
+                    {
+                        for(auto l = 0; l < LANE_COUNT; ++l) unit[j][l] = j == k ? 1.0 : 0.0;
+                    }
+                    CholeskySolve(liftedLower, unit, column);
+                    for(auto j = 0; j < 7; ++j)
+                    {
+                        for(auto l = 0; l < LANE_COUNT; ++l) inverse[j][k][l] = column[j][l];
+                    }
+                }
+
+                //Project out v: (I - v*v^t) * inverse * (I - v*v^t)
+                LaneVector inverseV;
+                Multiply(inverse, v, inverseV);
+                for(auto j = 0; j < 7; ++j)
+                {
+                    for(auto k = 0; k < 7; ++k)
+                    {
+                        #pragma omp simd
+                        for(auto l = 0; l < LANE_COUNT; ++l) inverse[j][k][l] -= inverseV[j][l] * v[k][l];
+                    }
+                }
+                for(auto k = 0; k < 7; ++k)
+                {
+                    LaneValue vInverse;
+                    for(auto l = 0; l < LANE_COUNT; ++l) vInverse[l] = 0;
+                    for(auto j = 0; j < 7; ++j)
+                    {
+                        #pragma omp simd
+                        for(auto l = 0; l < LANE_COUNT; ++l) vInverse[l] += v[j][l] * inverse[j][k][l];
+                    }
+                    for(auto j = 0; j < 7; ++j)
+                    {
+                        #pragma omp simd
+                        for(auto l = 0; l < LANE_COUNT; ++l) Mi[j][k][l] = inverse[j][k][l] - v[j][l] * vInverse[l];
+                    }
+                }
+
+                //Eigenpair check, then the scalar solver for the lanes that failed
+                LaneVector Mv;
+                Multiply(batch.M, v, Mv);
+                for(auto l = 0; l < LANE_COUNT; ++l)
+                {
+                    if(!batch.Active[l]) continue;
+
+                    auto M = GetLaneMatrix(batch.M, l);
+                    auto vectorV = GetLaneVector(v, l);
+                    auto vectorMv = GetLaneVector(Mv, l);
+                    if(batch.CholeskySucceeded[l] && liftedSucceeded[l] && (vectorMv - vectorV.dot(vectorMv) * vectorV).norm() <= 1e-8 * M.norm()) continue;
+
+                    auto lane = MatrixUtility::GetTruncatedInverse<7>(M, GetLaneVector(batch.Theta, l));
+                    for(auto j = 0; j < 7; ++j)
+                    {
+                        for(auto k = 0; k < 7; ++k) Mi[j][k][l] = lane(j, k);
+                    }
+                }
+            }
+
+            //N = 1/n * sum(W * (V0 + 2S[zeta * e^t])) - 1/n^2 * sum(W^2 * ((zeta, Mi * zeta) * V0 + 2S[V0 * Mi * zeta * zeta^t]))
+            //2S[V0 * Mi * zeta * zeta^t] = p * zeta^t + zeta * p^t with p = V0 * Mi * zeta
+            inline void CalcN(LaneBatch& batch, const WindowGeometry& geometry)
+            {
+                LaneMatrix Mi;
+                CalcMi6(batch, Mi);
+
+                LaneMatrix N1;
+                LaneMatrix N2;
+                for(auto j = 0; j < 7; ++j)
+                {
+                    for(auto k = 0; k <= j; ++k)
+                    {
+                        for(auto l = 0; l < LANE_COUNT; ++l)
+                        {
+                            N1[j][k][l] = 0;
+                            N2[j][k][l] = 0;
+                        }
+                    }
+                }
+
+                //Δ2がσ^2で残るところのみ
+                const double e[7] = { 1, 0, 1, 0, 0, 0, 0 };
+
+                for(auto i = 0; i < POINT_COUNT; ++i)
+                {
+                    const auto& weights = batch.Weights[i];
+
+                    LaneVector zeta;
+                    LaneVector u;
+                    LaneVector p;
+                    LaneValue zetaMiZeta;
+                    GetZeta(batch, geometry, i, zeta);
+                    Multiply(Mi, zeta, u);
+                    Dot(zeta, u, zetaMiZeta);
+
+                    for(auto j = 0; j < 7; ++j)
+                    {
+                        for(auto l = 0; l < LANE_COUNT; ++l) p[j][l] = 0;
+                        for(auto k = 0; k < 7; ++k)
+                        {
+                            const auto variance0 = geometry.Variance0Matrix[i][j][k];
+                            if(variance0 == 0) continue;
+
+                            #pragma omp simd
+                            for(auto l = 0; l < LANE_COUNT; ++l) p[j][l] += variance0 * u[k][l];
+                        }
+                    }
+
+                    for(auto j = 0; j < 7; ++j)
+                    {
+                        for(auto k = 0; k <= j; ++k)
+                        {
+                            const auto variance0 = geometry.Variance0Matrix[i][j][k];
+
+                            #pragma omp simd
+                            for(auto l = 0; l < LANE_COUNT; ++l)
+                            {
+                                N1[j][k][l] += weights[l] * (variance0 + zeta[j][l] * e[k] + e[j] * zeta[k][l]);
+                                N2[j][k][l] += weights[l] * weights[l] * (zetaMiZeta[l] * variance0 + p[j][l] * zeta[k][l] + zeta[j][l] * p[k][l]);
+                            }
+                        }
+                    }
+                }
+
+                for(auto j = 0; j < 7; ++j)
+                {
+                    for(auto k = 0; k <= j; ++k)
+                    {
+                        for(auto l = 0; l < LANE_COUNT; ++l)
+                        {
+                            batch.N[j][k][l] = N1[j][k][l] / POINT_COUNT - N2[j][k][l] / (POINT_COUNT * POINT_COUNT);
+                            batch.N[k][j][l] = batch.N[j][k][l];
+                        }
+                    }
+                }
+            }
+
+        public:
+            explicit SimdHyperEllipseDenoiseDataRepository(const DenoiseSetting& setting = DenoiseSetting()) : SimdEllipseDenoiseDataRepositoryBase<SimdHyperEllipseDenoiseDataRepository>(setting)
+            {
+            }
+            virtual ~SimdHyperEllipseDenoiseDataRepository() = default;
+        };
+    }
+}
@@ -0,0 +1,2 @@
+
+#include "StratifiedSamplingPhongModelLightDirectionDataRepository.hpp"
\ No newline at end of file
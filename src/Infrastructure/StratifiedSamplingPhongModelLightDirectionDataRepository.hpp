@@ -0,0 +1,160 @@
+#pragma once
+
+#include "PhongModelLightDirectionDataRepository.hpp"
+
+#include <random>
+
+namespace ImageInformationAnalyzer
+{
+    namespace Infrastructure
+    {
+        using namespace Domain;
+
+        class StratifiedSamplingPhongModelLightDirectionDataRepository : public PhongModelLightDirectionDataRepository
+        {
+            enum
+            {
+                STRATUM_SIZE = 16
+            };
+
+        protected:
+            inline std::vector<std::vector<double>> GetGradientMagnitude(const int width, const int height, const std::vector<std::vector<double>>& averageImageBuffer)
+            {
+                std::vector<std::vector<double>> gradientBuffer;
+                gradientBuffer.resize(height);
+
+                for(auto y = 0; y < height; ++y)
+                {
+                    gradientBuffer[y].resize(width);
+                    for(auto x = 0; x < width; ++x)
+                    {
+                        auto left = averageImageBuffer[y][std::max(x - 1, 0)];
+                        auto right = averageImageBuffer[y][std::min(x + 1, width - 1)];
+                        auto top = averageImageBuffer[std::max(y - 1, 0)][x];
+                        auto bottom = averageImageBuffer[std::min(y + 1, height - 1)][x];
+
+                        gradientBuffer[y][x] = std::sqrt((right - left) * (right - left) + (bottom - top) * (bottom - top)) / 2;
+                    }
+                }
+                return gradientBuffer;
+            }
+
+            //Pixels of each stratum ordered by a weighted random key (Efraimidis-Spirakis)
+            //Any prefix is a gradient weighted sample, so the subsets of the refinement levels are nested
+            inline std::vector<std::vector<std::tuple<int, int>>> GetStrata(const int width, const int height, const std::vector<std::vector<double>>& gradientBuffer)
+            {
+                const auto stratumCountX = (width + STRATUM_SIZE - 1) / STRATUM_SIZE;
+                const auto stratumCountY = (height + STRATUM_SIZE - 1) / STRATUM_SIZE;
+
+                //flat regions must still be sampled
+                auto meanGradient = 0.0;
+                for(const auto& line : gradientBuffer)
+                {
+                    for(auto value : line)
+                    {
+                        meanGradient += value;
+                    }
+                }
+                meanGradient = meanGradient / ((double)width * height) + 1e-10;
+
+                //Strata outside of the mask are left empty and removed at the end
+                std::vector<std::vector<std::tuple<int, int>>> strata;
+                strata.resize((size_t)stratumCountX * stratumCountY);
+
+                std::vector<int> stratumIndices(strata.size());
+                std::iota(stratumIndices.begin(), stratumIndices.end(), 0);
+
+                std::for_each(std::execution::par, stratumIndices.begin(), stratumIndices.end(), [&](const int index)
+                {
+                    const auto startX = (index % stratumCountX) * STRATUM_SIZE;
+                    const auto startY = (index / stratumCountX) * STRATUM_SIZE;
+
+                    //deterministic for each stratum
+                    std::mt19937 engine(index);
+                    std::uniform_real_distribution<double> distribution(0.0, 1.0);
+
+                    std::vector<std::tuple<double, int, int>> keys;
+                    for(auto y = startY; y < std::min(startY + STRATUM_SIZE, height); ++y)
+                    {
+                        for(auto x = startX; x < std::min(startX + STRATUM_SIZE, width); ++x)
+                        {
+                            if(!IsInsideMask(mask_, x, y)) continue;
+
+                            auto weight = gradientBuffer[y][x] + meanGradient;
+                            auto key = std::log(1.0 - distribution(engine)) / weight;
+                            keys.push_back(std::tuple(key, x, y));
+                        }
+                    }
+                    std::sort(keys.begin(), keys.end(), [](const auto& a, const auto& b) { return std::get<0>(a) > std::get<0>(b); });
+
+                    for(const auto& key : keys)
+                    {
+                        strata[index].push_back(std::tuple(std::get<1>(key), std::get<2>(key)));
+                    }
+                });
+                strata.erase(std::remove_if(strata.begin(), strata.end(), [](const auto& stratum) { return stratum.empty(); }), strata.end());
+
+                return strata;
+            }
+
+            static inline void PrintParameters(const std::string& title, const Eigen::Vector2d& light, const Eigen::Vector2d& coef, const double costPerPixel)
+            {
+                std::cout << title << ": light("s << light.x() << ", "s << light.y() << "), coef("s << coef.x() << ", "s << coef.y() << "), cost/pixel: "s << costPerPixel << std::endl;
+            }
+
+            virtual void EstimateParameters(const int width, const int height, const std::vector<std::vector<double>>& averageImageBuffer, const std::vector<std::vector<Eigen::Vector3d>>& averageNormalBuffer, const FloatingPointImageData* differentialB_G, const double pixelPitch, Eigen::Vector2d& resultLight, Eigen::Vector2d& resultCoef, std::atomic<double>* progress) override
+            {
+                auto gradientBuffer = GetGradientMagnitude(width, height, averageImageBuffer);
+                auto strata = GetStrata(width, height, gradientBuffer);
+
+                //Progressive refinement with warm start
+                auto ratio = setting_.InitialSampleRatio;
+                for(auto level = 0;; ++level)
+                {
+                    std::vector<Point3D> data;
+                    data.reserve((size_t)(ratio * width * height) + strata.size());
+                    for(const auto& stratum : strata)
+                    {
+                        auto count = std::clamp((size_t)std::ceil(ratio * stratum.size()), (size_t)1, stratum.size());
+                        for(auto i = 0; i < count; ++i)
+                        {
+                            data.push_back(GetPoint(std::get<0>(stratum[i]), std::get<1>(stratum[i]), width, height, averageImageBuffer, averageNormalBuffer, differentialB_G->ImageBuffer, pixelPitch));
+                        }
+                    }
+
+                    Eigen::Vector2d previousLight = resultLight;
+                    Eigen::Vector2d previousCoef = resultCoef;
+
+                    //Only the first level needs to search for the basin
+                    auto summary = Solve(data, resultLight, resultCoef, progress, level == 0 ? GetStartCount() : 1);
+
+                    auto change = (resultLight - previousLight).lpNorm<1>() + (resultCoef - previousCoef).lpNorm<1>();
+                    std::cout << "Sampling level "s << level << ": "s << data.size() << " pixels, cost/pixel: "s << summary.final_cost / data.size() << ", change: "s << change << std::endl;
+
+                    if(level > 0 && change < setting_.StableThreshold) break;
+                    if(ratio >= setting_.MaxSampleRatio) break;
+
+                    ratio = std::min(ratio * 2, setting_.MaxSampleRatio);
+                }
+
+                //Report against the whole image
+                auto wholeData = GetPoints(width, height, averageImageBuffer, averageNormalBuffer, differentialB_G->ImageBuffer, pixelPitch, mask_);
+                PrintParameters("Sampled fit"s, resultLight, resultCoef, EvaluateCost(wholeData, resultLight, resultCoef) / wholeData.size());
+
+                if(setting_.CompareWithWholePixel)
+                {
+                    Eigen::Vector2d wholeLight(0, 0);
+                    Eigen::Vector2d wholeCoef(0, 0);
+                    Solve(wholeData, wholeLight, wholeCoef, progress, setting_.MultiStartCount);
+                    PrintParameters("Whole pixel fit"s, wholeLight, wholeCoef, EvaluateCost(wholeData, wholeLight, wholeCoef) / wholeData.size());
+                }
+            }
+
+        public:
+            explicit StratifiedSamplingPhongModelLightDirectionDataRepository(const LightEstimationSetting& setting) : PhongModelLightDirectionDataRepository(setting)
+            {
+            }
+            virtual ~StratifiedSamplingPhongModelLightDirectionDataRepository() = default;
+        };
+    }
+}
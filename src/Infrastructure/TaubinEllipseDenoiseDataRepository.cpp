@@ -0,0 +1 @@
+#include "TaubinEllipseDenoiseDataRepository.hpp"
@@ -0,0 +1,53 @@
+#pragma once
+
+#include "FloatingPointImageData.hpp"
+#include "EllipseDenoiseDataRepository.hpp"
+
+namespace ImageInformationAnalyzer
+{
+    namespace Infrastructure
+    {
+        using namespace Domain;
+
+        //Closed form (Taubin) fit of the same conic: one generalized eigenproblem per pixel
+        //It equals the first renormalization step with unit weights
+        class TaubinEllipseDenoiseDataRepository : public EllipseDenoiseDataRepositoryBase<TaubinEllipseDenoiseDataRepository>
+        {
+            friend class EllipseDenoiseDataRepositoryBase<TaubinEllipseDenoiseDataRepository>;
+
+        protected:
+            //Not iterative, the tier does not matter
+            inline bool Renormalize(Eigen::Matrix<double, 7, 1>& theta0, const std::vector<ImagePointEllipse>& windowPoints, const bool)
+            {
+                //M = 1/n * sum(zeta * zeta^t)
+                Eigen::Matrix<double, 7, 7> M = Eigen::Matrix<double, 7, 7>().Zero();
+                for(auto i = 0; i < windowPoints.size(); i++)
+                {
+                    M += windowPoints[i].ZetaMatrix;
+                }
+                M = M / windowPoints.size();
+
+                //N = 1/n * sum(V0)
+                Eigen::Matrix<double, 7, 7> N = Eigen::Matrix<double, 7, 7>().Zero();
+                for(auto i = 0; i < windowPoints.size(); ++i)
+                {
+                    N += windowPoints[i].Variance0Matrix;
+                }
+                N = N / windowPoints.size();
+
+                //N*theta = 1/lambda * M*theta, the largest 1/lambda gives the smallest lambda
+                Eigen::GeneralizedSelfAdjointEigenSolver<Eigen::Matrix<double, 7, 7>> GES(N, M);
+                if(GES.info() != Eigen::Success) return false;
+
+                theta0 = GES.eigenvectors().col(6).normalized();
+                return true;
+            }
+
+        public:
+            explicit TaubinEllipseDenoiseDataRepository(const DenoiseSetting& setting = DenoiseSetting()) : EllipseDenoiseDataRepositoryBase(setting)
+            {
+            }
+            virtual ~TaubinEllipseDenoiseDataRepository() = default;
+        };
+    }
+}
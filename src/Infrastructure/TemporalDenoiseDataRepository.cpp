@@ -0,0 +1 @@
+#include "TemporalDenoiseDataRepository.hpp"
@@ -0,0 +1,124 @@
+#pragma once
+
+#include "FloatingPointImageData.hpp"
+#include "EllipseDenoiseDataRepository.hpp"
+#include "HyperEllipseDenoiseDataRepository.hpp"
+
+#include <chrono>
+
+namespace ImageInformationAnalyzer
+{
+    namespace Infrastructure
+    {
+        using namespace Domain;
+
+        //Frames of a video: the conic of each pixel of the previous frame is the start value of the renormalization
+        //Consecutive frames differ little, so the fit converges in a few iterations. Where it does not, the pixel is fitted again from a cold start
+        //A frame of another size (or the first one) is a cold start
+        template<typename Fitter>
+        class TemporalDenoiseDataRepository : public IDenoiseImageDataRepository
+        {
+            typedef typename Fitter::ImagePoint ImagePoint;
+            typedef Eigen::Matrix<double, 7, 1> Theta;
+            typedef std::vector<std::vector<Theta>> ThetaPlane;
+
+            Fitter fitter_;
+
+            //One plane for each Process() of a frame (channels, then passes), swapped instead of reallocated
+            std::vector<ThetaPlane> previousThetas_;
+            std::vector<ThetaPlane> currentThetas_;
+            //Process() calls of the current frame
+            size_t plane_;
+
+        public:
+            explicit TemporalDenoiseDataRepository(const DenoiseSetting& setting = DenoiseSetting()) : IDenoiseImageDataRepository(setting), fitter_(setting), plane_(0)
+            {
+            }
+            virtual ~TemporalDenoiseDataRepository() = default;
+
+            //A frame: the planes of this call take over the start values from the same planes of the previous call
+            virtual std::vector<FloatingPointImageData*> ProcessPasses(const std::vector<const FloatingPointImageData*>& data, const int passCount, std::atomic<int>* processedPixel = nullptr, ModelMaps* modelMaps = nullptr) override
+            {
+                plane_ = 0;
+                auto results = IDenoiseImageDataRepository::ProcessPasses(data, passCount, processedPixel, modelMaps);
+
+                std::swap(previousThetas_, currentThetas_);
+                currentThetas_.resize(plane_);
+                previousThetas_.resize(plane_);
+
+                return results;
+            }
+
+            virtual FloatingPointImageData* Process(const FloatingPointImageData* data, std::atomic<int>* processedPixel = nullptr) override
+            {
+                auto start = std::chrono::system_clock::now();
+
+                const auto width = data->Width;
+                const auto height = data->Height;
+                const auto plane = plane_++;
+
+                if(currentThetas_.size() <= plane) currentThetas_.resize(plane + 1);
+                auto& thetas = currentThetas_[plane];
+                if(thetas.size() != height || thetas[0].size() != width) thetas.assign(height, std::vector<Theta>(width, Theta().Zero()));
+
+                //Previous frame of the same size
+                const ThetaPlane* previous = nullptr;
+                if(previousThetas_.size() > plane && previousThetas_[plane].size() == height && previousThetas_[plane][0].size() == width) previous = &previousThetas_[plane];
+
+                auto imageBuffer = data->ImageBuffer;
+                auto normalBuffer = data->NormalBuffer;
+
+                //C++17
+                std::atomic<int> errorPixel(0);
+                std::atomic<int> coldPixel(0);
+
+                auto pixelIndices = GetMaskedPixelIndices(width, height);
+                std::for_each(std::execution::par, pixelIndices.begin(), pixelIndices.end(), [&](const int index)
+                {
+                    const auto x = index % width;
+                    const auto y = index / width;
+
+                    auto windowPoints = Misc::ImageUtility::GetWindowPoints<ImagePoint>(data, x, y, WINDOW_SIZE);
+
+                    Theta theta = previous != nullptr ? (*previous)[y][x] : Theta().Zero();
+                    auto denoisedPixel = 0.0;
+                    auto fittingError = 0.0;
+                    Eigen::Vector3d normal;
+
+                    auto succeeded = fitter_.FitWindow(windowPoints, theta, denoisedPixel, normal, fittingError, false);
+                    if(!succeeded && previous != nullptr && !(*previous)[y][x].isZero())
+                    {
+                        //The surface has changed too much, e.g. a cut
+                        coldPixel++;
+                        theta = Theta().Zero();
+                        succeeded = fitter_.FitWindow(windowPoints, theta, denoisedPixel, normal, fittingError, false);
+                    }
+                    if(!succeeded)
+                    {
+                        errorPixel++;
+                        theta = Theta().Zero();
+                    }
+
+                    imageBuffer[y][x] = denoisedPixel;
+                    normalBuffer[y][x] = normal;
+                    thetas[y][x] = theta;
+
+                    if(processedPixel != nullptr) (*processedPixel)++;
+                });
+
+                auto end = std::chrono::system_clock::now();
+
+                if(!quiet_)
+                {
+                    std::cout << "Temporal plane "s << plane << ": "s << (previous != nullptr ? "warm"s : "cold"s) << " start, "s << std::chrono::duration_cast<std::chrono::milliseconds>(end - start).count() << "ms, cold retry: "s << coldPixel << std::endl;
+                    std::cout << "Error Pixel: "s << errorPixel << std::endl;
+                }
+
+                return new FloatingPointImageData(width, height, imageBuffer, normalBuffer);
+            }
+        };
+
+        typedef TemporalDenoiseDataRepository<EllipseDenoiseDataRepository> TemporalEllipseDenoiseDataRepository;
+        typedef TemporalDenoiseDataRepository<HyperEllipseDenoiseDataRepository> TemporalHyperEllipseDenoiseDataRepository;
+    }
+}
@@ -0,0 +1 @@
+#include "VideoFrameSourceDataRepository.hpp"
@@ -0,0 +1,122 @@
+#pragma once
+
+#include "FrameSourceData.hpp"
+
+#include <algorithm>
+#include <filesystem>
+#include <stdexcept>
+#include <opencv2/opencv.hpp>
+
+namespace ImageInformationAnalyzer
+{
+    namespace Infrastructure
+    {
+        using namespace Domain;
+        using namespace std::literals::string_literals;
+
+        //cv::VideoCapture for video files (and sequence patterns such as "frame_%04d.png"), cv::imread for a directory of images in name order
+        class VideoFrameSourceDataRepository : public IFrameSourceDataRepository
+        {
+            cv::VideoCapture capture_;
+
+            //Directory source
+            std::vector<std::string> files_;
+            size_t nextFile_;
+
+            //Decoded frame, reused so that the decoder does not allocate per frame
+            cv::Mat frame_;
+
+            //R, G, B planes of the frame, reused as well
+            std::vector<std::vector<std::vector<double>>> planes_;
+            std::vector<std::vector<Eigen::Vector3d>> normalBuffer_;
+
+            inline void ReadCVMat(const cv::Mat& img)
+            {
+                auto width = img.cols;
+                auto height = img.rows;
+
+                planes_.resize(3);
+                for(auto& plane : planes_)
+                {
+                    if(plane.size() != height || plane[0].size() != width) plane.assign(height, std::vector<double>(width));
+                }
+                if(normalBuffer_.size() != height || normalBuffer_[0].size() != width) normalBuffer_.assign(height, std::vector<Eigen::Vector3d>(width, Eigen::Vector3d(0, 0, 1)));
+
+                //BGR, grayscale is spread to the three planes
+                const auto channels = img.channels();
+                for(auto y = 0; y < height; ++y)
+                {
+                    const auto* line = img.data + y * img.step;
+                    for(auto x = 0; x < width; ++x)
+                    {
+                        const auto* pixel = line + x * img.elemSize();
+                        planes_[0][y][x] = (double)pixel[channels >= 3 ? 2 : 0];
+                        planes_[1][y][x] = (double)pixel[channels >= 3 ? 1 : 0];
+                        planes_[2][y][x] = (double)pixel[0];
+                    }
+                }
+            }
+
+        public:
+            explicit VideoFrameSourceDataRepository() : nextFile_(0)
+            {
+            }
+            virtual ~VideoFrameSourceDataRepository() = default;
+
+            virtual void Open(const std::string& source) override
+            {
+                capture_.release();
+                files_.clear();
+                nextFile_ = 0;
+
+                if(std::filesystem::is_directory(source))
+                {
+                    for(const auto& entry : std::filesystem::directory_iterator(source))
+                    {
+                        if(!entry.is_regular_file()) continue;
+
+                        auto extension = entry.path().extension().string();
+                        std::transform(extension.begin(), extension.end(), extension.begin(), [](unsigned char c) { return (char)std::tolower(c); });
+                        if(extension == ".jpg"s || extension == ".jpeg"s || extension == ".png"s || extension == ".bmp"s) files_.push_back(entry.path().string());
+                    }
+                    std::sort(files_.begin(), files_.end());
+                    if(files_.empty()) throw std::invalid_argument("no frames in "s + source);
+                    return;
+                }
+
+                if(!capture_.open(source)) throw std::invalid_argument("cannot open the video: "s + source);
+            }
+
+            virtual std::vector<FloatingPointImageData*> Read() override
+            {
+                if(!files_.empty())
+                {
+                    if(nextFile_ >= files_.size()) return {};
+
+                    const auto& file = files_[nextFile_++];
+                    frame_ = cv::imread(file);
+                    if(frame_.empty()) throw std::invalid_argument("file not found!: "s + file);
+                }
+                else if(!capture_.isOpened() || !capture_.read(frame_) || frame_.empty())
+                {
+                    return {};
+                }
+
+                if(frame_.depth() != CV_8U) throw std::invalid_argument("8 bit frames only");
+                ReadCVMat(frame_);
+
+                std::vector<FloatingPointImageData*> channels;
+                for(const auto& plane : planes_)
+                {
+                    channels.push_back(new FloatingPointImageData(frame_.cols, frame_.rows, plane, normalBuffer_));
+                }
+                return channels;
+            }
+
+            virtual double GetFrameRate() const override
+            {
+                return files_.empty() && capture_.isOpened() ? capture_.get(cv::CAP_PROP_FPS) : 0.0;
+            }
+        };
+    }
+}
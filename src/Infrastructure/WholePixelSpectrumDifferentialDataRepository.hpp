@@ -19,10 +19,17 @@ namespace ImageInformationAnalyzer
             explicit WholePixelSpectrumDifferentialDataRepository() = default;
             virtual ~WholePixelSpectrumDifferentialDataRepository() = default;
 
+            //The window is the biggest square of the image
+            virtual int GetWindowRadius() const override
+            {
+                return -1;
+            }
+
             virtual FloatingPointImageData* Process(const FloatingPointImageData* data1, const FloatingPointImageData* data2, std::atomic<int>* processedPixel = nullptr) override
             {
                 auto width = data1->Width;
                 auto height = data1->Height;
+                if(mask_ != nullptr && (mask_->Width != width || mask_->Height != height)) throw std::invalid_argument("mask must have the same size as the image");
 
                 //Prepare buffers
                 std::vector<std::vector<double>> imageBuffer;
@@ -44,8 +51,26 @@ namespace ImageInformationAnalyzer
                 windowSize = windowSize % 2 == 0 ? windowSize - 1 : windowSize;//must be odd
                 auto centerX = width / 2 + 1;
                 auto centerY = height / 2 + 1;
-                auto window1 = ImageUtility::GetWindowPoints<ImageUtility::ImagePointBase>(data1, centerX, centerY, windowSize);
-                auto window2 = ImageUtility::GetWindowPoints<ImageUtility::ImagePointBase>(data2, centerX, centerY, windowSize);
+                auto window1 = std::vector<ImageUtility::ImagePointBase>();
+                auto window2 = std::vector<ImageUtility::ImagePointBase>();
+                if(mask_ == nullptr)
+                {
+                    window1 = ImageUtility::GetWindowPoints<ImageUtility::ImagePointBase>(data1, centerX, centerY, windowSize);
+                    window2 = ImageUtility::GetWindowPoints<ImageUtility::ImagePointBase>(data2, centerX, centerY, windowSize);
+                }
+                else
+                {
+                    //The mask may lie anywhere, so all of its pixels make the window
+                    for(auto y = 0; y < height; ++y)
+                    {
+                        for(auto x = 0; x < width; ++x)
+                        {
+                            if(!mask_->IsInside(x, y)) continue;
+                            window1.push_back({ x, y, 0, 0, data1->ImageBuffer[y][x] });
+                            window2.push_back({ x, y, 0, 0, data2->ImageBuffer[y][x] });
+                        }
+                    }
+                }
 
                 //2つのピクセル差分 {S1 - (a*S2 + b)}^2 を最小化する係数a, bを探す
                 auto coef = GetBalanceCoefficient(window1, window2);
@@ -60,6 +85,8 @@ namespace ImageInformationAnalyzer
                 {
                     for(auto x = 0; x < width; ++x)
                     {
+                        if(!IsInsideMask(mask_, x, y)) continue;
+
                         auto image1Pixel = data1->ImageBuffer[y][x];
                         auto image2Pixel = data2->ImageBuffer[y][x];
 
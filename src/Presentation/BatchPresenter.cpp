@@ -0,0 +1 @@
+#include "BatchPresenter.hpp"
@@ -0,0 +1,494 @@
+#pragma once
+
+#include "DenoiseImageService.hpp"
+#include "ImageEvaluationService.hpp"
+#include "ImageFileService.hpp"
+#include "ScaleImageService.hpp"
+#include "TakeDifferenceService.hpp"
+
+#include <array>
+#include <condition_variable>
+#include <deque>
+#include <filesystem>
+#include <fstream>
+#include <functional>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <algorithm>
+#include <iostream> //std::cout
+
+namespace ImageInformationAnalyzer
+{
+    namespace Presentation
+    {
+        using namespace Application;
+
+        struct BatchSetting
+        {
+            //Denoise mode and its setting
+            DenoiseImageService::Mode DenoiseMode = DenoiseImageService::Mode::ELLIPSE;
+            DenoiseSetting Denoise;
+            //Denoise passes without intermediate images
+            int PassCount = 1;
+            //Evaluation of the denoised image against the input
+            ImageEvaluationService::Mode EvaluationMode = ImageEvaluationService::Mode::PSNR;
+            //Differential B-R, stored next to the denoised image
+            bool TakeDifference = true;
+            TakeDifferenceService::Mode DifferenceMode = TakeDifferenceService::Mode::WholePixel;
+            //Images computed at the same time, also the capacity of the queues between the stages
+            int ImagesInFlight = 2;
+            //Results and timing.csv
+            std::string OutputDirectory = "batch_output";
+        };
+
+        //Blocking queue between two pipeline stages
+        template<typename T>
+        class BoundedQueue
+        {
+            std::deque<T> items_;
+            const size_t capacity_;
+            bool closed_;
+
+            std::mutex mutex_;
+            std::condition_variable notFull_;
+            std::condition_variable notEmpty_;
+
+        public:
+            explicit BoundedQueue(const size_t capacity) : capacity_(std::max(capacity, (size_t)1)), closed_(false)
+            {
+            }
+            virtual ~BoundedQueue() = default;
+
+            //Blocks while the queue is full
+            void Push(T item)
+            {
+                std::unique_lock<std::mutex> lock(mutex_);
+                notFull_.wait(lock, [&] { return items_.size() < capacity_ || closed_; });
+                if(closed_) throw std::logic_error("queue is closed");
+
+                items_.push_back(std::move(item));
+                notEmpty_.notify_one();
+            }
+
+            //Blocks while the queue is empty, false once it is closed and drained
+            bool Pop(T& item)
+            {
+                std::unique_lock<std::mutex> lock(mutex_);
+                notEmpty_.wait(lock, [&] { return !items_.empty() || closed_; });
+                if(items_.empty()) return false;
+
+                item = std::move(items_.front());
+                items_.pop_front();
+                notFull_.notify_one();
+                return true;
+            }
+
+            //No more items, the consumers finish what is left
+            void Close()
+            {
+                std::lock_guard<std::mutex> lock(mutex_);
+                closed_ = true;
+                notFull_.notify_all();
+                notEmpty_.notify_all();
+            }
+        };
+
+        //One image through the pipeline
+        struct BatchItem
+        {
+            int Index = 0;
+            std::string FilePath;
+
+            //R, G, B scaled to [0, 1]
+            std::vector<std::unique_ptr<FloatingPointImageData>> Channels;
+            std::vector<std::unique_ptr<FloatingPointImageData>> Denoised;
+            std::unique_ptr<FloatingPointImageData> DifferentialB_R;
+            std::array<double, 3> Evaluations = { 0, 0, 0 };
+
+            long long DecodeMilliseconds = 0;
+            long long DenoiseMilliseconds = 0;
+            long long DifferenceMilliseconds = 0;
+            long long EvaluationMilliseconds = 0;
+            long long EncodeMilliseconds = 0;
+
+            //Empty unless a stage failed, the later stages skip the item
+            std::string Error;
+        };
+
+        //Headless counterpart of ImageInformationPresenter: no window, results go to files
+        //Each instance owns its services, so that several images can be computed at the same time
+        class BatchPresenter
+        {
+            const BatchSetting setting_;
+
+            DenoiseImageService denoiseService_;
+            ImageFileService imageFileService_;
+            ScaleImageService scaleImageService_;
+            ImageEvaluationService imageEvaluationService_;
+            TakeDifferenceService takeDifferenceService_;
+
+            static inline long long GetMilliseconds(const std::chrono::system_clock::time_point& start)
+            {
+                return std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::system_clock::now() - start).count();
+            }
+
+            std::string GetOutputPath(const BatchItem& item, const std::string& suffix) const
+            {
+                auto stem = std::filesystem::path(item.FilePath).stem().string();
+                return (std::filesystem::path(setting_.OutputDirectory) / (stem + suffix + ".png"s)).string();
+            }
+
+        public:
+            explicit BatchPresenter(const BatchSetting& setting) : setting_(setting), denoiseService_(setting.DenoiseMode, setting.Denoise), imageEvaluationService_(setting.EvaluationMode), takeDifferenceService_(setting.DifferenceMode)
+            {
+            }
+
+            //Reads the file and scales it to [0, 1] like ImageInformationPresenter::Scale()
+            void Decode(BatchItem& item)
+            {
+                auto start = std::chrono::system_clock::now();
+                try
+                {
+                    std::vector<std::unique_ptr<FloatingPointImageData>> channels;
+                    for(auto channel : imageFileService_.Load(item.FilePath))
+                    {
+                        channels.emplace_back(channel);
+                    }
+                    for(const auto& channel : channels)
+                    {
+                        item.Channels.emplace_back(scaleImageService_.Process(channel.get(), 0.0, 255.0, 0.0, 1.0));
+                    }
+                }
+                catch(const std::exception& e)
+                {
+                    item.Error = e.what();
+                }
+                item.DecodeMilliseconds = GetMilliseconds(start);
+            }
+
+            //progress receives the denoise percentage
+            void Compute(BatchItem& item, const std::function<void(double)>& progress = nullptr)
+            {
+                if(!item.Error.empty()) return;
+
+                try
+                {
+                    auto start = std::chrono::system_clock::now();
+                    denoiseService_.SetProgressCallback(progress);
+                    auto denoised = denoiseService_.Process({ item.Channels[0].get(), item.Channels[1].get(), item.Channels[2].get() }, setting_.PassCount);
+                    denoiseService_.SetProgressCallback(nullptr);
+                    for(auto channel : denoised)
+                    {
+                        item.Denoised.emplace_back(channel);
+                    }
+                    item.DenoiseMilliseconds = GetMilliseconds(start);
+
+                    //denoisedをoriginalだとして計算
+                    start = std::chrono::system_clock::now();
+                    for(auto c = 0; c < 3; ++c)
+                    {
+                        std::unique_ptr<ImageEvaluationData> evaluation(imageEvaluationService_.Process(item.Denoised[c].get(), item.Channels[c].get(), 1.0));
+                        item.Evaluations[c] = evaluation->Result;
+                    }
+                    item.EvaluationMilliseconds = GetMilliseconds(start);
+
+                    if(setting_.TakeDifference)
+                    {
+                        start = std::chrono::system_clock::now();
+                        item.DifferentialB_R.reset(takeDifferenceService_.Process(item.Denoised[2].get(), item.Denoised[0].get()));
+                        item.DifferenceMilliseconds = GetMilliseconds(start);
+                    }
+                }
+                catch(const std::exception& e)
+                {
+                    denoiseService_.SetProgressCallback(nullptr);
+                    item.Error = e.what();
+                }
+            }
+
+            //Denoised RGB and the differential stretched to its range, both 8 bit
+            void Encode(BatchItem& item)
+            {
+                if(!item.Error.empty()) return;
+
+                auto start = std::chrono::system_clock::now();
+                try
+                {
+                    std::vector<std::unique_ptr<FloatingPointImageData>> denoised;
+                    for(const auto& channel : item.Denoised)
+                    {
+                        denoised.emplace_back(scaleImageService_.Process(channel.get(), 0.0, 1.0, 0.0, 255.0));
+                    }
+                    imageFileService_.Store(denoised[0].get(), denoised[1].get(), denoised[2].get(), GetOutputPath(item, "_denoised"s));
+
+                    if(item.DifferentialB_R != nullptr)
+                    {
+                        const auto* differential = item.DifferentialB_R.get();
+                        std::unique_ptr<FloatingPointImageData> scaled(scaleImageService_.Process(differential, differential->GetMinValue(), differential->GetMaxValue(), 0.0, 255.0));
+                        imageFileService_.Store(scaled.get(), scaled.get(), scaled.get(), GetOutputPath(item, "_B-R"s));
+                    }
+                }
+                catch(const std::exception& e)
+                {
+                    item.Error = e.what();
+                }
+                item.EncodeMilliseconds = GetMilliseconds(start);
+            }
+
+            static std::string GetCsvHeader()
+            {
+                return "index,file,width,height,decode_ms,denoise_ms,evaluation_ms,difference_ms,encode_ms,evaluation_r,evaluation_g,evaluation_b,status"s;
+            }
+
+            static std::string GetCsvLine(const BatchItem& item)
+            {
+                auto width = item.Channels.empty() ? 0 : item.Channels[0]->Width;
+                auto height = item.Channels.empty() ? 0 : item.Channels[0]->Height;
+
+                //Commas would break the columns
+                auto status = item.Error.empty() ? "ok"s : item.Error;
+                std::replace(status.begin(), status.end(), ',', ';');
+
+                std::ostringstream line;
+                line << std::setprecision(8) << item.Index << ",\""s << item.FilePath << "\","s << width << ","s << height << ","s
+                    << item.DecodeMilliseconds << ","s << item.DenoiseMilliseconds << ","s << item.EvaluationMilliseconds << ","s << item.DifferenceMilliseconds << ","s << item.EncodeMilliseconds << ","s
+                    << item.Evaluations[0] << ","s << item.Evaluations[1] << ","s << item.Evaluations[2] << ","s << status;
+                return line.str();
+            }
+
+            //Image files of a directory (sorted), or the lines of a list file
+            static std::vector<std::string> GetInputFiles(const std::string& input)
+            {
+                std::vector<std::string> files;
+                if(std::filesystem::is_directory(input))
+                {
+                    for(const auto& entry : std::filesystem::directory_iterator(input))
+                    {
+                        if(!entry.is_regular_file()) continue;
+
+                        auto extension = entry.path().extension().string();
+                        std::transform(extension.begin(), extension.end(), extension.begin(), [](unsigned char c) { return (char)std::tolower(c); });
+                        if(extension == ".jpg"s || extension == ".jpeg"s || extension == ".png"s || extension == ".bmp"s) files.push_back(entry.path().string());
+                    }
+                    std::sort(files.begin(), files.end());
+                    return files;
+                }
+
+                std::ifstream list(input);
+                if(!list) throw std::invalid_argument("input not found!: "s + input);
+
+                std::string line;
+                while(std::getline(list, line))
+                {
+                    line.erase(std::remove(line.begin(), line.end(), '\r'), line.end());
+                    if(!line.empty() && line[0] != '#') files.push_back(line);
+                }
+                return files;
+            }
+
+            //DenoiseImageService::Mode by its name
+            static DenoiseImageService::Mode GetDenoiseMode(const std::string& name)
+            {
+                static const std::map<std::string, DenoiseImageService::Mode> denoiseModes =
+                {
+                    { "CIRCLE"s, DenoiseImageService::Mode::CIRCLE },
+                    { "TAUBIN_ELLIPSE"s, DenoiseImageService::Mode::TAUBIN_ELLIPSE },
+                    { "ELLIPSE"s, DenoiseImageService::Mode::ELLIPSE },
+                    { "HYPER_ELLIPSE"s, DenoiseImageService::Mode::HYPER_ELLIPSE },
+                    { "ELLIPSE_SIMD"s, DenoiseImageService::Mode::ELLIPSE_SIMD },
+                    { "HYPER_ELLIPSE_SIMD"s, DenoiseImageService::Mode::HYPER_ELLIPSE_SIMD },
+                    { "ADAPTIVE_ELLIPSE"s, DenoiseImageService::Mode::ADAPTIVE_ELLIPSE },
+                    { "ADAPTIVE_HYPER_ELLIPSE"s, DenoiseImageService::Mode::ADAPTIVE_HYPER_ELLIPSE },
+                    { "PYRAMID_ELLIPSE"s, DenoiseImageService::Mode::PYRAMID_ELLIPSE },
+                    { "PYRAMID_HYPER_ELLIPSE"s, DenoiseImageService::Mode::PYRAMID_HYPER_ELLIPSE },
+                    { "GUIDED_FILTER"s, DenoiseImageService::Mode::GUIDED_FILTER },
+                    { "GRID_BILATERAL"s, DenoiseImageService::Mode::GRID_BILATERAL },
+                    { "ANYTIME_ELLIPSE"s, DenoiseImageService::Mode::ANYTIME_ELLIPSE },
+                    { "ANYTIME_HYPER_ELLIPSE"s, DenoiseImageService::Mode::ANYTIME_HYPER_ELLIPSE },
+                    { "TEMPORAL_ELLIPSE"s, DenoiseImageService::Mode::TEMPORAL_ELLIPSE },
+                    { "TEMPORAL_HYPER_ELLIPSE"s, DenoiseImageService::Mode::TEMPORAL_HYPER_ELLIPSE }
+                };
+
+                if(denoiseModes.count(name) == 0) throw std::invalid_argument("unknown denoise mode: "s + name);
+                return denoiseModes.at(name);
+            }
+
+            //"key = value" lines, # starts a comment. Unknown keys are errors
+            //The keys that are not given keep the value of setting
+            static BatchSetting ReadSetting(std::istream& stream, BatchSetting setting = BatchSetting())
+            {
+                std::string line;
+                while(std::getline(stream, line))
+                {
+                    line = line.substr(0, line.find('#'));
+                    auto separator = line.find('=');
+                    if(separator == std::string::npos) continue;
+
+                    auto trim = [](const std::string& text)
+                    {
+                        auto begin = text.find_first_not_of(" \t\r");
+                        auto end = text.find_last_not_of(" \t\r");
+                        return begin == std::string::npos ? ""s : text.substr(begin, end - begin + 1);
+                    };
+                    auto key = trim(line.substr(0, separator));
+                    auto value = trim(line.substr(separator + 1));
+
+                    if(key == "denoise"s) setting.DenoiseMode = GetDenoiseMode(value);
+                    else if(key == "passes"s) setting.PassCount = std::stoi(value);
+                    else if(key == "tile_size"s) setting.Denoise.TileSize = std::stoi(value);
+                    else if(key == "two_tier"s) setting.Denoise.TwoTierScheduling = value == "true"s;
+                    else if(key == "time_budget"s) setting.Denoise.TimeBudget = std::stod(value);
+                    else if(key == "evaluation"s)
+                    {
+                        if(value != "PSNR"s && value != "SSIM"s) throw std::invalid_argument("unknown evaluation: "s + value);
+                        setting.EvaluationMode = value == "PSNR"s ? ImageEvaluationService::Mode::PSNR : ImageEvaluationService::Mode::SSIM;
+                    }
+                    else if(key == "difference"s)
+                    {
+                        if(value != "none"s && value != "WholePixel"s && value != "EachPixel"s) throw std::invalid_argument("unknown difference: "s + value);
+                        setting.TakeDifference = value != "none"s;
+                        setting.DifferenceMode = value == "EachPixel"s ? TakeDifferenceService::Mode::EachPixel : TakeDifferenceService::Mode::WholePixel;
+                    }
+                    else if(key == "in_flight"s) setting.ImagesInFlight = std::max(std::stoi(value), 1);
+                    else if(key == "output"s) setting.OutputDirectory = value;
+                    else throw std::invalid_argument("unknown setting: "s + key);
+                }
+                return setting;
+            }
+
+            static BatchSetting ReadSetting(const std::string& filePath)
+            {
+                std::ifstream file(filePath);
+                if(!file) throw std::invalid_argument("setting file not found!: "s + filePath);
+
+                return ReadSetting(file);
+            }
+
+            //One line form of the setting file, "key=value;key=value"
+            static BatchSetting ReadSpec(const std::string& spec, const BatchSetting& setting = BatchSetting())
+            {
+                auto lines = spec;
+                std::replace(lines.begin(), lines.end(), ';', '\n');
+
+                std::istringstream stream(lines);
+                return ReadSetting(stream, setting);
+            }
+
+            //Decode -> compute -> encode, one thread per stage and ImagesInFlight compute threads
+            //next() fills Index and FilePath of the following item and returns false at the end, completed() is called on the encode thread
+            //Returns the number of failed images
+            static int Run(const BatchSetting& setting, const std::function<bool(BatchItem&)>& next, const std::function<void(const BatchItem&)>& completed)
+            {
+                std::filesystem::create_directories(setting.OutputDirectory);
+
+                const auto inFlight = (size_t)setting.ImagesInFlight;
+                BoundedQueue<std::unique_ptr<BatchItem>> decodedQueue(inFlight);
+                BoundedQueue<std::unique_ptr<BatchItem>> computedQueue(inFlight);
+
+                //The file service holds no state, one presenter serves both ends
+                BatchPresenter io(setting);
+                std::vector<std::unique_ptr<BatchPresenter>> workers;
+                for(auto i = 0; i < setting.ImagesInFlight; ++i)
+                {
+                    workers.emplace_back(new BatchPresenter(setting));
+                }
+
+                auto start = std::chrono::system_clock::now();
+
+                std::thread decodeThread([&]
+                {
+                    for(;;)
+                    {
+                        std::unique_ptr<BatchItem> item(new BatchItem());
+                        if(!next(*item)) break;
+
+                        io.Decode(*item);
+                        decodedQueue.Push(std::move(item));
+                    }
+                    decodedQueue.Close();
+                });
+
+                std::atomic<int> runningWorkers(setting.ImagesInFlight);
+                std::vector<std::thread> computeThreads;
+                for(auto& worker : workers)
+                {
+                    computeThreads.emplace_back([&, presenter = worker.get()]
+                    {
+                        std::unique_ptr<BatchItem> item;
+                        while(decodedQueue.Pop(item))
+                        {
+                            presenter->Compute(*item);
+                            computedQueue.Push(std::move(item));
+                        }
+                        if(--runningWorkers == 0) computedQueue.Close();
+                    });
+                }
+
+                auto failed = 0;
+                auto completedCount = 0;
+                std::thread encodeThread([&]
+                {
+                    std::unique_ptr<BatchItem> item;
+                    while(computedQueue.Pop(item))
+                    {
+                        io.Encode(*item);
+                        completed(*item);
+
+                        completedCount++;
+                        if(!item->Error.empty()) failed++;
+
+                        //Release the planes before waiting for the next one
+                        item.reset();
+                    }
+                });
+
+                decodeThread.join();
+                for(auto& thread : computeThreads)
+                {
+                    thread.join();
+                }
+                encodeThread.join();
+
+                auto elapsedMillisecounds = GetMilliseconds(start);
+                std::cout << "Batch completed: "s << completedCount << " images, "s << failed << " failed, "s << elapsedMillisecounds << "ms ("s
+                    << std::setprecision(3) << 1000.0 * completedCount / std::max(elapsedMillisecounds, 1ll) << " images/s)"s << std::endl;
+
+                return failed;
+            }
+
+            //All the files, timing.csv in the output directory
+            static int Run(const BatchSetting& setting, const std::vector<std::string>& files)
+            {
+                std::filesystem::create_directories(setting.OutputDirectory);
+                std::ofstream csv((std::filesystem::path(setting.OutputDirectory) / "timing.csv"s).string());
+                csv << GetCsvHeader() << std::endl;
+
+                auto index = 0;
+                auto completedCount = 0;
+                return Run(setting, [&](BatchItem& item)
+                {
+                    if(index >= files.size()) return false;
+
+                    item.Index = index;
+                    item.FilePath = files[index];
+                    index++;
+                    return true;
+                }, [&](const BatchItem& item)
+                {
+                    csv << GetCsvLine(item) << std::endl;
+
+                    completedCount++;
+                    std::cout << "Batch "s << completedCount << "/"s << files.size() << ": "s << item.FilePath << (item.Error.empty() ? ""s : " failed: "s + item.Error) << std::endl;
+                });
+            }
+
+            virtual ~BatchPresenter() = default;
+        };
+    }
+}
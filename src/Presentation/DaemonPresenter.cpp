@@ -0,0 +1 @@
+#include "DaemonPresenter.hpp"
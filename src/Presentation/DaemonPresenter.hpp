@@ -0,0 +1,311 @@
+#pragma once
+
+#include "BatchPresenter.hpp"
+#include "LocalSocket.hpp"
+
+#include <atomic>
+#include <list>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+
+#include <iostream> //std::cout
+
+namespace ImageInformationAnalyzer
+{
+    namespace Presentation
+    {
+        //Line protocol between DaemonPresenter and DaemonClient, fields are separated by tabs
+        //  JOB <file> <spec>  ->  PROGRESS <percent> ..., RESULT <timing.csv line>, DONE <ms>  or  ERROR <message>
+        //  PING               ->  PONG
+        //  SHUTDOWN           ->  BYE
+        struct DaemonProtocol
+        {
+            static inline std::vector<std::string> Split(const std::string& line)
+            {
+                std::vector<std::string> fields;
+                size_t begin = 0;
+                for(;;)
+                {
+                    auto end = line.find('\t', begin);
+                    fields.push_back(line.substr(begin, end == std::string::npos ? std::string::npos : end - begin));
+                    if(end == std::string::npos) return fields;
+                    begin = end + 1;
+                }
+            }
+
+            //Tabs and line breaks would break the fields
+            static inline std::string GetField(std::string text)
+            {
+                std::replace(text.begin(), text.end(), '\t', ' ');
+                std::replace(text.begin(), text.end(), '\r', ' ');
+                std::replace(text.begin(), text.end(), '\n', ' ');
+                return text;
+            }
+        };
+
+        //Long running BatchPresenter: the services and repositories of each spec are built once and kept warm between the jobs
+        class DaemonPresenter
+        {
+            enum
+            {
+                //Pipelines kept alive, the least recently used one is released first
+                MAX_PIPELINE_COUNT = 4
+            };
+
+            //Warm services of one spec, one job at a time
+            struct Pipeline
+            {
+                std::mutex Mutex;
+                std::unique_ptr<BatchPresenter> Presenter;
+                long long LastUse = 0;
+            };
+
+            //One thread per client
+            struct Connection
+            {
+                LocalSocket Socket;
+                std::thread Thread;
+                std::atomic<bool> Finished{ false };
+            };
+
+            const std::string socketPath_;
+
+            //Keys that a spec does not give
+            const BatchSetting setting_;
+
+            std::mutex pipelineMutex_;
+            std::map<std::string, std::shared_ptr<Pipeline>> pipelines_;
+            long long useCount_;
+
+            std::atomic<int> jobCount_;
+            std::atomic<bool> stopping_;
+
+            std::shared_ptr<Pipeline> GetPipeline(const std::string& spec)
+            {
+                std::lock_guard<std::mutex> lock(pipelineMutex_);
+
+                auto found = pipelines_.find(spec);
+                if(found != pipelines_.end())
+                {
+                    found->second->LastUse = ++useCount_;
+                    return found->second;
+                }
+
+                //Bad specs throw before anything is cached
+                //The output directory is fixed when the daemon starts, a client must not write anywhere else
+                auto setting = BatchPresenter::ReadSpec(spec, setting_);
+                if(setting.OutputDirectory != setting_.OutputDirectory) throw std::invalid_argument("output can't be given in a job spec, it is fixed when the daemon starts");
+                std::filesystem::create_directories(setting.OutputDirectory);
+
+                if(pipelines_.size() >= MAX_PIPELINE_COUNT)
+                {
+                    //A job still running keeps its pipeline through the shared_ptr
+                    auto oldest = std::min_element(pipelines_.begin(), pipelines_.end(), [](const auto& a, const auto& b) { return a.second->LastUse < b.second->LastUse; });
+                    pipelines_.erase(oldest);
+                }
+
+                auto start = std::chrono::system_clock::now();
+                auto pipeline = std::make_shared<Pipeline>();
+                pipeline->Presenter.reset(new BatchPresenter(setting));
+                pipeline->LastUse = ++useCount_;
+                pipelines_[spec] = pipeline;
+
+                std::cout << "Pipeline created: "s << (spec.empty() ? "(default)"s : spec) << ", "s << std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::system_clock::now() - start).count() << "ms"s << std::endl;
+
+                return pipeline;
+            }
+
+            void ProcessJob(LocalSocket& socket, const std::string& filePath, const std::string& spec)
+            {
+                auto start = std::chrono::system_clock::now();
+
+                std::shared_ptr<Pipeline> pipeline;
+                try
+                {
+                    pipeline = GetPipeline(spec);
+                }
+                catch(const std::exception& e)
+                {
+                    socket.WriteLine("ERROR\t"s + DaemonProtocol::GetField(e.what()));
+                    return;
+                }
+
+                BatchItem item;
+                item.Index = jobCount_++;
+                item.FilePath = filePath;
+                {
+                    std::lock_guard<std::mutex> lock(pipeline->Mutex);
+
+                    auto presenter = pipeline->Presenter.get();
+                    presenter->Decode(item);
+                    presenter->Compute(item, [&](const double progress) { socket.WriteLine("PROGRESS\t"s + std::to_string(progress)); });
+                    presenter->Encode(item);
+                }
+
+                auto elapsedMillisecounds = std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::system_clock::now() - start).count();
+                std::cout << "Job "s << item.Index << ": "s << filePath << ", "s << elapsedMillisecounds << "ms"s << (item.Error.empty() ? ""s : " failed: "s + item.Error) << std::endl;
+
+                socket.WriteLine("RESULT\t"s + DaemonProtocol::GetField(BatchPresenter::GetCsvLine(item)));
+                socket.WriteLine("DONE\t"s + std::to_string(elapsedMillisecounds));
+            }
+
+            void Serve(Connection& connection)
+            {
+                auto& socket = connection.Socket;
+
+                std::string line;
+                while(!stopping_ && socket.ReadLine(line))
+                {
+                    line.erase(std::remove(line.begin(), line.end(), '\r'), line.end());
+                    auto fields = DaemonProtocol::Split(line);
+
+                    if(fields[0] == "JOB"s && fields.size() >= 2)
+                    {
+                        ProcessJob(socket, fields[1], fields.size() >= 3 ? fields[2] : ""s);
+                    }
+                    else if(fields[0] == "PING"s)
+                    {
+                        socket.WriteLine("PONG"s);
+                    }
+                    else if(fields[0] == "SHUTDOWN"s)
+                    {
+                        socket.WriteLine("BYE"s);
+                        Stop();
+                        break;
+                    }
+                    else
+                    {
+                        socket.WriteLine("ERROR\tunknown request: "s + DaemonProtocol::GetField(fields[0]));
+                    }
+                }
+                connection.Finished = true;
+            }
+
+            void Stop()
+            {
+                if(stopping_.exchange(true)) return;
+
+                //Wakes up Accept(), the loop sees stopping_ then
+                try
+                {
+                    LocalSocket::Connect(socketPath_);
+                }
+                catch(const std::exception&)
+                {
+                }
+            }
+
+        public:
+            explicit DaemonPresenter(const std::string& socketPath, const BatchSetting& setting = BatchSetting()) : socketPath_(socketPath), setting_(setting), useCount_(0), jobCount_(0), stopping_(false)
+            {
+            }
+
+            //Serves the clients until one of them sends SHUTDOWN
+            void Run()
+            {
+                auto listener = LocalSocket::Listen(socketPath_);
+                std::cout << "Daemon listening: "s << socketPath_ << std::endl;
+
+                //Created up front, so that the first job does not pay for it
+                GetPipeline(""s);
+
+                std::list<std::unique_ptr<Connection>> connections;
+                while(!stopping_)
+                {
+                    auto socket = listener.Accept();
+                    if(stopping_) break;
+                    if(!socket.IsValid()) continue;
+
+                    //Clients that have left
+                    for(auto it = connections.begin(); it != connections.end();)
+                    {
+                        if(!(*it)->Finished)
+                        {
+                            ++it;
+                            continue;
+                        }
+                        (*it)->Thread.join();
+                        it = connections.erase(it);
+                    }
+
+                    connections.emplace_back(new Connection());
+                    auto connection = connections.back().get();
+                    connection->Socket = std::move(socket);
+                    connection->Thread = std::thread([this, connection] { Serve(*connection); });
+                }
+
+                //Idle clients are waiting in ReadLine(), running jobs finish first
+                for(auto& connection : connections)
+                {
+                    connection->Socket.Shutdown();
+                }
+                for(auto& connection : connections)
+                {
+                    connection->Thread.join();
+                }
+
+                listener.Close();
+                std::remove(socketPath_.c_str());
+
+                std::cout << "Daemon stopped: "s << jobCount_ << " jobs"s << std::endl;
+            }
+
+            virtual ~DaemonPresenter() = default;
+        };
+
+        //Client side of DaemonPresenter, one connection for any number of requests
+        class DaemonClient
+        {
+            LocalSocket socket_;
+
+            std::vector<std::string> ReadReply()
+            {
+                std::string line;
+                if(!socket_.ReadLine(line)) throw std::runtime_error("daemon closed the connection");
+                return DaemonProtocol::Split(line);
+            }
+
+        public:
+            explicit DaemonClient(const std::string& socketPath) : socket_(LocalSocket::Connect(socketPath))
+            {
+            }
+            virtual ~DaemonClient() = default;
+
+            //timing.csv line of the job, progress receives the denoise percentage
+            //Images that fail keep the reason in the status column, other errors (e.g. a bad spec) throw
+            std::string Submit(const std::string& filePath, const std::string& spec = ""s, const std::function<void(double)>& progress = nullptr)
+            {
+                if(DaemonProtocol::GetField(filePath) != filePath || DaemonProtocol::GetField(spec) != spec) throw std::invalid_argument("tabs and line breaks are not allowed: "s + filePath);
+                if(!socket_.WriteLine("JOB\t"s + filePath + "\t"s + spec)) throw std::runtime_error("daemon closed the connection");
+
+                std::string result;
+                for(;;)
+                {
+                    auto fields = ReadReply();
+                    if(fields[0] == "PROGRESS"s && fields.size() >= 2)
+                    {
+                        if(progress) progress(std::stod(fields[1]));
+                    }
+                    else if(fields[0] == "RESULT"s && fields.size() >= 2) result = fields[1];
+                    else if(fields[0] == "DONE"s) return result;
+                    else if(fields[0] == "ERROR"s) throw std::runtime_error(fields.size() >= 2 ? fields[1] : "daemon error"s);
+                    else throw std::runtime_error("unexpected reply: "s + fields[0]);
+                }
+            }
+
+            bool Ping()
+            {
+                return socket_.WriteLine("PING"s) && ReadReply()[0] == "PONG"s;
+            }
+
+            //The daemon finishes the running jobs and exits
+            void Shutdown()
+            {
+                if(socket_.WriteLine("SHUTDOWN"s)) ReadReply();
+            }
+        };
+    }
+}
@@ -21,6 +21,11 @@
 #include <map>
 
 #include <algorithm>
+#include <atomic>
+#include <condition_variable>
+#include <mutex>
+#include <set>
+#include <thread>
 #include <iostream> //std::cout
 
 namespace ImageInformationAnalyzer
@@ -40,8 +45,14 @@ namespace ImageInformationAnalyzer
             EstimateLightDirectionService estimateLightDirectionService_;
 
 
+            //Slider changes closer than this are redisplayed once
+            static constexpr std::chrono::milliseconds REDISPLAY_DELAY = std::chrono::milliseconds(30);
+
             ImageInformationModel model_;
 
+            //Same chain on a decimated copy, see Preview()
+            ImageInformationModel preview_;
+
             cv::Mat Convert(const FloatingPointImageData* R, const FloatingPointImageData* G, const FloatingPointImageData* B)
             {
                 auto width = R->Width;
@@ -81,6 +92,41 @@ namespace ImageInformationAnalyzer
                 return output;
             }
 
+            //Gaussian pyramid, halved pyramidLevels times
+            FloatingPointImageData* Decimate(const FloatingPointImageData* data, const int pyramidLevels)
+            {
+                auto imageBuffer = data->ImageBuffer;
+                for(auto level = 0; level < pyramidLevels; ++level)
+                {
+                    imageBuffer = Misc::ImageUtility::PyramidDown(imageBuffer);
+                }
+
+                auto height = (int)imageBuffer.size();
+                auto width = (int)imageBuffer[0].size();
+                return new FloatingPointImageData(width, height, imageBuffer, std::vector<std::vector<Eigen::Vector3d>>(height, std::vector<Eigen::Vector3d>(width, Eigen::Vector3d(0, 0, 1))));
+            }
+
+            //Tile with a halo, wraps around at the image border like the denoise windows
+            FloatingPointImageData* GetTile(const FloatingPointImageData* data, const int startX, const int startY, const int tileWidth, const int tileHeight, const int halo)
+            {
+                auto width = tileWidth + 2 * halo;
+                auto height = tileHeight + 2 * halo;
+
+                std::vector<std::vector<double>> imageBuffer(height, std::vector<double>(width));
+                std::vector<std::vector<Eigen::Vector3d>> normalBuffer(height, std::vector<Eigen::Vector3d>(width));
+                for(auto y = 0; y < height; ++y)
+                {
+                    auto sourceY = ((startY - halo + y) % data->Height + data->Height) % data->Height;
+                    for(auto x = 0; x < width; ++x)
+                    {
+                        auto sourceX = ((startX - halo + x) % data->Width + data->Width) % data->Width;
+                        imageBuffer[y][x] = data->ImageBuffer[sourceY][sourceX];
+                        normalBuffer[y][x] = data->NormalBuffer[sourceY][sourceX];
+                    }
+                }
+                return new FloatingPointImageData(width, height, imageBuffer, normalBuffer);
+            }
+
             cv::Mat Histogram(const HistogramData* data)
             {
                 auto width = (int)data->Data.size();
@@ -161,13 +207,15 @@ namespace ImageInformationAnalyzer
                 return true;
             }
 
-            bool DenoiseImage()
+            bool DenoiseImage(const int passCount = 1)
             {
                 if(model_.R == nullptr || model_.G == nullptr || model_.B == nullptr) throw std::logic_error("RGB images don't exist");
 
-                auto denoisedR = denoiseService_.Process(model_.R.get());
-                auto denoisedG = denoiseService_.Process(model_.G.get());
-                auto denoisedB = denoiseService_.Process(model_.B.get());
+                //R, G and B share the window traversal
+                auto denoised = denoiseService_.Process({ model_.R.get(), model_.G.get(), model_.B.get() }, passCount);
+                auto denoisedR = denoised[0];
+                auto denoisedG = denoised[1];
+                auto denoisedB = denoised[2];
 
                 if(denoisedR == nullptr || denoisedG == nullptr || denoisedB == nullptr) throw std::logic_error("Dailed to denoise");
 
@@ -182,13 +230,10 @@ namespace ImageInformationAnalyzer
             {
                 if(model_.DenoisedR == nullptr || model_.DenoisedG == nullptr || model_.DenoisedB == nullptr) throw std::logic_error("Denoised RGB images don't exist");
 
-                auto denoisedR = denoiseService_.Process(model_.DenoisedR.get());
-                auto denoisedG = denoiseService_.Process(model_.DenoisedG.get());
-                auto denoisedB = denoiseService_.Process(model_.DenoisedB.get());
-
-                model_.DenoisedR.release();
-                model_.DenoisedG.release();
-                model_.DenoisedB.release();
+                auto denoised = denoiseService_.Process({ model_.DenoisedR.get(), model_.DenoisedG.get(), model_.DenoisedB.get() }, 1);
+                auto denoisedR = denoised[0];
+                auto denoisedG = denoised[1];
+                auto denoisedB = denoised[2];
 
                 if(denoisedR == nullptr || denoisedG == nullptr || denoisedB == nullptr)  throw std::logic_error("Failed to denoise");
 
@@ -200,6 +245,34 @@ namespace ImageInformationAnalyzer
             }
 
 
+            //Denoise, differential B-R and its histogram on a copy reduced pyramidLevels times by 2, for ShowPreview()
+            //Light estimation and evaluation are skipped, ShowPreview() doesn't show them and the preview model keeps no surface or result
+            bool Preview(const int pyramidLevels = 2)
+            {
+                if(model_.R == nullptr || model_.G == nullptr || model_.B == nullptr) throw std::logic_error("RGB images don't exist");
+
+                auto start = std::chrono::system_clock::now();
+
+                preview_.R.reset(Decimate(model_.R.get(), pyramidLevels));
+                preview_.G.reset(Decimate(model_.G.get(), pyramidLevels));
+                preview_.B.reset(Decimate(model_.B.get(), pyramidLevels));
+
+                auto denoised = denoiseService_.Process({ preview_.R.get(), preview_.G.get(), preview_.B.get() });
+                preview_.DenoisedR.reset(denoised[0]);
+                preview_.DenoisedG.reset(denoised[1]);
+                preview_.DenoisedB.reset(denoised[2]);
+
+                preview_.DifferentialB_R.reset(takeDifferenceService_.Process(preview_.DenoisedB.get(), preview_.DenoisedR.get()));
+
+                const auto histogramSize = 512;
+                preview_.HistogramB_R.reset(takeHistogramService_.Process(preview_.DifferentialB_R.get(), histogramSize, preview_.DifferentialB_R->GetMinValue(), preview_.DifferentialB_R->GetMaxValue()));
+
+                auto end = std::chrono::system_clock::now();
+                std::cout << "Preview "s << preview_.R->Width << "x"s << preview_.R->Height << " completed: "s << std::chrono::duration_cast<std::chrono::milliseconds>(end - start).count() << "ms"s << std::endl;
+
+                return true;
+            }
+
             bool Evaluate()
             {
                 if(model_.R == nullptr || model_.G == nullptr || model_.B == nullptr) throw std::logic_error("RGB images don't exist");
@@ -365,8 +438,65 @@ namespace ImageInformationAnalyzer
 
                 cvui::init(windowNames, windowIndex);
 
+                //Unscaled images of the setting windows, the targets are redisplayed from them
+                std::map<cv::Mat*, cv::Mat> sources;
+                for(auto window : windows)
+                {
+                    auto targetMat = std::get<3>(window);
+                    if(targetMat != nullptr && !targetMat->empty()) sources[targetMat] = targetMat->clone();
+                }
+
+                //Slider redisplay: only the latest range of each target is mapped, after the sliders rest for REDISPLAY_DELAY
+                std::mutex displayMutex;
+                std::condition_variable redisplayCondition;
+                std::map<cv::Mat*, std::tuple<double, double>> pendingRanges;
+                std::map<std::string, std::tuple<double, double>> requestedRanges;
+                std::set<cv::Mat*> updatedFrames;
+                auto lastRequest = std::chrono::steady_clock::now();
+                auto stopRedisplay = false;
+
+                std::thread redisplayThread([&]
+                {
+                    std::unique_lock<std::mutex> lock(displayMutex);
+                    while(true)
+                    {
+                        redisplayCondition.wait(lock, [&] { return stopRedisplay || !pendingRanges.empty(); });
+                        if(stopRedisplay) break;
+
+                        //Debounce
+                        while(!stopRedisplay && std::chrono::steady_clock::now() < lastRequest + REDISPLAY_DELAY)
+                        {
+                            redisplayCondition.wait_until(lock, lastRequest + REDISPLAY_DELAY);
+                        }
+                        if(stopRedisplay) break;
+
+                        auto ranges = std::move(pendingRanges);
+                        pendingRanges.clear();
+                        lock.unlock();
+
+                        //[min, max] => [0, 255] in one vectorised pass, saturated outside
+                        std::map<cv::Mat*, cv::Mat> scaledMats;
+                        for(const auto& range : ranges)
+                        {
+                            auto minValue = std::get<0>(range.second);
+                            auto maxValue = std::get<1>(range.second);
+                            auto alpha = maxValue > minValue ? 255.0 / (maxValue - minValue) : 0.0;
+                            sources.at(range.first).convertTo(scaledMats[range.first], CV_8U, alpha, -minValue * alpha);
+                        }
+
+                        lock.lock();
+                        for(auto& scaledMat : scaledMats)
+                        {
+                            *scaledMat.first = scaledMat.second;
+                            updatedFrames.insert(scaledMat.first);
+                        }
+                    }
+                });
+
+                auto firstFrame = true;
                 while(cv::waitKey(20) != 'q')
                 {
+                    std::lock_guard<std::mutex> lock(displayMutex);
                     for(auto window : windows)
                     {
                         auto windowName = std::get<0>(window);
@@ -385,23 +515,158 @@ namespace ImageInformationAnalyzer
 
                             if(imageData == nullptr) continue;
 
-                            if(DifferentialSettingWindow(windowName, histogramSize, imageData->GetMinValue(), imageData->GetMaxValue(), *minValue, *maxValue, *frame))
+                            auto applied = DifferentialSettingWindow(windowName, histogramSize, imageData->GetMinValue(), imageData->GetMaxValue(), *minValue, *maxValue, *frame);
+                            auto range = std::tuple(*minValue, *maxValue);
+                            if(applied || requestedRanges.count(windowName) == 0 || requestedRanges[windowName] != range)
                             {
                                 //画像の更新
-                                auto scaledImage = scaleImageService_.Process(imageData, *minValue, *maxValue, 0.0, 1.0);
+                                requestedRanges[windowName] = range;
+                                pendingRanges[targetMat] = range;
+                                lastRequest = std::chrono::steady_clock::now();
+                                redisplayCondition.notify_one();
+                            }
+
+                            cvui::imshow(windowName, *frame);
+                            continue;
+                        }
+
+                        //Images only when they have changed
+                        if(firstFrame || updatedFrames.count(frame) != 0) cvui::imshow(windowName, *frame);
+                    }
+                    updatedFrames.clear();
+                    firstFrame = false;
+                }
+
+                {
+                    std::lock_guard<std::mutex> lock(displayMutex);
+                    stopRedisplay = true;
+                }
+                redisplayCondition.notify_one();
+                redisplayThread.join();
+            }
+
+
+            //Shows the preview at once. The full resolution denoise runs tile by tile in the background
+            //and each tile replaces the preview when it completes, the differential and the histogram follow after the last tile
+            //Light estimation and evaluation are not run, call LightEstimation() and Evaluate() afterwards for them
+            void ShowPreview(const int tileSize = 512, const int passCount = 1)
+            {
+                if(model_.R == nullptr || model_.G == nullptr || model_.B == nullptr) throw std::logic_error("RGB images don't exist");
+                if(preview_.DenoisedR == nullptr) Preview();
+
+                auto width = model_.R->Width;
+                auto height = model_.R->Height;
+                const auto tileCountX = (width + tileSize - 1) / tileSize;
+                const auto tileCountY = (height + tileSize - 1) / tileSize;
+                const auto tileCount = tileCountX * tileCountY;
+
+                //Preview scaled up to the full resolution, so that the tiles can be pasted in
+                cv::Mat denoisedRGB, differentialB_R;
+                cv::resize(Convert(preview_.DenoisedR.get(), preview_.DenoisedG.get(), preview_.DenoisedB.get()), denoisedRGB, cv::Size(width, height), 0, 0, cv::INTER_LINEAR);
+                cv::resize(Convert(preview_.DifferentialB_R.get()), differentialB_R, cv::Size(width, height), 0, 0, cv::INTER_LINEAR);
+                auto histogramB_R = Histogram(preview_.HistogramB_R.get());
+
+                std::mutex mutex;
+                auto updated = true;
+                std::atomic<bool> canceled(false);
+                std::atomic<int> completedTiles(0);
+
+                std::thread background([&]
+                {
+                    try
+                    {
+                        const auto halo = denoiseService_.GetWindowRadius() * passCount;
+                        const FloatingPointImageData* channels[] = { model_.R.get(), model_.G.get(), model_.B.get() };
+
+                        std::vector<std::vector<std::vector<double>>> imageBuffers(3, std::vector<std::vector<double>>(height, std::vector<double>(width)));
+                        std::vector<std::vector<std::vector<Eigen::Vector3d>>> normalBuffers(3, std::vector<std::vector<Eigen::Vector3d>>(height, std::vector<Eigen::Vector3d>(width)));
+
+                        auto start = std::chrono::system_clock::now();
+
+                        //The service would log each call, which is once per tile
+                        denoiseService_.SetQuiet(true);
+                        for(auto tile = 0; tile < tileCount && !canceled; ++tile)
+                        {
+                            const auto startX = (tile % tileCountX) * tileSize;
+                            const auto startY = (tile / tileCountX) * tileSize;
+                            const auto tileWidth = std::min(tileSize, width - startX);
+                            const auto tileHeight = std::min(tileSize, height - startY);
+
+                            std::vector<std::unique_ptr<FloatingPointImageData>> tiles;
+                            for(auto channel : channels)
+                            {
+                                tiles.emplace_back(GetTile(channel, startX, startY, tileWidth, tileHeight, halo));
+                            }
+                            auto denoised = denoiseService_.Process({ tiles[0].get(), tiles[1].get(), tiles[2].get() }, passCount);
+                            std::vector<std::unique_ptr<FloatingPointImageData>> results(denoised.begin(), denoised.end());
+
+                            std::lock_guard<std::mutex> lock(mutex);
+                            for(auto y = startY; y < startY + tileHeight; ++y)
+                            {
+                                for(auto x = startX; x < startX + tileWidth; ++x)
                                 {
-                                    auto scaledMat = Convert(scaledImage);
-                                    scaledMat.copyTo(*targetMat);
+                                    for(auto c = 0; c < 3; ++c)
+                                    {
+                                        imageBuffers[c][y][x] = results[c]->ImageBuffer[y - startY + halo][x - startX + halo];
+                                        normalBuffers[c][y][x] = results[c]->NormalBuffer[y - startY + halo][x - startX + halo];
+                                    }
+                                    denoisedRGB.at<cv::Vec3d>(y, x) = cv::Vec3d(imageBuffers[2][y][x], imageBuffers[1][y][x], imageBuffers[0][y][x]);
                                 }
-                                delete scaledImage;
                             }
+                            completedTiles++;
+                            updated = true;
                         }
+                        denoiseService_.SetQuiet(false);
+                        if(canceled) return;
+
+                        auto end = std::chrono::system_clock::now();
+                        std::cout << "Full resolution "s << tileCount << " tiles completed: "s << std::chrono::duration_cast<std::chrono::milliseconds>(end - start).count() << "ms"s << std::endl;
+
+                        model_.DenoisedR.reset(new FloatingPointImageData(width, height, imageBuffers[0], normalBuffers[0]));
+                        model_.DenoisedG.reset(new FloatingPointImageData(width, height, imageBuffers[1], normalBuffers[1]));
+                        model_.DenoisedB.reset(new FloatingPointImageData(width, height, imageBuffers[2], normalBuffers[2]));
 
-                        cvui::imshow(windowName, *frame);
+                        //The differential coefficients and the histogram need the whole image
+                        Diff();
+                        TakeHistogram();
+
+                        std::lock_guard<std::mutex> lock(mutex);
+                        differentialB_R = Convert(model_.DifferentialB_R.get());
+                        histogramB_R = Histogram(model_.HistogramB_R.get());
+                        updated = true;
+                    }
+                    catch(const std::exception& e)
+                    {
+                        denoiseService_.SetQuiet(false);
+                        std::cout << "Exception: "s << e.what() << std::endl;
                     }
+                });
+
+                std::vector<std::tuple<std::string, cv::Mat*>> windows;
+                windows.push_back(std::tuple("Denoised RGB", &denoisedRGB));
+                windows.push_back(std::tuple("Differential B-R", &differentialB_R));//Blood vessel
+                windows.push_back(std::tuple("Histogram B-R", &histogramB_R));
+
+                while(cv::waitKey(20) != 'q')
+                {
+                    std::lock_guard<std::mutex> lock(mutex);
+                    if(!updated) continue;
+
+                    for(auto window : windows)
+                    {
+                        auto windowName = std::get<0>(window);
+                        auto frame = std::get<1>(window);
+                        if(frame->empty()) continue;
+
+                        cv::imshow(windowName, *frame);
+                    }
+                    cv::setWindowTitle("Denoised RGB", "Denoised RGB: "s + std::to_string(completedTiles) + "/"s + std::to_string(tileCount) + " tiles"s);
+                    updated = false;
                 }
-            }
 
+                canceled = true;
+                background.join();
+            }
 
             virtual ~ImageInformationPresenter() = default;
         };
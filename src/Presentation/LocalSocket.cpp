@@ -0,0 +1 @@
+#include "LocalSocket.hpp"
@@ -0,0 +1,217 @@
+#pragma once
+
+#ifdef _WIN32//AF_UNIX is available from Windows 10 1803
+#include <winsock2.h>
+#include <afunix.h>
+#pragma comment(lib, "ws2_32.lib")
+#else
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/un.h>
+#include <unistd.h>
+#endif
+
+#include <cerrno>
+#include <cstring>
+#include <cstdio>
+#include <stdexcept>
+#include <string>
+
+namespace ImageInformationAnalyzer
+{
+    namespace Presentation
+    {
+        using namespace std::string_literals;
+
+        //Unix domain stream socket exchanging '\n' terminated lines
+        class LocalSocket
+        {
+        #ifdef _WIN32
+            using Handle = SOCKET;
+            static constexpr Handle INVALID_HANDLE = INVALID_SOCKET;
+        #else
+            using Handle = int;
+            static constexpr Handle INVALID_HANDLE = -1;
+        #endif
+
+            Handle handle_;
+
+            //Bytes after the last line read
+            std::string buffer_;
+
+            explicit LocalSocket(const Handle handle) : handle_(handle)
+            {
+            }
+
+            static inline void Startup()
+            {
+            #ifdef _WIN32
+                static const auto started = []
+                {
+                    WSADATA data;
+                    return WSAStartup(MAKEWORD(2, 2), &data) == 0;
+                }();
+                if(!started) throw std::runtime_error("WSAStartup failed");
+            #endif
+            }
+
+            static inline sockaddr_un GetAddress(const std::string& path)
+            {
+                sockaddr_un address;
+                std::memset(&address, 0, sizeof(address));
+                address.sun_family = AF_UNIX;
+
+                if(path.size() >= sizeof(address.sun_path)) throw std::invalid_argument("socket path is too long: "s + path);
+                std::memcpy(address.sun_path, path.c_str(), path.size());
+                return address;
+            }
+
+            static inline Handle Create()
+            {
+                Startup();
+
+                auto handle = socket(AF_UNIX, SOCK_STREAM, 0);
+                if(handle == INVALID_HANDLE) throw std::runtime_error("socket() failed");
+                return handle;
+            }
+
+            static inline void CloseHandle(const Handle handle)
+            {
+            #ifdef _WIN32
+                closesocket(handle);
+            #else
+                close(handle);
+            #endif
+            }
+
+        public:
+            LocalSocket() : handle_(INVALID_HANDLE)
+            {
+            }
+            LocalSocket(const LocalSocket&) = delete;
+            LocalSocket& operator=(const LocalSocket&) = delete;
+            LocalSocket(LocalSocket&& other) noexcept : handle_(other.handle_), buffer_(std::move(other.buffer_))
+            {
+                other.handle_ = INVALID_HANDLE;
+            }
+            LocalSocket& operator=(LocalSocket&& other) noexcept
+            {
+                if(this != &other)
+                {
+                    Close();
+                    handle_ = other.handle_;
+                    buffer_ = std::move(other.buffer_);
+                    other.handle_ = INVALID_HANDLE;
+                }
+                return *this;
+            }
+            virtual ~LocalSocket()
+            {
+                Close();
+            }
+
+            //Whether connect() failed because nobody listens on the socket file
+            static inline bool IsConnectionRefused()
+            {
+            #ifdef _WIN32
+                return WSAGetLastError() == WSAECONNREFUSED;
+            #else
+                return errno == ECONNREFUSED;
+            #endif
+            }
+
+            //A stale socket file of a previous run is removed, the socket of a running daemon is not
+            //Only the owner can connect to the socket
+            static LocalSocket Listen(const std::string& path)
+            {
+                auto address = GetAddress(path);
+
+                {
+                    LocalSocket probe(Create());
+                    if(connect(probe.handle_, (const sockaddr*)&address, sizeof(address)) == 0) throw std::runtime_error("a daemon is already listening at "s + path);
+                    if(IsConnectionRefused()) std::remove(path.c_str());
+                }
+
+                LocalSocket listener(Create());
+                if(bind(listener.handle_, (const sockaddr*)&address, sizeof(address)) != 0) throw std::runtime_error("bind() failed: "s + path);
+            #ifndef _WIN32
+                if(chmod(path.c_str(), S_IRUSR | S_IWUSR) != 0) throw std::runtime_error("chmod() failed: "s + path);
+            #endif
+                if(listen(listener.handle_, SOMAXCONN) != 0) throw std::runtime_error("listen() failed: "s + path);
+                return listener;
+            }
+
+            static LocalSocket Connect(const std::string& path)
+            {
+                auto address = GetAddress(path);
+
+                LocalSocket connection(Create());
+                if(connect(connection.handle_, (const sockaddr*)&address, sizeof(address)) != 0) throw std::runtime_error("no daemon at "s + path);
+                return connection;
+            }
+
+            //Blocks until a client connects
+            LocalSocket Accept()
+            {
+                return LocalSocket(accept(handle_, nullptr, nullptr));
+            }
+
+            bool IsValid() const { return handle_ != INVALID_HANDLE; }
+
+            //Without '\n', false once the peer has closed
+            bool ReadLine(std::string& line)
+            {
+                for(;;)
+                {
+                    auto end = buffer_.find('\n');
+                    if(end != std::string::npos)
+                    {
+                        line = buffer_.substr(0, end);
+                        buffer_.erase(0, end + 1);
+                        return true;
+                    }
+
+                    char chunk[4096];
+                    auto size = recv(handle_, chunk, sizeof(chunk), 0);
+                    if(size <= 0) return false;
+                    buffer_.append(chunk, (size_t)size);
+                }
+            }
+
+            //false once the peer has closed
+            bool WriteLine(const std::string& line)
+            {
+                auto data = line + "\n"s;
+                for(size_t sent = 0; sent < data.size();)
+                {
+                #ifdef MSG_NOSIGNAL
+                    auto size = send(handle_, data.c_str() + sent, (int)(data.size() - sent), MSG_NOSIGNAL);
+                #else
+                    auto size = send(handle_, data.c_str() + sent, (int)(data.size() - sent), 0);
+                #endif
+                    if(size <= 0) return false;
+                    sent += (size_t)size;
+                }
+                return true;
+            }
+
+            //Wakes up a thread blocked in ReadLine() of this socket
+            void Shutdown()
+            {
+                if(!IsValid()) return;
+            #ifdef _WIN32
+                shutdown(handle_, SD_BOTH);
+            #else
+                shutdown(handle_, SHUT_RDWR);
+            #endif
+            }
+
+            void Close()
+            {
+                if(!IsValid()) return;
+                CloseHandle(handle_);
+                handle_ = INVALID_HANDLE;
+            }
+        };
+    }
+}
@@ -0,0 +1 @@
+#include "RowStreamPresenter.hpp"
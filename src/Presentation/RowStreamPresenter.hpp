@@ -0,0 +1,74 @@
+#pragma once
+
+#include "BatchPresenter.hpp"
+#include "RowStreamService.hpp"
+
+#include <filesystem>
+#include <fstream>
+#include <iomanip>
+#include <string>
+
+#include <iostream> //std::cout
+
+namespace ImageInformationAnalyzer
+{
+    namespace Presentation
+    {
+        using namespace Application;
+
+        struct RowStreamSetting
+        {
+            //Per pixel modes only, one pass
+            DenoiseImageService::Mode DenoiseMode = DenoiseImageService::Mode::CIRCLE;
+            DenoiseSetting Denoise;
+            //ppm is written row by row, png, bmp and jpg are collected as 8 bit and stored at the end
+            std::string Extension = "ppm";
+            //Results, the histogram and the spill file
+            std::string OutputDirectory = "row_stream_output";
+        };
+
+        //Images larger than the memory, e.g. panoramas: BatchPresenter's pipeline with rows instead of whole images
+        class RowStreamPresenter
+        {
+            const RowStreamSetting setting_;
+
+            RowStreamService rowStreamService_;
+
+            std::string GetOutputPath(const std::string& inputPath, const std::string& suffix, const std::string& extension) const
+            {
+                auto stem = std::filesystem::path(inputPath).stem().string();
+                return (std::filesystem::path(setting_.OutputDirectory) / (stem + suffix + "."s + extension)).string();
+            }
+
+        public:
+            explicit RowStreamPresenter(const RowStreamSetting& setting = RowStreamSetting()) : setting_(setting), rowStreamService_(setting.DenoiseMode, setting.Denoise)
+            {
+            }
+            virtual ~RowStreamPresenter() = default;
+
+            RowStreamResult Run(const std::string& inputPath)
+            {
+                std::filesystem::create_directories(setting_.OutputDirectory);
+
+                auto result = rowStreamService_.Process(inputPath, GetOutputPath(inputPath, "_denoised"s, setting_.Extension), GetOutputPath(inputPath, "_B-R"s, setting_.Extension), GetOutputPath(inputPath, ""s, "spill"s));
+
+                //Value of the center of each bin
+                std::ofstream csv(GetOutputPath(inputPath, "_B-R_histogram"s, "csv"s));
+                csv << "value,frequency"s << std::endl;
+                const auto binWidth = (result.DifferentialMaxValue - result.DifferentialMinValue) / (RowStreamService::HISTOGRAM_SIZE - 1.0);
+                for(auto i = 0; i < result.HistogramB_R.size(); ++i)
+                {
+                    csv << std::setprecision(8) << result.DifferentialMinValue + i * binWidth << ","s << result.HistogramB_R[i] << std::endl;
+                }
+
+                //Planes and normals of one whole image stage for comparison
+                const auto planeBytes = (double)result.Width * result.Height * 3 * (sizeof(double) + sizeof(Eigen::Vector3d));
+                std::cout << std::setprecision(4) << result.Width << "x"s << result.Height << ": PSNR "s << result.Evaluations[0] << " / "s << result.Evaluations[1] << " / "s << result.Evaluations[2]
+                    << ", B-R = B - ("s << result.BalanceA << " * R + "s << result.BalanceB << ")"s << std::endl;
+                std::cout << "Buffers: "s << result.PeakBufferBytes / 1024.0 / 1024.0 << "MB (one whole image stage: "s << planeBytes / 1024.0 / 1024.0 << "MB), spill: "s << result.SpillBytes / 1024.0 / 1024.0 << "MB"s << std::endl;
+
+                return result;
+            }
+        };
+    }
+}
@@ -0,0 +1 @@
+#include "ShardedBatchPresenter.hpp"
@@ -0,0 +1,381 @@
+#pragma once
+
+#include "BatchPresenter.hpp"
+
+#include <condition_variable>
+#include <filesystem>
+#include <fstream>
+#include <iomanip>
+#include <mutex>
+#include <set>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <iostream> //std::cout
+
+namespace ImageInformationAnalyzer
+{
+    namespace Presentation
+    {
+        //Batch shared by several processes (e.g. one per NUMA node, or hosts on a shared filesystem) through a work directory
+        //  pending/<index>.job          an image that nobody has claimed, the file holds the image path
+        //  claimed/<index>.job.<worker> claimed by a worker through rename(), which only one of the workers wins
+        //  done/<index>.csv             checkpoint, the timing.csv line of the finished image
+        //A restarted worker puts its own claims back first, finished images are never processed again
+        //A running worker touches its claims every third of the reclaim time, so only the claims of a dead worker age
+        //The workers of a directory should be given the same reclaim time
+        class ShardedBatchPresenter
+        {
+            enum
+            {
+                //Heartbeat of a worker that never reclaims, for the workers that do
+                DEFAULT_HEARTBEAT_SECONDS = 10
+            };
+
+            const std::filesystem::path workDirectory_;
+            const std::string workerName_;
+
+            //Claims older than this are taken back from workers that died, 0 never
+            const int reclaimSeconds_;
+
+            //Listing of pending/, claimed in order and listed again once it is used up
+            std::vector<std::filesystem::path> tickets_;
+            size_t nextTicket_;
+
+            //Tickets this worker could not read, released and not claimed again
+            std::set<int> unreadableTickets_;
+
+            //Indices claimed and not completed yet, for the heartbeat
+            std::mutex claimMutex_;
+            std::set<int> claims_;
+
+            std::filesystem::path GetPendingDirectory() const { return workDirectory_ / "pending"s; }
+            std::filesystem::path GetClaimedDirectory() const { return workDirectory_ / "claimed"s; }
+            std::filesystem::path GetDoneDirectory() const { return workDirectory_ / "done"s; }
+
+            std::filesystem::path GetClaimPath(const int index) const
+            {
+                return GetClaimedDirectory() / (GetTicketName(index) + "."s + workerName_);
+            }
+
+            //Zero padded, so that the names sort by index
+            static inline std::string GetIndexName(const int index)
+            {
+                std::ostringstream name;
+                name << std::setw(8) << std::setfill('0') << index;
+                return name.str();
+            }
+
+            static inline std::string GetTicketName(const int index)
+            {
+                return GetIndexName(index) + ".job"s;
+            }
+
+            static inline bool IsTemporary(const std::filesystem::path& path)
+            {
+                return path.filename().string().find(".tmp."s) != std::string::npos;
+            }
+
+            static inline std::string GetStem(const std::filesystem::path& path)
+            {
+                auto name = path.filename().string();
+                return name.substr(0, name.find('.'));
+            }
+
+            //false if another worker was faster
+            static inline bool TryRename(const std::filesystem::path& from, const std::filesystem::path& to)
+            {
+                std::error_code error;
+                std::filesystem::rename(from, to, error);
+                return !error;
+            }
+
+            //Written aside and renamed, so that a reader never sees half a file
+            void WriteAtomically(const std::filesystem::path& path, const std::string& text) const
+            {
+                auto temporary = path;
+                temporary += ".tmp."s + workerName_;
+                {
+                    std::ofstream file(temporary);
+                    file << text << std::endl;
+                    if(!file) throw std::runtime_error("cannot write "s + temporary.string());
+                }
+                if(!TryRename(temporary, path)) throw std::runtime_error("cannot write "s + path.string());
+            }
+
+            static inline std::vector<std::filesystem::path> GetFiles(const std::filesystem::path& directory)
+            {
+                std::vector<std::filesystem::path> files;
+                for(const auto& entry : std::filesystem::directory_iterator(directory))
+                {
+                    if(entry.is_regular_file()) files.push_back(entry.path());
+                }
+                std::sort(files.begin(), files.end());
+                return files;
+            }
+
+            //Age of a claim for Reclaim()
+            static inline void Touch(const std::filesystem::path& path)
+            {
+                std::error_code error;
+                std::filesystem::last_write_time(path, std::filesystem::file_time_type::clock::now(), error);
+            }
+
+            //Touches the claims in flight until stopped is set
+            void Heartbeat(std::mutex& mutex, std::condition_variable& condition, const bool& stopped)
+            {
+                const auto interval = std::chrono::milliseconds(reclaimSeconds_ > 0 ? std::max(reclaimSeconds_ * 1000 / 3, 1) : DEFAULT_HEARTBEAT_SECONDS * 1000);
+
+                std::unique_lock<std::mutex> lock(mutex);
+                while(!condition.wait_for(lock, interval, [&] { return stopped; }))
+                {
+                    std::lock_guard<std::mutex> claimLock(claimMutex_);
+                    for(auto index : claims_)
+                    {
+                        Touch(GetClaimPath(index));
+                    }
+                }
+            }
+
+            //Claims of this worker left by a previous run (ownOnly), or of the other workers after reclaimSeconds_
+            int Reclaim(const bool ownOnly)
+            {
+                auto now = std::filesystem::file_time_type::clock::now();
+                auto count = 0;
+                for(const auto& claim : GetFiles(GetClaimedDirectory()))
+                {
+                    auto name = claim.filename().string();
+                    auto separator = name.find(".job."s);
+                    if(separator == std::string::npos) continue;
+
+                    auto worker = name.substr(separator + 5);
+
+                    //Own claims of this run are in flight
+                    auto own = worker == workerName_;
+                    if(ownOnly != own) continue;
+                    if(!own)
+                    {
+                        std::error_code error;
+                        auto time = std::filesystem::last_write_time(claim, error);
+                        if(error || reclaimSeconds_ <= 0 || now - time < std::chrono::seconds(reclaimSeconds_)) continue;
+                    }
+
+                    //Finished just before it died
+                    if(std::filesystem::exists(GetDoneDirectory() / (GetStem(claim) + ".csv"s)))
+                    {
+                        std::error_code error;
+                        std::filesystem::remove(claim, error);
+                        continue;
+                    }
+
+                    if(TryRename(claim, GetPendingDirectory() / (GetStem(claim) + ".job"s)))
+                    {
+                        std::cout << "Reclaimed: "s << name << std::endl;
+                        count++;
+                    }
+                }
+                return count;
+            }
+
+        public:
+            explicit ShardedBatchPresenter(const std::string& workDirectory, const std::string& workerName, const int reclaimSeconds = 0)
+                : workDirectory_(workDirectory), workerName_(workerName), reclaimSeconds_(reclaimSeconds), nextTicket_(0)
+            {
+                if(workerName.empty() || workerName.find_first_of("./\\"s) != std::string::npos) throw std::invalid_argument("worker name must not be empty or contain . / \\: "s + workerName);
+                if(!std::filesystem::is_directory(GetPendingDirectory())) throw std::invalid_argument("not a work directory: "s + workDirectory);
+
+                Reclaim(true);
+            }
+            virtual ~ShardedBatchPresenter() = default;
+
+            //Tickets for the files, run again it only adds the files that have none (e.g. after the list has grown)
+            static int Prepare(const std::string& workDirectory, const std::vector<std::string>& files)
+            {
+                const std::filesystem::path directory(workDirectory);
+                for(const auto& name : { "pending"s, "claimed"s, "done"s })
+                {
+                    std::filesystem::create_directories(directory / name);
+                }
+
+                //Index by path, so that the index of a file stays the same
+                std::map<std::string, int> known;
+                auto nextIndex = 0;
+                for(const auto& name : { "pending"s, "claimed"s, "done"s })
+                {
+                    for(const auto& ticket : GetFiles(directory / name))
+                    {
+                        if(IsTemporary(ticket)) continue;
+
+                        std::ifstream file(ticket);
+                        std::string line;
+                        std::getline(file, line);
+
+                        //done/ holds the csv line, the path is its second column
+                        if(name == "done"s)
+                        {
+                            auto begin = line.find(",\""s);
+                            auto end = line.find("\","s, begin + 2);
+                            if(begin == std::string::npos || end == std::string::npos) continue;
+                            line = line.substr(begin + 2, end - begin - 2);
+                        }
+
+                        auto index = std::stoi(GetStem(ticket));
+                        known[line] = index;
+                        nextIndex = std::max(nextIndex, index + 1);
+                    }
+                }
+
+                auto added = 0;
+                for(const auto& file : files)
+                {
+                    auto path = std::filesystem::absolute(file).string();
+                    if(known.count(path) != 0) continue;
+
+                    //A worker running already must not claim half a ticket
+                    auto temporary = directory / (GetTicketName(nextIndex) + ".tmp.prepare"s);
+                    std::ofstream(temporary) << path << std::endl;
+                    if(!TryRename(temporary, directory / "pending"s / GetTicketName(nextIndex))) throw std::runtime_error("cannot write "s + temporary.string());
+
+                    known[path] = nextIndex++;
+                    added++;
+                }
+                return added;
+            }
+
+            //Next image for BatchPresenter::Run(), false when nothing is pending
+            bool Claim(BatchItem& item)
+            {
+                for(;;)
+                {
+                    if(nextTicket_ >= tickets_.size())
+                    {
+                        tickets_ = GetFiles(GetPendingDirectory());
+                        tickets_.erase(std::remove_if(tickets_.begin(), tickets_.end(), [&](const std::filesystem::path& ticket) { return IsTemporary(ticket) || unreadableTickets_.count(std::stoi(GetStem(ticket))) != 0; }), tickets_.end());
+                        nextTicket_ = 0;
+
+                        if(tickets_.empty())
+                        {
+                            if(Reclaim(false) == 0) return false;
+                            continue;
+                        }
+                    }
+
+                    const auto ticket = tickets_[nextTicket_++];
+                    const auto index = std::stoi(GetStem(ticket));
+
+                    //rename() keeps the time of the ticket, which may be older than the reclaim time already
+                    const auto claim = GetClaimPath(index);
+                    Touch(ticket);
+                    if(!TryRename(ticket, claim)) continue;
+
+                    //Reclaimed from a worker that finished it after all
+                    if(std::filesystem::exists(GetDoneDirectory() / (GetIndexName(index) + ".csv"s)))
+                    {
+                        std::error_code error;
+                        std::filesystem::remove(claim, error);
+                        continue;
+                    }
+
+                    std::ifstream file(claim);
+                    std::string path;
+                    if(!file || !std::getline(file, path) || path.empty())
+                    {
+                        //Another worker may be able to read it
+                        std::cout << "Released unreadable ticket: "s << claim.filename().string() << std::endl;
+                        unreadableTickets_.insert(index);
+                        TryRename(claim, ticket);
+                        continue;
+                    }
+
+                    {
+                        std::lock_guard<std::mutex> lock(claimMutex_);
+                        claims_.insert(index);
+                    }
+
+                    item.Index = index;
+                    item.FilePath = path;
+                    return true;
+                }
+            }
+
+            //Checkpoint, failed images are finished too and keep the reason in the status column
+            void Complete(const BatchItem& item)
+            {
+                WriteAtomically(GetDoneDirectory() / (GetIndexName(item.Index) + ".csv"s), BatchPresenter::GetCsvLine(item));
+
+                std::error_code error;
+                std::filesystem::remove(GetClaimPath(item.Index), error);
+
+                std::lock_guard<std::mutex> lock(claimMutex_);
+                claims_.erase(item.Index);
+            }
+
+            //pending, claimed and done
+            std::tuple<int, int, int> GetCounts() const
+            {
+                auto done = GetFiles(GetDoneDirectory());
+                done.erase(std::remove_if(done.begin(), done.end(), IsTemporary), done.end());
+                return std::tuple((int)GetFiles(GetPendingDirectory()).size(), (int)GetFiles(GetClaimedDirectory()).size(), (int)done.size());
+            }
+
+            //Claims and processes until nothing is pending, returns the number of failed images
+            int Run(const BatchSetting& setting)
+            {
+                std::mutex heartbeatMutex;
+                std::condition_variable heartbeatCondition;
+                auto heartbeatStopped = false;
+                std::thread heartbeat([&] { Heartbeat(heartbeatMutex, heartbeatCondition, heartbeatStopped); });
+
+                auto completedCount = 0;
+                auto failed = BatchPresenter::Run(setting, [&](BatchItem& item) { return Claim(item); }, [&](const BatchItem& item)
+                {
+                    Complete(item);
+
+                    completedCount++;
+                    std::cout << "Shard "s << workerName_ << " "s << completedCount << ": "s << item.FilePath << (item.Error.empty() ? ""s : " failed: "s + item.Error) << std::endl;
+                });
+
+                {
+                    std::lock_guard<std::mutex> lock(heartbeatMutex);
+                    heartbeatStopped = true;
+                }
+                heartbeatCondition.notify_one();
+                heartbeat.join();
+
+                auto [pending, claimed, done] = GetCounts();
+                std::cout << "Shard "s << workerName_ << " finished, pending: "s << pending << ", claimed: "s << claimed << ", done: "s << done << std::endl;
+
+                //The last worker leaves the merged result
+                if(pending == 0 && claimed == 0) Merge(workDirectory_.string(), workerName_);
+
+                return failed;
+            }
+
+            //timing.csv of the work directory from the checkpoints, in index order
+            static void Merge(const std::string& workDirectory, const std::string& workerName = "merge"s)
+            {
+                const std::filesystem::path directory(workDirectory);
+
+                std::ostringstream csv;
+                csv << BatchPresenter::GetCsvHeader();
+                for(const auto& done : GetFiles(directory / "done"s))
+                {
+                    if(IsTemporary(done)) continue;
+
+                    std::ifstream file(done);
+                    std::string line;
+                    if(std::getline(file, line)) csv << std::endl << line;
+                }
+
+                //Several workers may finish at the same time
+                auto path = directory / "timing.csv"s;
+                auto temporary = path;
+                temporary += ".tmp."s + workerName;
+                std::ofstream(temporary) << csv.str() << std::endl;
+                if(!TryRename(temporary, path)) throw std::runtime_error("cannot write "s + path.string());
+            }
+        };
+    }
+}
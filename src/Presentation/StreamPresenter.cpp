@@ -0,0 +1 @@
+#include "StreamPresenter.hpp"
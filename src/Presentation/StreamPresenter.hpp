@@ -0,0 +1,277 @@
+#pragma once
+
+#include "BatchPresenter.hpp"
+#include "EstimateLightDirectionService.hpp"
+#include "FrameSourceService.hpp"
+
+#include <deque>
+#include <filesystem>
+#include <fstream>
+#include <iomanip>
+#include <memory>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <iostream> //std::cout
+
+namespace ImageInformationAnalyzer
+{
+    namespace Presentation
+    {
+        using namespace Application;
+
+        struct StreamSetting
+        {
+            //Temporal modes start each pixel from the previous frame
+            DenoiseImageService::Mode DenoiseMode = DenoiseImageService::Mode::TEMPORAL_ELLIPSE;
+            DenoiseSetting Denoise;
+            int PassCount = 1;
+            //Light direction of each frame, started from the solution of the previous frame
+            bool EstimateLight = true;
+            EstimateLightDirectionService::Mode LightMode = EstimateLightDirectionService::Mode::PYRAMID;
+            LightEstimationSetting Light = []
+            {
+                LightEstimationSetting setting;
+                setting.WarmStart = true;
+                return setting;
+            }();
+            //Same as ImageInformationPresenter
+            double PixelPitch = 0.001 * 0.01;
+            //Denoised frames and frames.csv, empty stores nothing
+            std::string OutputDirectory;
+            //0 reads to the end
+            int MaxFrameCount = 0;
+        };
+
+        //One frame through the pipeline
+        struct StreamFrame
+        {
+            int Index = 0;
+
+            //R, G, B scaled to [0, 1]
+            std::vector<std::unique_ptr<FloatingPointImageData>> Channels;
+            std::vector<std::unique_ptr<FloatingPointImageData>> Denoised;
+            std::unique_ptr<FloatingPointImageData> Surface;
+
+            long long DecodeMilliseconds = 0;
+            long long DenoiseMilliseconds = 0;
+            long long LightMilliseconds = 0;
+            long long EncodeMilliseconds = 0;
+        };
+
+        //Frames of a video or of an image directory through services that live for the whole stream
+        //Decoding and storing run on their own threads, the frames are computed in order because each one starts from the previous one
+        class StreamPresenter
+        {
+            enum
+            {
+                //Frames in each queue between the stages
+                QUEUE_CAPACITY = 2,
+                //Frames of the moving frame rate
+                FPS_WINDOW = 30
+            };
+
+            const StreamSetting setting_;
+
+            FrameSourceService frameSourceService_;
+            DenoiseImageService denoiseService_;
+            TakeDifferenceService takeDifferenceService_;
+            EstimateLightDirectionService estimateLightDirectionService_;
+            ScaleImageService scaleImageService_;
+            ImageFileService imageFileService_;
+
+            static inline long long GetMilliseconds(const std::chrono::steady_clock::time_point& start)
+            {
+                return std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::steady_clock::now() - start).count();
+            }
+
+            std::string GetOutputPath(const int index, const std::string& suffix) const
+            {
+                std::ostringstream name;
+                name << "frame_"s << std::setw(6) << std::setfill('0') << index << suffix << ".png"s;
+                return (std::filesystem::path(setting_.OutputDirectory) / name.str()).string();
+            }
+
+            //nullptr after the last frame
+            std::unique_ptr<StreamFrame> Decode(const int index)
+            {
+                auto start = std::chrono::steady_clock::now();
+
+                std::vector<std::unique_ptr<FloatingPointImageData>> channels;
+                for(auto channel : frameSourceService_.Read())
+                {
+                    channels.emplace_back(channel);
+                }
+                if(channels.empty()) return nullptr;
+
+                std::unique_ptr<StreamFrame> frame(new StreamFrame());
+                frame->Index = index;
+                for(const auto& channel : channels)
+                {
+                    frame->Channels.emplace_back(scaleImageService_.Process(channel.get(), 0.0, 255.0, 0.0, 1.0));
+                }
+                frame->DecodeMilliseconds = GetMilliseconds(start);
+                return frame;
+            }
+
+            void Compute(StreamFrame& frame)
+            {
+                auto start = std::chrono::steady_clock::now();
+                for(auto channel : denoiseService_.Process({ frame.Channels[0].get(), frame.Channels[1].get(), frame.Channels[2].get() }, setting_.PassCount))
+                {
+                    frame.Denoised.emplace_back(channel);
+                }
+                frame.DenoiseMilliseconds = GetMilliseconds(start);
+
+                if(!setting_.EstimateLight) return;
+
+                start = std::chrono::steady_clock::now();
+                std::unique_ptr<FloatingPointImageData> differentialB_G(takeDifferenceService_.Process(frame.Denoised[2].get(), frame.Denoised[1].get()));
+                frame.Surface.reset(estimateLightDirectionService_.Process(frame.Denoised[0].get(), frame.Denoised[1].get(), frame.Denoised[2].get(), differentialB_G.get(), setting_.PixelPitch));
+                frame.LightMilliseconds = GetMilliseconds(start);
+            }
+
+            void Encode(StreamFrame& frame)
+            {
+                if(setting_.OutputDirectory.empty()) return;
+
+                auto start = std::chrono::steady_clock::now();
+
+                std::vector<std::unique_ptr<FloatingPointImageData>> denoised;
+                for(const auto& channel : frame.Denoised)
+                {
+                    denoised.emplace_back(scaleImageService_.Process(channel.get(), 0.0, 1.0, 0.0, 255.0));
+                }
+                imageFileService_.Store(denoised[0].get(), denoised[1].get(), denoised[2].get(), GetOutputPath(frame.Index, "_denoised"s));
+
+                if(frame.Surface != nullptr)
+                {
+                    const auto* surface = frame.Surface.get();
+                    std::unique_ptr<FloatingPointImageData> scaled(scaleImageService_.Process(surface, surface->GetMinValue(), surface->GetMaxValue(), 0.0, 255.0));
+                    imageFileService_.Store(scaled.get(), scaled.get(), scaled.get(), GetOutputPath(frame.Index, "_surface"s));
+                }
+
+                frame.EncodeMilliseconds = GetMilliseconds(start);
+            }
+
+        public:
+            explicit StreamPresenter(const StreamSetting& setting = StreamSetting())
+                : setting_(setting), denoiseService_(setting.DenoiseMode, setting.Denoise), takeDifferenceService_(TakeDifferenceService::Mode::WholePixel), estimateLightDirectionService_(setting.LightMode, setting.Light)
+            {
+            }
+            virtual ~StreamPresenter() = default;
+
+            //Returns the number of frames
+            int Run(const std::string& source)
+            {
+                frameSourceService_.Open(source);
+
+                std::ofstream csv;
+                if(!setting_.OutputDirectory.empty())
+                {
+                    std::filesystem::create_directories(setting_.OutputDirectory);
+                    csv.open((std::filesystem::path(setting_.OutputDirectory) / "frames.csv"s).string());
+                    csv << "frame,decode_ms,denoise_ms,light_ms,encode_ms"s << std::endl;
+                }
+
+                BoundedQueue<std::unique_ptr<StreamFrame>> decodedQueue(QUEUE_CAPACITY);
+                BoundedQueue<std::unique_ptr<StreamFrame>> computedQueue(QUEUE_CAPACITY);
+
+                //An exception of a stage ends the stream, the other stages drain their queues
+                std::string error;
+                std::mutex errorMutex;
+                auto fail = [&](const std::exception& e)
+                {
+                    std::lock_guard<std::mutex> lock(errorMutex);
+                    if(error.empty()) error = e.what();
+                };
+
+                std::thread decodeThread([&]
+                {
+                    try
+                    {
+                        for(auto index = 0; setting_.MaxFrameCount <= 0 || index < setting_.MaxFrameCount; ++index)
+                        {
+                            auto frame = Decode(index);
+                            if(frame == nullptr) break;
+
+                            decodedQueue.Push(std::move(frame));
+                        }
+                    }
+                    catch(const std::exception& e)
+                    {
+                        fail(e);
+                    }
+                    decodedQueue.Close();
+                });
+
+                std::thread encodeThread([&]
+                {
+                    std::unique_ptr<StreamFrame> frame;
+                    while(computedQueue.Pop(frame))
+                    {
+                        try
+                        {
+                            Encode(*frame);
+                            if(csv.is_open()) csv << frame->Index << ","s << frame->DecodeMilliseconds << ","s << frame->DenoiseMilliseconds << ","s << frame->LightMilliseconds << ","s << frame->EncodeMilliseconds << std::endl;
+                        }
+                        catch(const std::exception& e)
+                        {
+                            fail(e);
+                        }
+                    }
+                });
+
+                //Sustained rate over the last frames, the first frame is a cold start
+                std::deque<std::chrono::steady_clock::time_point> frameTimes;
+                auto start = std::chrono::steady_clock::now();
+                frameTimes.push_back(start);
+
+                auto frameCount = 0;
+                std::unique_ptr<StreamFrame> frame;
+                while(decodedQueue.Pop(frame))
+                {
+                    try
+                    {
+                        Compute(*frame);
+                    }
+                    catch(const std::exception& e)
+                    {
+                        fail(e);
+                        break;
+                    }
+
+                    frameCount++;
+                    frameTimes.push_back(std::chrono::steady_clock::now());
+                    if(frameTimes.size() > FPS_WINDOW + 1) frameTimes.pop_front();
+
+                    auto windowSeconds = std::chrono::duration<double>(frameTimes.back() - frameTimes.front()).count();
+                    std::cout << "Frame "s << frame->Index << ": denoise "s << frame->DenoiseMilliseconds << "ms, light "s << frame->LightMilliseconds << "ms, "s
+                        << std::setprecision(3) << (frameTimes.size() - 1) / std::max(windowSeconds, 1e-9) << " fps"s << std::endl;
+
+                    computedQueue.Push(std::move(frame));
+                }
+
+                //Unblocks the decoder if the loop has stopped early
+                decodedQueue.Close();
+                while(decodedQueue.Pop(frame))
+                {
+                }
+                computedQueue.Close();
+
+                decodeThread.join();
+                encodeThread.join();
+
+                auto seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+                std::cout << "Stream completed: "s << frameCount << " frames, "s << std::setprecision(4) << seconds << "s ("s << frameCount / std::max(seconds, 1e-9) << " fps"s;
+                if(frameSourceService_.GetFrameRate() > 0) std::cout << ", recorded at "s << frameSourceService_.GetFrameRate() << " fps"s;
+                std::cout << ")"s << std::endl;
+
+                if(!error.empty()) throw std::runtime_error(error);
+
+                return frameCount;
+            }
+        };
+    }
+}
@@ -0,0 +1 @@
+#include "TiledBatchPresenter.hpp"
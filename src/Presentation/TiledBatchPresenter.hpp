@@ -0,0 +1,216 @@
+#pragma once
+
+#include "DenoiseImageService.hpp"
+#include "ScaleImageService.hpp"
+#include "TakeDifferenceService.hpp"
+#include "TakeHistogramService.hpp"
+#include "TiledImageService.hpp"
+
+#include <array>
+#include <filesystem>
+#include <fstream>
+#include <iomanip>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include <iostream> //std::cout
+
+namespace ImageInformationAnalyzer
+{
+    namespace Presentation
+    {
+        using namespace Application;
+
+        struct TiledBatchSetting
+        {
+            //Modes that give the same result tile by tile (all but ANYTIME and TEMPORAL)
+            DenoiseImageService::Mode DenoiseMode = DenoiseImageService::Mode::ELLIPSE;
+            DenoiseSetting Denoise;
+            int PassCount = 1;
+            //EachPixel B-R, WholePixel fits the whole image at once and can't be tiled
+            bool TakeDifference = true;
+            //Tile size and memory budget
+            TiledSetting Tiled;
+            //ppm is written row by row, png, bmp and jpg are collected as 8 bit and stored at the end
+            std::string Extension = "ppm";
+            std::string OutputDirectory = "tiled_output";
+        };
+
+        //Stitched mosaics larger than the memory: BatchPresenter's pipeline on out-of-core planes
+        //Every intermediate is a TiledImageData, only the tiles being processed and the mapped views are in memory
+        class TiledBatchPresenter
+        {
+            enum
+            {
+                HISTOGRAM_SIZE = 512
+            };
+
+            typedef std::vector<std::unique_ptr<TiledImageData>> Planes;
+
+            const TiledBatchSetting setting_;
+
+            TiledImageService tiledImageService_;
+            DenoiseImageService denoiseService_;
+            ScaleImageService scaleImageService_;
+            TakeDifferenceService takeDifferenceService_;
+            TakeHistogramService takeHistogramService_;
+
+            std::string GetOutputPath(const std::string& inputPath, const std::string& suffix, const std::string& extension) const
+            {
+                auto stem = std::filesystem::path(inputPath).stem().string();
+                return (std::filesystem::path(setting_.OutputDirectory) / (stem + suffix + "."s + extension)).string();
+            }
+
+            static inline Planes ToPlanes(const std::vector<TiledImageData*>& data)
+            {
+                Planes planes;
+                for(auto plane : data)
+                {
+                    planes.emplace_back(plane);
+                }
+                return planes;
+            }
+
+            static inline std::vector<const TiledImageData*> ToPointers(const Planes& planes)
+            {
+                std::vector<const TiledImageData*> pointers;
+                for(const auto& plane : planes)
+                {
+                    pointers.push_back(plane.get());
+                }
+                return pointers;
+            }
+
+            //Same scaling on every plane, tile by tile
+            Planes Scale(const Planes& planes, const double oldMinValue, const double oldMaxValue, const double newMinValue, const double newMaxValue)
+            {
+                return ToPlanes(tiledImageService_.Process(ToPointers(planes), 0, [&](const std::vector<const FloatingPointImageData*>& tiles)
+                {
+                    std::vector<FloatingPointImageData*> results;
+                    for(auto tile : tiles)
+                    {
+                        results.push_back(scaleImageService_.Process(tile, oldMinValue, oldMaxValue, newMinValue, newMaxValue));
+                    }
+                    return results;
+                }));
+            }
+
+        public:
+            explicit TiledBatchPresenter(const TiledBatchSetting& setting = TiledBatchSetting())
+                : setting_(setting), tiledImageService_(setting.Tiled), denoiseService_(setting.DenoiseMode, setting.Denoise), takeDifferenceService_(TakeDifferenceService::Mode::EachPixel)
+            {
+                //ANYTIME would get the full time budget per tile, TEMPORAL would warm start each tile from the previous one
+                switch(setting.DenoiseMode)
+                {
+                    case DenoiseImageService::Mode::ANYTIME_ELLIPSE:
+                    case DenoiseImageService::Mode::ANYTIME_HYPER_ELLIPSE:
+                    case DenoiseImageService::Mode::TEMPORAL_ELLIPSE:
+                    case DenoiseImageService::Mode::TEMPORAL_HYPER_ELLIPSE:
+                        throw std::invalid_argument("this denoise mode can't be tiled");
+                    default:
+                        break;
+                }
+            }
+            virtual ~TiledBatchPresenter() = default;
+
+            //Returns the PSNR of the denoised R, G, B against the input
+            std::array<double, 3> Run(const std::string& inputPath)
+            {
+                std::filesystem::create_directories(setting_.OutputDirectory);
+                auto start = std::chrono::system_clock::now();
+
+                Planes channels;
+                {
+                    auto loaded = ToPlanes(tiledImageService_.Load(inputPath));
+                    channels = Scale(loaded, 0.0, 255.0, 0.0, 1.0);
+                }
+                const auto width = channels[0]->Width;
+                const auto height = channels[0]->Height;
+
+                //The halo covers the window of every pass
+                auto denoised = ToPlanes(tiledImageService_.Process(ToPointers(channels), denoiseService_.GetWindowRadius() * setting_.PassCount, [&](const std::vector<const FloatingPointImageData*>& tiles)
+                {
+                    return denoiseService_.Process(tiles, setting_.PassCount);
+                }));
+
+                //Squared errors summed over the tiles
+                std::array<double, 3> squaredErrors = { 0, 0, 0 };
+                auto evaluated = ToPointers(denoised);
+                for(const auto& channel : channels)
+                {
+                    evaluated.push_back(channel.get());
+                }
+                tiledImageService_.ForEachTile(evaluated, 0, [&](const int, const std::vector<const FloatingPointImageData*>& tiles)
+                {
+                    for(auto c = 0; c < 3; ++c)
+                    {
+                        for(auto y = 0; y < tiles[c]->Height; ++y)
+                        {
+                            for(auto x = 0; x < tiles[c]->Width; ++x)
+                            {
+                                auto diff = tiles[c]->ImageBuffer[y][x] - tiles[c + 3]->ImageBuffer[y][x];
+                                squaredErrors[c] += diff * diff;
+                            }
+                        }
+                    }
+                });
+
+                //Same as PSNRIImageEvaluationDataRepository with maxValue 1
+                std::array<double, 3> evaluations;
+                for(auto c = 0; c < 3; ++c)
+                {
+                    auto mse = squaredErrors[c] / ((double)width * height);
+                    evaluations[c] = 10.0 * std::log10(1.0 / mse);
+                }
+                channels.clear();
+
+                {
+                    auto stored = Scale(denoised, 0.0, 1.0, 0.0, 255.0);
+                    tiledImageService_.Store(stored[0].get(), stored[1].get(), stored[2].get(), GetOutputPath(inputPath, "_denoised"s, setting_.Extension));
+                }
+
+                if(setting_.TakeDifference)
+                {
+                    if(takeDifferenceService_.GetWindowRadius() < 0) throw std::invalid_argument("the differential needs the whole image");
+
+                    auto differential = ToPlanes(tiledImageService_.Process({ denoised[2].get(), denoised[0].get() }, takeDifferenceService_.GetWindowRadius(), [&](const std::vector<const FloatingPointImageData*>& tiles)
+                    {
+                        return std::vector<FloatingPointImageData*>{ takeDifferenceService_.Process(tiles[0], tiles[1]) };
+                    }));
+                    const auto minValue = differential[0]->GetMinValue();
+                    const auto maxValue = differential[0]->GetMaxValue();
+
+                    //The histograms of the tiles are normalized by the same size, so they add up
+                    std::vector<double> histogram(HISTOGRAM_SIZE);
+                    tiledImageService_.ForEachTile({ differential[0].get() }, 0, [&](const int, const std::vector<const FloatingPointImageData*>& tiles)
+                    {
+                        std::unique_ptr<HistogramData> tileHistogram(takeHistogramService_.Process(tiles[0], HISTOGRAM_SIZE, minValue, maxValue));
+                        for(auto i = 0; i < HISTOGRAM_SIZE; ++i)
+                        {
+                            histogram[i] += tileHistogram->Data[i];
+                        }
+                    });
+
+                    std::ofstream csv(GetOutputPath(inputPath, "_B-R_histogram"s, "csv"s));
+                    csv << "value,frequency"s << std::endl;
+                    for(auto i = 0; i < HISTOGRAM_SIZE; ++i)
+                    {
+                        csv << std::setprecision(8) << minValue + i * (maxValue - minValue) / (HISTOGRAM_SIZE - 1.0) << ","s << histogram[i] << std::endl;
+                    }
+
+                    auto stored = Scale(differential, minValue, maxValue, 0.0, 255.0);
+                    tiledImageService_.Store(stored[0].get(), stored[0].get(), stored[0].get(), GetOutputPath(inputPath, "_B-R"s, setting_.Extension));
+                }
+
+                auto elapsedMillisecounds = std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::system_clock::now() - start).count();
+
+                std::cout << "Tiled batch completed: "s << elapsedMillisecounds << "ms"s << std::endl;
+                std::cout << std::setprecision(4) << width << "x"s << height << ": PSNR "s << evaluations[0] << " / "s << evaluations[1] << " / "s << evaluations[2] << std::endl;
+                std::cout << "Mapped at the peak: "s << tiledImageService_.GetPeakResidentBytes() / 1024.0 / 1024.0 << "MB (budget "s << setting_.Tiled.MemoryBudget / 1024.0 / 1024.0 << "MB)"s << std::endl;
+
+                return evaluations;
+            }
+        };
+    }
+}